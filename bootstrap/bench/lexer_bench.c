@@ -0,0 +1,174 @@
+/*
+ * NERD Lexer Benchmark - measures tokenizer throughput
+ *
+ * Usage:
+ *   lexer_bench [-n iterations] [-s size_mb] [-j threads] <file.nerd>...
+ *
+ * The input files are concatenated and repeated until the corpus reaches
+ * the requested size, then tokenized once per iteration. The best run is
+ * reported as MB/s and tokens/s. -j fixes the lexer thread count (default:
+ * chosen by the lexer from input size and cores).
+ *
+ * It then times lexer_relex on a one-line edit in the middle of the corpus,
+ * alternately inserting and deleting a word, against a full relex.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include "nerd.h"
+
+/*
+ * Monotonic clock in seconds
+ */
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/*
+ * Append a whole file to the corpus buffer
+ */
+static bool append_file(const char *path, char **buf, size_t *len, size_t *cap) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "Error: Cannot open file '%s'\n", path);
+        return false;
+    }
+
+    char chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+        if (*len + n + 1 > *cap) {
+            while (*len + n + 1 > *cap) *cap *= 2;
+            char *grown = realloc(*buf, *cap);
+            if (!grown) {
+                fclose(f);
+                return false;
+            }
+            *buf = grown;
+        }
+        memcpy(*buf + *len, chunk, n);
+        *len += n;
+    }
+    (*buf)[(*len)++] = '\n';
+    fclose(f);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    int iterations = 5;
+    size_t target_mb = 16;
+    int threads = 0;
+    int first_file = argc;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            iterations = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            target_mb = (size_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else {
+            first_file = i;
+            break;
+        }
+    }
+
+    if (first_file >= argc || iterations < 1) {
+        fprintf(stderr, "Usage: lexer_bench [-n iterations] [-s size_mb] [-j threads] <file.nerd>...\n");
+        return 1;
+    }
+
+    // Build one copy of the inputs
+    size_t unit_cap = 4096, unit_len = 0;
+    char *unit = malloc(unit_cap);
+    if (!unit) return 1;
+    for (int i = first_file; i < argc; i++) {
+        if (!append_file(argv[i], &unit, &unit_len, &unit_cap)) {
+            free(unit);
+            return 1;
+        }
+    }
+
+    // Repeat it up to the target corpus size
+    size_t target = target_mb * 1024 * 1024;
+    size_t copies = target / unit_len + 1;
+    size_t source_len = copies * unit_len;
+    char *source = malloc(source_len + 1);
+    if (!source) {
+        free(unit);
+        return 1;
+    }
+    for (size_t i = 0; i < copies; i++) {
+        memcpy(source + i * unit_len, unit, unit_len);
+    }
+    source[source_len] = '\0';
+    free(unit);
+
+    double best = 0;
+    size_t token_count = 0;
+    for (int iter = 0; iter < iterations; iter++) {
+        double start = now_seconds();
+        Lexer *lexer = lexer_create(source, source_len);
+        if (lexer) lexer->threads = threads;
+        if (!lexer || !lexer_tokenize(lexer)) {
+            lexer_free(lexer);
+            free(source);
+            return 1;
+        }
+        double elapsed = now_seconds() - start;
+        token_count = lexer->tokens.count;
+        lexer_free(lexer);
+
+        if (iter == 0 || elapsed < best) best = elapsed;
+    }
+
+    double mb = (double)source_len / (1024.0 * 1024.0);
+    printf("corpus:     %.1f MB, %zu tokens\n", mb, token_count);
+    printf("best of %d: %.3f s\n", iterations, best);
+    printf("throughput: %.1f MB/s, %.2f M tokens/s\n",
+           mb / best, (double)token_count / best / 1e6);
+
+    // Edited copy: "x " inserted at the start of the middle line
+    size_t edit = source_len / 2;
+    while (edit > 0 && source[edit - 1] != '\n') edit--;
+    char *edited = malloc(source_len + 2);
+    Lexer *lexer = lexer_create(source, source_len);
+    if (!edited || !lexer || !lexer_tokenize(lexer)) {
+        free(edited);
+        lexer_free(lexer);
+        free(source);
+        return 1;
+    }
+    memcpy(edited, source, edit);
+    memcpy(edited + edit, "x ", 2);
+    memcpy(edited + edit + 2, source + edit, source_len - edit);
+
+    int edits = 1000;
+    double start = now_seconds();
+    for (int i = 0; i < edits; i++) {
+        bool ok = i % 2 == 0
+            ? lexer_relex(lexer, edited, source_len + 2, edit, edit, edit + 2)
+            : lexer_relex(lexer, source, source_len, edit, edit + 2, edit);
+        if (!ok) {
+            free(edited);
+            lexer_free(lexer);
+            free(source);
+            return 1;
+        }
+    }
+    double per_edit = (now_seconds() - start) / edits;
+    lexer_free(lexer);
+    free(edited);
+    printf("relex:      %.1f us per one-line edit (full lex %.1f us)\n",
+           per_edit * 1e6, best * 1e6);
+
+    free(source);
+    intern_free();
+    return 0;
+}
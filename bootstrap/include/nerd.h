@@ -12,6 +12,9 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdio.h>
+
+#define NERD_VERSION "3.0.0"
 
 /*
  * Token Types - All English words, each tokenizes as 1 LLM token
@@ -129,14 +132,41 @@ typedef enum {
 } TokenType;
 
 /*
- * Token structure
+ * Interned identifier - dense ID into the global intern table
+ */
+typedef uint32_t Symbol;
+#define SYM_NONE 0
+
+/*
+ * Token stream - struct of arrays
+ *
+ * Tokens do not own their text: (offset, length) is a slice of the source
+ * buffer, which must outlive the stream. The parser mostly tests types, so
+ * they sit in their own byte array. Line and column are not stored; they are
+ * recovered from a newline table that is only built when asked for.
+ */
+typedef struct {
+    uint8_t *types;         // TokenType of each token
+    uint32_t *offsets;      // Start of token text in source
+    uint32_t *lengths;      // Length of token text
+    Symbol *syms;           // Interned text for TOK_IDENT, SYM_NONE otherwise
+    size_t count;
+    size_t capacity;
+
+    const char *source;
+    size_t source_len;
+    uint32_t *line_starts;  // Offset of each line, built on first lookup
+    size_t line_count;
+} TokenStream;
+
+/*
+ * Single token, as handed out by the streaming lexer
  */
 typedef struct {
     TokenType type;
-    char *value;        // Token text
-    size_t value_len;
-    int line;
-    int column;
+    uint32_t offset;
+    uint32_t length;
+    Symbol sym;
 } Token;
 
 /*
@@ -146,12 +176,10 @@ typedef struct {
     const char *source;
     size_t source_len;
     size_t pos;
-    int line;
-    int column;
+    int threads;            // Worker threads; 0 picks from input size and cores
+    bool chunk;             // Lexing one chunk of a parallel run
 
-    Token *tokens;
-    size_t token_count;
-    size_t token_capacity;
+    TokenStream tokens;
 } Lexer;
 
 /*
@@ -186,26 +214,88 @@ typedef enum {
     NODE_JSON_SET,      // x."key" = value
 } NodeType;
 
+/*
+ * Operators of BinOp/UnaryOp nodes
+ */
+typedef enum {
+    OP_PLUS,
+    OP_MINUS,
+    OP_TIMES,
+    OP_OVER,
+    OP_MOD,
+    OP_EQ,
+    OP_NEQ,
+    OP_LT,
+    OP_GT,
+    OP_LTE,
+    OP_GTE,
+    OP_AND,
+    OP_OR,
+    OP_NOT,
+    OP_NEG,
+} OpCode;
+
+/*
+ * What a variable name resolves to (filled in by resolve.c)
+ */
+typedef enum {
+    BIND_NONE,          // Unresolved or unknown
+    BIND_LOCAL,         // A double, held in an SSA register
+    BIND_PTR_LOCAL,     // %plocal<slot>, a JSON object
+    BIND_PARAM,         // %arg<slot>
+} BindKind;
+
+/*
+ * Static type of an expression (filled in by types.c)
+ *
+ * Repeat counters, and a counter mod a constant, are lowered to i64; JSON
+ * objects are pointers and every other value is a double at runtime.
+ */
+typedef enum {
+    TYPE_UNKNOWN,       // Not inferred (statements, unreached nodes)
+    TYPE_NUM,           // Any number
+    TYPE_INT,           // A number known to be integral
+    TYPE_BOOL,
+    TYPE_STR,
+    TYPE_JSON,          // A JSON object (i8*)
+} ValueType;
+
 /*
  * Forward declarations
  */
 typedef struct ASTNode ASTNode;
 typedef struct ASTList ASTList;
+typedef struct Arena Arena;
 
 /*
  * List of AST nodes (for function bodies, parameters, etc.)
+ *
+ * Most lists (call arguments, short bodies) hold a few nodes, which are
+ * kept inline. Longer lists spill to an array in the arena. Read the
+ * entries through ast_list_nodes(), which works either way and stays
+ * valid when a list is copied by value.
  */
+#define AST_LIST_INLINE 3
+
 struct ASTList {
-    ASTNode **nodes;
-    size_t count;
-    size_t capacity;
+    uint32_t count;
+    uint32_t capacity;          // 0 while the nodes are inline
+    union {
+        ASTNode *inline_nodes[AST_LIST_INLINE];
+        ASTNode **spill;
+    };
 };
 
+static inline ASTNode **ast_list_nodes(const ASTList *list) {
+    return list->capacity ? list->spill : (ASTNode **)list->inline_nodes;
+}
+
 /*
  * AST Node
  */
 struct ASTNode {
-    NodeType type;
+    uint8_t type;       // NodeType
+    uint8_t vtype;      // ValueType
     int line;
 
     union {
@@ -213,19 +303,22 @@ struct ASTNode {
         struct {
             ASTList types;
             ASTList functions;
+            Arena *arena;       // Owns every node, list and string in the tree
         } program;
 
         // Function definition
         struct {
-            char *name;
+            Symbol name;
             ASTList params;
             ASTNode *return_type;
             ASTList body;
+            int local_count;        // Slots of lets and repeat counters (set by resolve.c)
+            int ptr_count;          // Slots of JSON lets (set by resolve.c)
         } func_def;
 
         // Type definition
         struct {
-            char *name;
+            Symbol name;
             bool is_union;      // struct vs union (ok/err)
             ASTList fields;     // struct fields
             ASTNode *ok_type;   // for union
@@ -234,7 +327,7 @@ struct ASTNode {
 
         // Parameter
         struct {
-            char *name;
+            Symbol name;
             ASTNode *param_type;
         } param;
 
@@ -259,7 +352,8 @@ struct ASTNode {
         // Repeat loop (repeat n times [as i] ... done)
         struct {
             ASTNode *count;         // expression for iteration count
-            char *var_name;         // optional "as i" variable (NULL if not present)
+            Symbol var_name;        // optional "as i" variable (SYM_NONE if not present)
+            int slot;               // local holding the counter
             ASTList body;           // loop body
         } repeat;
 
@@ -271,19 +365,24 @@ struct ASTNode {
 
         // Increment statement (inc var [amount])
         struct {
-            char *var_name;
+            Symbol var_name;
+            int slot;               // local being updated, -1 if unknown
             ASTNode *amount;        // NULL means increment by 1
         } inc;
 
         // Decrement statement (dec var [amount])
         struct {
-            char *var_name;
+            Symbol var_name;
+            int slot;               // local being updated, -1 if unknown
             ASTNode *amount;        // NULL means decrement by 1
         } dec;
 
         // Let binding
         struct {
-            char *name;
+            Symbol name;
+            BindKind bind;          // BIND_LOCAL or BIND_PTR_LOCAL (NONE if not bound)
+            int slot;
+            bool declares;          // allocates the slot, rather than storing to it
             ASTNode *value;
         } let;
 
@@ -294,14 +393,14 @@ struct ASTNode {
 
         // Binary operation
         struct {
-            char *op;           // plus, minus, times, over, eq, etc.
+            OpCode op;
             ASTNode *left;
             ASTNode *right;
         } binop;
 
         // Unary operation
         struct {
-            char *op;           // not
+            OpCode op;          // OP_NOT or OP_NEG
             ASTNode *operand;
         } unaryop;
 
@@ -329,7 +428,9 @@ struct ASTNode {
 
         // Variable reference
         struct {
-            char *name;
+            Symbol name;
+            BindKind bind;
+            int slot;
         } var;
 
         // Positional parameter reference
@@ -364,15 +465,77 @@ struct ASTNode {
     } data;
 };
 
+/*
+ * Compact AST
+ *
+ * A pointer-free form of the tree for very large programs. Each node is a
+ * run of 32-bit words in one pool: a header (kind in the low byte, a small
+ * per-kind value such as the operator above it), the line, and a payload
+ * sized for its kind. Nodes are addressed by word index, child lists are
+ * (start, count) ranges into a shared index array, and strings live in one
+ * NUL-separated pool, so the whole tree is three flat arrays.
+ *
+ * Accessors take the child, list and string number in the order the fields
+ * appear in the matching ASTNode member (e.g. func_def: list 0 is params,
+ * list 1 is body, child 0 is return_type).
+ */
+typedef uint32_t NodeRef;
+#define NODE_NONE 0             // Word 0 is reserved so 0 can mean "no node"
+#define STR_NONE UINT32_MAX     // Offset of a NULL string
+
+typedef struct {
+    uint32_t *words;            // Node pool
+    size_t word_count;
+    size_t word_capacity;
+    NodeRef *lists;             // Child lists, referenced as ranges
+    size_t list_count;
+    size_t list_capacity;
+    char *strings;              // String pool
+    size_t string_len;
+    size_t string_capacity;
+    NodeRef root;               // The NODE_PROGRAM node
+    void *mapping;              // Set when the arrays point into an mmap'd cache file
+    size_t mapping_len;
+} CompactAST;
+
 /*
  * Parser state
+ *
+ * Batch mode reads a fully lexed TokenStream. Streaming mode pulls tokens
+ * from the lexer into a ring that covers the parser's lookahead and
+ * backtracking, so token memory does not grow with the source.
  */
+#define PARSER_RING 64          // Power of two
+
+typedef struct {
+    Token tok;
+    int line;
+} RingToken;
+
 typedef struct {
-    Token *tokens;
-    size_t token_count;
+    const char *source;     // Buffer the tokens slice into
+    TokenStream *tokens;
+    const uint8_t *types;   // tokens->types, for the hot checks (batch mode)
     size_t pos;
+    Arena *arena;           // AST storage; handed to the program on success
+
+    // Streaming mode
+    Lexer *lexer;           // NULL in batch mode
+    RingToken ring[PARSER_RING];
+    size_t ring_end;        // Index one past the last token pulled
+    int ring_line;          // Line of the next token pulled
+    bool lex_failed;
+
+    uint32_t modules;       // MODULE_BIT of each library module called
+
+    // Batch mode: functions are parsed on this many threads (0 = auto)
+    int threads;
+    bool quiet;             // Worker parsers leave error reports to a serial re-parse
 } Parser;
 
+// Bit for a standard library module token (TOK_MATH .. TOK_LLM)
+#define MODULE_BIT(tok) (1u << ((tok) - TOK_MATH))
+
 /*
  * Compiler context
  */
@@ -386,33 +549,194 @@ typedef struct {
     int error_line;
 } NerdContext;
 
+/*
+ * Source file loaded for compilation
+ *
+ * Regular files are memory-mapped; stdin and pipes are read into the heap.
+ * The buffer is not NUL-terminated.
+ */
+typedef struct {
+    const char *data;
+    size_t len;
+    bool mapped;        // true if data is an mmap of the file
+} SourceFile;
+
+/*
+ * String interning
+ */
+Symbol intern(const char *s, size_t len);
+Symbol intern_cstr(const char *s);
+const char *symbol_name(Symbol sym);
+uint32_t symbol_count(void);
+void intern_free(void);
+
+/*
+ * Source loading
+ */
+bool source_open(SourceFile *src, const char *path);
+void source_close(SourceFile *src);
+
 /*
  * Lexer functions
  */
 Lexer *lexer_create(const char *source, size_t len);
 void lexer_free(Lexer *lexer);
 bool lexer_tokenize(Lexer *lexer);
+bool lexer_next_token(Lexer *lexer, Token *tok);
+bool lexer_relex(Lexer *lexer, const char *source, size_t len,
+                 size_t start, size_t old_end, size_t new_end);
+void token_stream_locate(TokenStream *ts, size_t offset, int *line, int *column);
 
 /*
  * Parser functions
  */
-Parser *parser_create(Token *tokens, size_t count);
+Parser *parser_create(TokenStream *tokens);
+Parser *parser_create_stream(Lexer *lexer);
+Parser *parser_create_auto(Lexer *lexer);
 void parser_free(Parser *parser);
 ASTNode *parser_parse(Parser *parser);
+bool parser_parse_segment(Parser *parser, size_t end, ASTList *types,
+                          ASTList *functions, ASTList *stmts, bool *has_main);
+
+/*
+ * Arena allocation
+ */
+Arena *arena_create(void);
+void *arena_alloc(Arena *arena, size_t size);
+void *arena_grow(Arena *arena, void *ptr, size_t old_size, size_t new_size);
+char *arena_strdup(Arena *arena, const char *s);
+char *arena_strndup(Arena *arena, const char *s, size_t n);
+void arena_adopt(Arena *arena, Arena *other);
+void arena_free(Arena *arena);
+
+/*
+ * IR output buffer
+ *
+ * Codegen appends IR text here rather than going through stdio. With a
+ * sink the buffer is written out in large chunks as it fills; without
+ * one it keeps everything, for the caller to take or hand on. The text
+ * is always NUL-terminated. If memory runs out, failed is set and later
+ * output is dropped, so callers check once at the end.
+ */
+typedef struct {
+    char *data;
+    size_t len;
+    size_t capacity;
+    FILE *sink;             // Flushed to when full, NULL to keep in memory
+    bool failed;
+} IRBuffer;
+
+void ir_init(IRBuffer *buf, FILE *sink);
+void ir_append(IRBuffer *buf, const char *s, size_t len);
+void ir_puts(IRBuffer *buf, const char *s);
+void ir_emit(IRBuffer *buf, const char *fmt, ...);
+bool ir_flush(IRBuffer *buf);
+char *ir_take(IRBuffer *buf, size_t *len);
+void ir_free(IRBuffer *buf);
 
 /*
  * AST functions
  */
-ASTNode *ast_create(NodeType type, int line);
+ASTNode *ast_create(Arena *arena, NodeType type, int line);
 void ast_free(ASTNode *node);
 void ast_list_init(ASTList *list);
-void ast_list_push(ASTList *list, ASTNode *node);
+void ast_list_push(Arena *arena, ASTList *list, ASTNode *node);
+bool ast_list_reserve(Arena *arena, ASTList *list, size_t capacity);
 void ast_list_free(ASTList *list);
+const char *op_name(OpCode op);
+
+/*
+ * Compact AST functions
+ */
+CompactAST *compact_from_ast(ASTNode *program);
+ASTNode *compact_to_ast(const CompactAST *ast);
+void compact_free(CompactAST *ast);
+size_t compact_size(const CompactAST *ast);
+NodeType compact_kind(const CompactAST *ast, NodeRef node);
+int compact_line(const CompactAST *ast, NodeRef node);
+uint32_t compact_value(const CompactAST *ast, NodeRef node);
+NodeRef compact_child(const CompactAST *ast, NodeRef node, int i);
+const NodeRef *compact_list(const CompactAST *ast, NodeRef node, int i, uint32_t *count);
+Symbol compact_name(const CompactAST *ast, NodeRef node);
+const char *compact_str(const CompactAST *ast, NodeRef node, int i);
+double compact_num(const CompactAST *ast, NodeRef node);
+bool compact_relink(CompactAST *ast, const Symbol *names, uint32_t name_count);
+
+/*
+ * AST cache (compact trees on disk, keyed by source content)
+ */
+CompactAST *ast_cache_load(const char *source, size_t len, uint32_t *modules);
+void ast_cache_store(const char *source, size_t len, const CompactAST *ast, uint32_t modules);
+
+/*
+ * Name resolution (run before code generation)
+ *
+ * Binds every variable use, let, inc/dec and repeat counter to a local,
+ * pointer local or parameter slot, in the order codegen emits them.
+ * Unknown names are reported once per function and fail the pass.
+ */
+typedef struct Resolver Resolver;
+
+Resolver *resolver_create(void);
+bool resolve_function(Resolver *resolver, ASTNode *func);
+void resolver_free(Resolver *resolver);
+bool resolve_program(ASTNode *program);
+
+/*
+ * Constant folding (run after name resolution, before type inference)
+ *
+ * Replaces operators, comparisons and math calls on literals with their
+ * result, reads of locals bound once to a literal with the literal, and
+ * ifs with a constant condition with the branch they take.
+ */
+bool fold_function(ASTNode *func);
+bool fold_program(ASTNode *program);
+
+/*
+ * Type inference (run after name resolution)
+ *
+ * Sets vtype on every expression from literals, operators, calls and the
+ * context a JSON access is used in, and gives each local the join of the
+ * types stored to it. Using a non-object where a JSON object is expected
+ * fails the pass.
+ */
+bool infer_function(ASTNode *func);
+bool infer_program(ASTNode *program);
 
 /*
  * Code generation (LLVM)
  */
+typedef struct CodeGen CodeGen;
+
 bool codegen_llvm(NerdContext *ctx, const char *output_path);
+bool codegen_module(NerdContext *ctx, IRBuffer *out);
+CodeGen *codegen_create(IRBuffer *out);
+void codegen_free(CodeGen *cg);
+void codegen_prelude(IRBuffer *out);
+void codegen_string_decl(IRBuffer *out, size_t index, const char *s);
+size_t codegen_function(CodeGen *cg, ASTNode *func, IRBuffer *out,
+                        char ***strings, size_t *string_count);
+
+/*
+ * Incremental compilation
+ *
+ * Keeps every function's AST and IR between builds of one source, keyed by
+ * a fingerprint of the function's tokens, so a rebuild only parses and
+ * emits the functions that changed.
+ */
+typedef struct FunctionUnit FunctionUnit;
+
+typedef struct {
+    FunctionUnit **units;       // Functions of the last build, in source order
+    size_t unit_count;
+    size_t reused;              // Functions taken from the previous build
+    size_t rebuilt;             // Functions parsed and emitted afresh
+} IncrementalBuild;
+
+IncrementalBuild *incremental_create(void);
+bool incremental_compile(IncrementalBuild *build, const char *source, size_t len,
+                         const char *output_path);
+void incremental_free(IncrementalBuild *build);
 
 /*
  * Utility functions
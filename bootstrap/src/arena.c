@@ -0,0 +1,149 @@
+/*
+ * NERD Arena Allocator - Bump allocation for per-compilation data
+ *
+ * Memory comes from large zeroed blocks and is handed out by bumping a
+ * pointer. Nothing is freed individually; arena_free releases every block
+ * at once. The AST lives here, so tearing a tree down is O(blocks).
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "nerd.h"
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+#define ARENA_ALIGN _Alignof(max_align_t)
+
+typedef struct ArenaBlock ArenaBlock;
+struct ArenaBlock {
+    ArenaBlock *next;
+    size_t used;
+    size_t capacity;
+    _Alignas(max_align_t) unsigned char data[];
+};
+
+struct Arena {
+    ArenaBlock *block;      // Current block; older ones hang off next
+    void *last;             // Most recent allocation, which can grow in place
+};
+
+/*
+ * Round a size up to the allocation alignment
+ */
+static size_t arena_round(size_t size) {
+    return (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+/*
+ * Create an empty arena
+ */
+Arena *arena_create(void) {
+    return calloc(1, sizeof(Arena));
+}
+
+/*
+ * Allocate zeroed memory from the arena (NULL if out of memory)
+ */
+void *arena_alloc(Arena *arena, size_t size) {
+    size = arena_round(size ? size : 1);
+
+    ArenaBlock *block = arena->block;
+    if (!block || block->used + size > block->capacity) {
+        size_t capacity = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+        // calloc so every allocation starts zeroed, like the callocs it replaces
+        block = calloc(1, sizeof(ArenaBlock) + capacity);
+        if (!block) return NULL;
+        block->capacity = capacity;
+
+        // Keep filling the current block if the new one is a one-off
+        if (arena->block && size > ARENA_BLOCK_SIZE) {
+            block->next = arena->block->next;
+            arena->block->next = block;
+            block->used = size;
+            return block->data;
+        }
+        block->next = arena->block;
+        arena->block = block;
+    }
+
+    void *ptr = block->data + block->used;
+    block->used += size;
+    arena->last = ptr;
+    return ptr;
+}
+
+/*
+ * Grow an allocation, in place when it is the most recent one
+ *
+ * The old contents are kept and the new tail is zeroed.
+ */
+void *arena_grow(Arena *arena, void *ptr, size_t old_size, size_t new_size) {
+    if (!ptr) return arena_alloc(arena, new_size);
+    if (new_size <= old_size) return ptr;
+
+    ArenaBlock *block = arena->block;
+    if (ptr == arena->last) {
+        size_t start = (size_t)((unsigned char *)ptr - block->data);
+        size_t size = arena_round(new_size);
+        if (start + size <= block->capacity) {
+            block->used = start + size;
+            return ptr;
+        }
+    }
+
+    void *grown = arena_alloc(arena, new_size);
+    if (grown) memcpy(grown, ptr, old_size);
+    return grown;
+}
+
+/*
+ * Copy a string into the arena
+ */
+char *arena_strndup(Arena *arena, const char *s, size_t n) {
+    if (!s) return NULL;
+    char *dup = arena_alloc(arena, n + 1);
+    if (dup) {
+        memcpy(dup, s, n);
+        dup[n] = '\0';
+    }
+    return dup;
+}
+
+char *arena_strdup(Arena *arena, const char *s) {
+    return s ? arena_strndup(arena, s, strlen(s)) : NULL;
+}
+
+/*
+ * Move every block of another arena into this one and free the other
+ *
+ * Used to merge per-thread arenas; allocations from either stay valid.
+ */
+void arena_adopt(Arena *arena, Arena *other) {
+    if (!other) return;
+    ArenaBlock *tail = other->block;
+    if (tail) {
+        while (tail->next) tail = tail->next;
+        if (arena->block) {
+            // Keep the current block in front so it can still be filled
+            tail->next = arena->block->next;
+            arena->block->next = other->block;
+        } else {
+            arena->block = other->block;
+            arena->last = NULL;
+        }
+    }
+    free(other);
+}
+
+/*
+ * Release every block
+ */
+void arena_free(Arena *arena) {
+    if (!arena) return;
+    ArenaBlock *block = arena->block;
+    while (block) {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    free(arena);
+}
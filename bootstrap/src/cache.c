@@ -0,0 +1,290 @@
+/*
+ * NERD AST Cache - Skips lexing and parsing for unchanged sources
+ *
+ * A parsed program is stored as its compact tree (see compact.c), which
+ * holds no pointers and can be mapped straight back in. Files are named
+ * after a hash of the source text, the compiler version and the cache
+ * format, so any edit or upgrade simply misses.
+ *
+ * File layout, all in native byte order:
+ *
+ *   CacheHeader
+ *   uint32_t words[word_count]
+ *   NodeRef  lists[list_count]
+ *   uint32_t name_offsets[name_count + 1]   into the name pool (0 unused)
+ *   char     names[names_len]               NUL-terminated symbol names
+ *   char     strings[string_len]
+ *
+ * Names are stored by symbol ID, and re-interned in ID order on load, so
+ * a fresh process gets the same IDs and relinking changes nothing.
+ *
+ * The directory is $NERD_CACHE_DIR, else $XDG_CACHE_HOME/nerd, else
+ * ~/.cache/nerd.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "nerd.h"
+
+#define CACHE_MAGIC "NERDAST"
+#define CACHE_FORMAT 1          // Bump when the compact layout or NodeType changes
+
+typedef struct {
+    char magic[8];
+    uint32_t format;
+    uint32_t modules;           // MODULE_BIT set of library modules called
+    uint64_t key;               // Hash of source, version and format
+    uint64_t source_len;
+    uint64_t checksum;          // Of everything after the header
+    uint64_t word_count;
+    uint64_t list_count;
+    uint64_t names_len;
+    uint64_t string_len;
+    uint32_t name_count;
+    NodeRef root;
+    char version[16];
+} CacheHeader;
+
+/*
+ * 64-bit FNV-style hash, eight bytes at a time
+ */
+static uint64_t cache_hash(const void *data, size_t len, uint64_t h) {
+    const unsigned char *p = data;
+    while (len >= 8) {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        h = (h ^ word) * 1099511628211ull;
+        h ^= h >> 29;
+        p += 8;
+        len -= 8;
+    }
+    while (len--) {
+        h = (h ^ *p++) * 1099511628211ull;
+    }
+    return h;
+}
+
+static uint64_t cache_key(const char *source, size_t len) {
+    uint64_t h = cache_hash(NERD_VERSION, sizeof(NERD_VERSION), 14695981039346656037ull);
+    uint32_t format = CACHE_FORMAT;
+    h = cache_hash(&format, sizeof(format), h);
+    return cache_hash(source, len, h);
+}
+
+/*
+ * Path of the cache file for a key, creating the directory if asked
+ * (false if there is nowhere to cache)
+ */
+static bool cache_path(uint64_t key, char *path, size_t size, bool create) {
+    char dir[1024];
+    const char *env = getenv("NERD_CACHE_DIR");
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+
+    // A directory name too long for the buffer means no cache
+    int n;
+    if (env && *env) {
+        n = snprintf(dir, sizeof(dir), "%s", env);
+    } else if (xdg && *xdg) {
+        n = snprintf(dir, sizeof(dir), "%s/nerd", xdg);
+        if (n < 0 || n >= (int)sizeof(dir)) return false;
+        if (create) mkdir(xdg, 0755);
+    } else if (home && *home) {
+        char parent[1024];
+        n = snprintf(parent, sizeof(parent), "%s/.cache", home);
+        if (n < 0 || n >= (int)sizeof(parent)) return false;
+        if (create) mkdir(parent, 0755);
+        n = snprintf(dir, sizeof(dir), "%s/nerd", parent);
+    } else {
+        return false;
+    }
+    if (n < 0 || n >= (int)sizeof(dir)) return false;
+
+    if (create && mkdir(dir, 0755) != 0 && errno != EEXIST) return false;
+    return snprintf(path, size, "%s/%016llx.ast", dir, (unsigned long long)key) < (int)size;
+}
+
+/*
+ * Load the cached tree for a source (NULL on a miss)
+ *
+ * The tree is mapped copy-on-write straight from the file. Anything
+ * unexpected in the file counts as a miss.
+ */
+CompactAST *ast_cache_load(const char *source, size_t len, uint32_t *modules) {
+    uint64_t key = cache_key(source, len);
+    char path[1100];
+    if (!cache_path(key, path, sizeof(path), false)) return NULL;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(CacheHeader)) {
+        close(fd);
+        return NULL;
+    }
+    size_t size = (size_t)st.st_size;
+    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return NULL;
+
+    CompactAST *ast = NULL;
+    Symbol *names = NULL;
+    const CacheHeader *h = map;
+
+    if (memcmp(h->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+        h->format != CACHE_FORMAT || h->key != key || h->source_len != len ||
+        strncmp(h->version, NERD_VERSION, sizeof(h->version)) != 0) {
+        goto miss;
+    }
+
+    // Section sizes must add up to the file size exactly
+    uint64_t payload = size - sizeof(CacheHeader);
+    uint64_t max_words = payload / 4;
+    if (h->word_count > max_words || h->list_count > max_words ||
+        h->name_count >= max_words || h->names_len > payload || h->string_len > payload) {
+        goto miss;
+    }
+    uint64_t expected = 4 * (h->word_count + h->list_count + h->name_count + 1) +
+                        h->names_len + h->string_len;
+    if (expected != payload) goto miss;
+
+    unsigned char *data = (unsigned char *)map + sizeof(CacheHeader);
+    uint32_t *words = (uint32_t *)data;
+    NodeRef *lists = words + h->word_count;
+    const uint32_t *name_offsets = lists + h->list_count;
+    const char *name_pool = (const char *)(name_offsets + h->name_count + 1);
+    char *strings = (char *)name_pool + h->names_len;
+
+    uint64_t sum = key;
+    sum = cache_hash(words, 4 * h->word_count, sum);
+    sum = cache_hash(lists, 4 * h->list_count, sum);
+    sum = cache_hash(name_offsets, 4 * ((size_t)h->name_count + 1), sum);
+    sum = cache_hash(name_pool, h->names_len, sum);
+    sum = cache_hash(strings, h->string_len, sum);
+    if (sum != h->checksum) goto miss;
+
+    // Intern the names in ID order; usually this reproduces the same IDs
+    if (h->names_len > 0 && name_pool[h->names_len - 1] != '\0') goto miss;
+
+    names = malloc(sizeof(Symbol) * (h->name_count + 1));
+    if (!names) goto miss;
+    names[0] = SYM_NONE;
+    bool identity = true;
+    for (uint32_t i = 1; i <= h->name_count; i++) {
+        if (name_offsets[i] >= h->names_len) goto miss;
+        names[i] = intern_cstr(name_pool + name_offsets[i]);
+        if (names[i] == SYM_NONE) goto miss;
+        if (names[i] != i) identity = false;
+    }
+
+    ast = calloc(1, sizeof(CompactAST));
+    if (!ast) goto miss;
+    ast->words = words;
+    ast->word_count = h->word_count;
+    ast->lists = lists;
+    ast->list_count = h->list_count;
+    ast->strings = strings;
+    ast->string_len = h->string_len;
+    ast->root = h->root;
+
+    if (!compact_relink(ast, identity ? NULL : names, h->name_count)) {
+        free(ast);
+        ast = NULL;
+        goto miss;
+    }
+
+    *modules = h->modules;
+    ast->mapping = map;
+    ast->mapping_len = size;
+    free(names);
+    return ast;
+
+miss:
+    free(names);
+    munmap(map, size);
+    return NULL;
+}
+
+/*
+ * Write a source's tree to the cache
+ *
+ * Best effort: failures are silent and only cost the next run a parse.
+ * The file is written under a temporary name and renamed into place, so
+ * readers never see a partial file.
+ */
+void ast_cache_store(const char *source, size_t len, const CompactAST *ast, uint32_t modules) {
+    uint64_t key = cache_key(source, len);
+    char path[1100];
+    char tmp[1200];
+    if (!cache_path(key, path, sizeof(path), true)) return;
+    snprintf(tmp, sizeof(tmp), "%s.%ld.tmp", path, (long)getpid());
+
+    // Every interned name, by ID
+    uint32_t name_count = symbol_count() - 1;
+    size_t names_len = 0;
+    for (Symbol sym = 1; sym <= name_count; sym++) {
+        names_len += strlen(symbol_name(sym)) + 1;
+    }
+    uint32_t *name_offsets = malloc(sizeof(uint32_t) * ((size_t)name_count + 1));
+    char *name_pool = malloc(names_len ? names_len : 1);
+    if (!name_offsets || !name_pool) {
+        free(name_offsets);
+        free(name_pool);
+        return;
+    }
+    name_offsets[0] = 0;
+    size_t at = 0;
+    for (Symbol sym = 1; sym <= name_count; sym++) {
+        const char *name = symbol_name(sym);
+        size_t n = strlen(name) + 1;
+        name_offsets[sym] = (uint32_t)at;
+        memcpy(name_pool + at, name, n);
+        at += n;
+    }
+
+    CacheHeader h = {0};
+    memcpy(h.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    h.format = CACHE_FORMAT;
+    h.modules = modules;
+    h.key = key;
+    h.source_len = len;
+    h.word_count = ast->word_count;
+    h.list_count = ast->list_count;
+    h.names_len = names_len;
+    h.string_len = ast->string_len;
+    h.name_count = name_count;
+    h.root = ast->root;
+    snprintf(h.version, sizeof(h.version), "%s", NERD_VERSION);
+
+    // The checksum runs over the sections exactly as they land in the file
+    uint64_t sum = key;
+    sum = cache_hash(ast->words, 4 * ast->word_count, sum);
+    sum = cache_hash(ast->lists, 4 * ast->list_count, sum);
+    sum = cache_hash(name_offsets, 4 * ((size_t)name_count + 1), sum);
+    sum = cache_hash(name_pool, names_len, sum);
+    sum = cache_hash(ast->strings, ast->string_len, sum);
+    h.checksum = sum;
+
+    FILE *f = fopen(tmp, "wb");
+    bool ok = f &&
+              fwrite(&h, sizeof(h), 1, f) == 1 &&
+              fwrite(ast->words, 4, ast->word_count, f) == ast->word_count &&
+              fwrite(ast->lists, 4, ast->list_count, f) == ast->list_count &&
+              fwrite(name_offsets, 4, (size_t)name_count + 1, f) == (size_t)name_count + 1 &&
+              fwrite(name_pool, 1, names_len, f) == names_len &&
+              fwrite(ast->strings, 1, ast->string_len, f) == ast->string_len;
+    if (f && fclose(f) != 0) ok = false;
+    free(name_offsets);
+    free(name_pool);
+
+    if (!ok || rename(tmp, path) != 0) unlink(tmp);
+}
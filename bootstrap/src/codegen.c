@@ -5,44 +5,47 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <math.h>
 #include "nerd.h"
 
 /*
  * Code generator state
  */
-typedef struct {
-    FILE *out;
+struct CodeGen {
+    IRBuffer *out;
     int temp_counter;
     int label_counter;
     int string_counter;
 
-    // Current function context
+    // Current function context (variables are resolved to slots beforehand)
     ASTNode *current_func;
-    char **param_names;
-    size_t param_count;
 
-    // Local variables (doubles)
-    char **local_names;
-    int *local_regs;
-    size_t local_count;
-    size_t local_capacity;
+    // Scalar locals are SSA values: the register holding each slot's value
+    // on the path being emitted, -1 before the first store on that path
+    int *values;
+    bool *int_slot;             // Slot holds an i64 rather than a double
+    int value_capacity;
+    int local_count;
+
+    // Marks for collecting each local once (slot_mark[slot] == mark_stamp)
+    int *slot_mark;
+    int mark_stamp;
 
-    // Pointer locals (JSON objects, strings)
-    char **ptr_local_names;
-    int *ptr_local_regs;
-    size_t ptr_local_count;
-    size_t ptr_local_capacity;
+    // Block being emitted; terminated once it ends in br or ret
+    const char *block_name;
+    int block_id;               // -1 for unnumbered blocks (entry)
+    bool terminated;
 
     // String literals (deferred output)
     char **string_literals;
     size_t string_count;
     size_t string_capacity;
-} CodeGen;
+};
 
 /*
  * Create code generator
  */
-static CodeGen *codegen_create(FILE *out) {
+CodeGen *codegen_create(IRBuffer *out) {
     CodeGen *cg = calloc(1, sizeof(CodeGen));
     if (!cg) return NULL;
 
@@ -50,12 +53,6 @@ static CodeGen *codegen_create(FILE *out) {
     cg->temp_counter = 0;
     cg->label_counter = 0;
     cg->string_counter = 0;
-    cg->local_capacity = 16;
-    cg->local_names = malloc(sizeof(char*) * cg->local_capacity);
-    cg->local_regs = malloc(sizeof(int) * cg->local_capacity);
-    cg->ptr_local_capacity = 16;
-    cg->ptr_local_names = malloc(sizeof(char*) * cg->ptr_local_capacity);
-    cg->ptr_local_regs = malloc(sizeof(int) * cg->ptr_local_capacity);
     cg->string_capacity = 16;
     cg->string_literals = malloc(sizeof(char*) * cg->string_capacity);
     cg->string_count = 0;
@@ -63,18 +60,11 @@ static CodeGen *codegen_create(FILE *out) {
     return cg;
 }
 
-static void codegen_free(CodeGen *cg) {
+void codegen_free(CodeGen *cg) {
     if (!cg) return;
-    for (size_t i = 0; i < cg->local_count; i++) {
-        free(cg->local_names[i]);
-    }
-    free(cg->local_names);
-    free(cg->local_regs);
-    for (size_t i = 0; i < cg->ptr_local_count; i++) {
-        free(cg->ptr_local_names[i]);
-    }
-    free(cg->ptr_local_names);
-    free(cg->ptr_local_regs);
+    free(cg->values);
+    free(cg->int_slot);
+    free(cg->slot_mark);
     for (size_t i = 0; i < cg->string_count; i++) {
         free(cg->string_literals[i]);
     }
@@ -112,90 +102,399 @@ static int next_label(CodeGen *cg) {
 }
 
 /*
- * Add local variable
+ * Start a new block (the previous one must already be terminated)
+ */
+static void begin_block(CodeGen *cg, const char *name, int id) {
+    if (id >= 0) {
+        ir_emit(cg->out, "%s%d:\n", name, id);
+    } else {
+        ir_emit(cg->out, "%s:\n", name);
+    }
+    cg->block_name = name;
+    cg->block_id = id;
+    cg->terminated = false;
+}
+
+/*
+ * Make sure code has a block to go in: statements after a ret land in a
+ * fresh, unreachable one, so every block has a name to branch from
+ */
+static void ensure_block(CodeGen *cg) {
+    if (cg->terminated) begin_block(cg, "dead", next_label(cg));
+}
+
+/*
+ * Emit a reference to the current block (for phi operands)
+ */
+static void emit_block_ref(IRBuffer *out, const char *name, int id) {
+    if (id >= 0) {
+        ir_emit(out, "%%%s%d", name, id);
+    } else {
+        ir_emit(out, "%%%s", name);
+    }
+}
+
+static bool int_slot(CodeGen *cg, int slot) {
+    return slot >= 0 && slot < cg->local_count && cg->int_slot[slot];
+}
+
+/*
+ * Emit a local's value as an operand (zero if never stored on this path)
  */
-static void add_local(CodeGen *cg, const char *name, int reg) {
-    if (cg->local_count >= cg->local_capacity) {
-        cg->local_capacity *= 2;
-        cg->local_names = realloc(cg->local_names, sizeof(char*) * cg->local_capacity);
-        cg->local_regs = realloc(cg->local_regs, sizeof(int) * cg->local_capacity);
+static void emit_value(IRBuffer *out, int reg, bool is_int) {
+    if (reg >= 0) {
+        ir_emit(out, "%%t%d", reg);
+    } else {
+        ir_puts(out, is_int ? "0" : "0.0");
     }
-    cg->local_names[cg->local_count] = nerd_strdup(name);
-    cg->local_regs[cg->local_count] = reg;
-    cg->local_count++;
 }
 
 /*
- * Find local variable
+ * A join point in the control flow: the blocks that branch to it and
+ * the values the locals assigned since the split have on each edge.
+ * Locals not in slots are the same on every edge and need no phi.
  */
-static int find_local(CodeGen *cg, const char *name) {
-    for (size_t i = 0; i < cg->local_count; i++) {
-        if (strcmp(cg->local_names[i], name) == 0) {
-            return cg->local_regs[i];
+typedef struct {
+    int *slots;
+    int slot_count;
+
+    const char **pred_names;
+    int *pred_ids;
+    int *pred_values;           // pred_count rows of slot_count registers
+    int pred_count;
+    int pred_capacity;
+} Merge;
+
+/*
+ * Add the locals a statement may assign to a merge
+ */
+static void collect_assigned(CodeGen *cg, ASTNode *node, Merge *m) {
+    if (!node) return;
+
+    int slot = -1;
+    switch (node->type) {
+        case NODE_LET:
+            if (node->data.let.bind == BIND_LOCAL) slot = node->data.let.slot;
+            break;
+        case NODE_INC:
+            slot = node->data.inc.slot;
+            break;
+        case NODE_DEC:
+            slot = node->data.dec.slot;
+            break;
+        case NODE_IF:
+            collect_assigned(cg, node->data.if_stmt.then_stmt, m);
+            collect_assigned(cg, node->data.if_stmt.else_stmt, m);
+            break;
+        case NODE_REPEAT:
+            slot = node->data.repeat.slot;
+            for (size_t i = 0; i < node->data.repeat.body.count; i++) {
+                collect_assigned(cg, ast_list_nodes(&node->data.repeat.body)[i], m);
+            }
+            break;
+        case NODE_WHILE:
+            for (size_t i = 0; i < node->data.while_loop.body.count; i++) {
+                collect_assigned(cg, ast_list_nodes(&node->data.while_loop.body)[i], m);
+            }
+            break;
+        default:
+            break;
+    }
+
+    if (slot < 0 || slot >= cg->local_count || cg->slot_mark[slot] == cg->mark_stamp) return;
+    cg->slot_mark[slot] = cg->mark_stamp;
+    m->slots[m->slot_count++] = slot;
+}
+
+/*
+ * Start a merge for the locals assigned by the given statements
+ */
+static bool merge_init(CodeGen *cg, Merge *m, ASTNode **stmts, size_t count, int extra_slot) {
+    memset(m, 0, sizeof(Merge));
+    m->slots = malloc(sizeof(int) * (size_t)(cg->local_count + 1));
+    if (!m->slots) {
+        fprintf(stderr, "Error: Out of memory\n");
+        return false;
+    }
+
+    cg->mark_stamp++;
+    if (extra_slot >= 0 && extra_slot < cg->local_count) {
+        cg->slot_mark[extra_slot] = cg->mark_stamp;
+        m->slots[m->slot_count++] = extra_slot;
+    }
+    for (size_t i = 0; i < count; i++) {
+        collect_assigned(cg, stmts[i], m);
+    }
+    return true;
+}
+
+static void merge_free(Merge *m) {
+    free(m->slots);
+    free(m->pred_names);
+    free(m->pred_ids);
+    free(m->pred_values);
+}
+
+/*
+ * Record the current block as a predecessor, with its values
+ */
+static void merge_edge(CodeGen *cg, Merge *m) {
+    if (m->pred_count >= m->pred_capacity) {
+        int capacity = m->pred_capacity ? m->pred_capacity * 2 : 2;
+        const char **names = realloc(m->pred_names, sizeof(char *) * (size_t)capacity);
+        if (names) m->pred_names = names;
+        int *ids = realloc(m->pred_ids, sizeof(int) * (size_t)capacity);
+        if (ids) m->pred_ids = ids;
+        int *values = realloc(m->pred_values,
+                              sizeof(int) * (size_t)capacity * (size_t)(m->slot_count + 1));
+        if (values) m->pred_values = values;
+        if (!names || !ids || !values) {
+            fprintf(stderr, "Error: Out of memory\n");
+            cg->out->failed = true;
+            return;
         }
+        m->pred_capacity = capacity;
     }
-    return -1;
+
+    int *row = m->pred_values + (size_t)m->pred_count * (size_t)m->slot_count;
+    for (int i = 0; i < m->slot_count; i++) {
+        row[i] = cg->values[m->slots[i]];
+    }
+    m->pred_names[m->pred_count] = cg->block_name;
+    m->pred_ids[m->pred_count] = cg->block_id;
+    m->pred_count++;
 }
 
 /*
- * Add pointer local variable (for JSON objects)
+ * Branch to a merge's block and record the edge
  */
-static void add_ptr_local(CodeGen *cg, const char *name, int reg) {
-    if (cg->ptr_local_count >= cg->ptr_local_capacity) {
-        cg->ptr_local_capacity *= 2;
-        cg->ptr_local_names = realloc(cg->ptr_local_names, sizeof(char*) * cg->ptr_local_capacity);
-        cg->ptr_local_regs = realloc(cg->ptr_local_regs, sizeof(int) * cg->ptr_local_capacity);
+static void merge_branch(CodeGen *cg, Merge *m, const char *name, int id) {
+    merge_edge(cg, m);
+    ir_emit(cg->out, "  br label %%%s%d\n", name, id);
+    cg->terminated = true;
+}
+
+/*
+ * Emit the phi of one merged local at the top of the join block
+ */
+static void emit_phi(CodeGen *cg, IRBuffer *out, const Merge *m, int index, int reg) {
+    bool is_int = int_slot(cg, m->slots[index]);
+    ir_emit(out, "  %%t%d = phi %s ", reg, is_int ? "i64" : "double");
+    for (int p = 0; p < m->pred_count; p++) {
+        ir_puts(out, p > 0 ? ", [ " : "[ ");
+        emit_value(out, m->pred_values[(size_t)p * (size_t)m->slot_count + (size_t)index], is_int);
+        ir_puts(out, ", ");
+        emit_block_ref(out, m->pred_names[p], m->pred_ids[p]);
+        ir_puts(out, " ]");
     }
-    cg->ptr_local_names[cg->ptr_local_count] = nerd_strdup(name);
-    cg->ptr_local_regs[cg->ptr_local_count] = reg;
-    cg->ptr_local_count++;
+    ir_puts(out, "\n");
 }
 
 /*
- * Find pointer local variable
+ * Enter a merge's join block: each merged local that differs between the
+ * incoming edges gets a phi. A block nobody branches to keeps the values.
  */
-static int find_ptr_local(CodeGen *cg, const char *name) {
-    for (size_t i = 0; i < cg->ptr_local_count; i++) {
-        if (strcmp(cg->ptr_local_names[i], name) == 0) {
-            return cg->ptr_local_regs[i];
+static void merge_join(CodeGen *cg, Merge *m, const char *name, int id) {
+    begin_block(cg, name, id);
+    if (m->pred_count == 0) return;
+
+    for (int i = 0; i < m->slot_count; i++) {
+        int first = m->pred_values[i];
+        bool same = true;
+        for (int p = 1; p < m->pred_count && same; p++) {
+            same = m->pred_values[(size_t)p * (size_t)m->slot_count + (size_t)i] == first;
+        }
+        if (same) {
+            cg->values[m->slots[i]] = first;
+            continue;
         }
+        int reg = next_temp(cg);
+        emit_phi(cg, cg->out, m, i, reg);
+        cg->values[m->slots[i]] = reg;
     }
-    return -1;
 }
 
 /*
- * Find parameter index
+ * Register holding a local's current value
+ */
+static int local_value(CodeGen *cg, int slot) {
+    if (slot >= 0 && slot < cg->local_count && cg->values[slot] >= 0) {
+        return cg->values[slot];
+    }
+
+    // Not stored on this path yet: reads as zero
+    int reg = next_temp(cg);
+    if (int_slot(cg, slot)) {
+        ir_emit(cg->out, "  %%t%d = add i64 0, 0\n", reg);
+    } else {
+        ir_emit(cg->out, "  %%t%d = fadd double 0.0, 0.0\n", reg);
+    }
+    return reg;
+}
+
+static void set_local(CodeGen *cg, int slot, int reg) {
+    if (slot >= 0 && slot < cg->local_count) cg->values[slot] = reg;
+}
+
+/*
+ * A loop being emitted. The header's phis depend on the values the body
+ * branches back with, so the header and body go to a side buffer and
+ * are appended after the phis once the body is done.
  */
-static int find_param(CodeGen *cg, const char *name) {
-    for (size_t i = 0; i < cg->param_count; i++) {
-        if (strcmp(cg->param_names[i], name) == 0) {
-            return (int)i;
+typedef struct {
+    Merge merge;                // Preheader and back edges into the header
+    int *phis;                  // Phi register of each merged local
+    IRBuffer *outer;
+    IRBuffer body;
+    const char *header_name;
+    int header_id;
+} Loop;
+
+/*
+ * Branch into a loop header and start emitting its condition
+ */
+static bool loop_begin(CodeGen *cg, Loop *loop, ASTList *body, int extra_slot,
+                       const char *header_name, int header_id) {
+    if (!merge_init(cg, &loop->merge, ast_list_nodes(body), body->count, extra_slot)) return false;
+    loop->phis = malloc(sizeof(int) * (size_t)(loop->merge.slot_count + 1));
+    if (!loop->phis) {
+        fprintf(stderr, "Error: Out of memory\n");
+        merge_free(&loop->merge);
+        return false;
+    }
+
+    merge_branch(cg, &loop->merge, header_name, header_id);
+
+    // Inside the loop the merged locals are the header's phis
+    for (int i = 0; i < loop->merge.slot_count; i++) {
+        loop->phis[i] = next_temp(cg);
+        cg->values[loop->merge.slots[i]] = loop->phis[i];
+    }
+
+    loop->outer = cg->out;
+    ir_init(&loop->body, NULL);
+    cg->out = &loop->body;
+    loop->header_name = header_name;
+    loop->header_id = header_id;
+    cg->block_name = header_name;
+    cg->block_id = header_id;
+    cg->terminated = false;
+    return true;
+}
+
+/*
+ * Emit the loop's header phis and buffered code, then enter the exit
+ * block (NULL when the loop failed and only needs cleaning up)
+ */
+static void loop_end_at(CodeGen *cg, Loop *loop, const char *exit_name, int exit_id) {
+    cg->out = loop->outer;
+    if (exit_name) {
+        ir_emit(cg->out, "%s%d:\n", loop->header_name, loop->header_id);
+        for (int i = 0; i < loop->merge.slot_count; i++) {
+            emit_phi(cg, cg->out, &loop->merge, i, loop->phis[i]);
+        }
+        ir_append(cg->out, loop->body.data ? loop->body.data : "", loop->body.len);
+        if (loop->body.failed) cg->out->failed = true;
+
+        // The exit is only reached from the header
+        begin_block(cg, exit_name, exit_id);
+        for (int i = 0; i < loop->merge.slot_count; i++) {
+            cg->values[loop->merge.slots[i]] = loop->phis[i];
         }
     }
-    return -1;
+
+    ir_free(&loop->body);
+    free(loop->phis);
+    merge_free(&loop->merge);
 }
 
 /*
- * Clear locals (for new function)
+ * LLVM instruction for an arithmetic operator
  */
-static void clear_locals(CodeGen *cg) {
-    for (size_t i = 0; i < cg->local_count; i++) {
-        free(cg->local_names[i]);
+static const char *arith_instruction(OpCode op) {
+    switch (op) {
+        case OP_PLUS:  return "fadd";
+        case OP_MINUS: return "fsub";
+        case OP_TIMES: return "fmul";
+        case OP_OVER:  return "fdiv";
+        case OP_MOD:   return "frem";
+        default:       return NULL;
     }
-    cg->local_count = 0;
-    for (size_t i = 0; i < cg->ptr_local_count; i++) {
-        free(cg->ptr_local_names[i]);
+}
+
+/*
+ * fcmp predicate for a comparison operator (ordered)
+ */
+static const char *compare_predicate(OpCode op) {
+    switch (op) {
+        case OP_EQ:  return "oeq";
+        case OP_NEQ: return "one";
+        case OP_LT:  return "olt";
+        case OP_GT:  return "ogt";
+        case OP_LTE: return "ole";
+        case OP_GTE: return "oge";
+        default:     return NULL;
+    }
+}
+
+/*
+ * icmp predicate for a comparison operator (signed)
+ */
+static const char *int_compare_predicate(OpCode op) {
+    switch (op) {
+        case OP_EQ:  return "eq";
+        case OP_NEQ: return "ne";
+        case OP_LT:  return "slt";
+        case OP_GT:  return "sgt";
+        case OP_LTE: return "sle";
+        case OP_GTE: return "sge";
+        default:     return NULL;
+    }
+}
+
+/*
+ * Whether an int-typed expression is computed in i64: literals, repeat
+ * counters and a counter mod a constant. These can't overflow; any other
+ * int arithmetic is done in doubles, which grow past 2^63 instead of
+ * wrapping.
+ */
+static bool native_int(CodeGen *cg, ASTNode *node) {
+    if (!node || node->vtype != TYPE_INT) return false;
+
+    switch (node->type) {
+        case NODE_NUM:
+            return true;
+        case NODE_VAR:
+            return node->data.var.bind == BIND_LOCAL && int_slot(cg, node->data.var.slot);
+        case NODE_BINOP:
+            // Int-typed mods always have a nonzero literal divisor
+            return node->data.binop.op == OP_MOD && native_int(cg, node->data.binop.left);
+        default:
+            return false;
     }
-    cg->ptr_local_count = 0;
-    cg->temp_counter = 0;
 }
 
 /*
  * Forward declaration
  */
 static int codegen_expr(CodeGen *cg, ASTNode *node);
+static int codegen_int(CodeGen *cg, ASTNode *node);
+static int codegen_cond(CodeGen *cg, ASTNode *node);
+static int codegen_object(CodeGen *cg, ASTNode *node);
 static void codegen_stmt(CodeGen *cg, ASTNode *node, int *result_reg);
 
+/*
+ * Point at the next pre-collected string, a JSON path or key
+ */
+static int codegen_path(CodeGen *cg, const char *path) {
+    int path_idx = cg->string_counter++;
+    size_t path_len = strlen(path) + 1;
+    int path_ptr = next_temp(cg);
+    ir_emit(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
+            path_ptr, path_len, path_len, path_idx);
+    return path_ptr;
+}
+
 /*
  * Collect string literals from AST (recursive)
  */
@@ -223,19 +522,20 @@ static void collect_strings_expr(CodeGen *cg, ASTNode *node) {
         collect_strings_expr(cg, node->data.unaryop.operand);
     } else if (node->type == NODE_CALL) {
         for (size_t i = 0; i < node->data.call.args.count; i++) {
-            collect_strings_expr(cg, node->data.call.args.nodes[i]);
+            collect_strings_expr(cg, ast_list_nodes(&node->data.call.args)[i]);
         }
     } else if (node->type == NODE_JSON_ACCESS) {
-        add_string_literal(cg, node->data.json_access.path);
+        // The object is emitted before the path
         collect_strings_expr(cg, node->data.json_access.object);
+        add_string_literal(cg, node->data.json_access.path);
     } else if (node->type == NODE_JSON_HAS) {
-        add_string_literal(cg, node->data.json_has.path);
         collect_strings_expr(cg, node->data.json_has.object);
+        add_string_literal(cg, node->data.json_has.path);
     } else if (node->type == NODE_JSON_COUNT) {
+        collect_strings_expr(cg, node->data.json_count.object);
         if (node->data.json_count.path) {
             add_string_literal(cg, node->data.json_count.path);
         }
-        collect_strings_expr(cg, node->data.json_count.object);
     }
 }
 
@@ -263,13 +563,13 @@ static void collect_strings_stmt(CodeGen *cg, ASTNode *node) {
         case NODE_REPEAT:
             collect_strings_expr(cg, node->data.repeat.count);
             for (size_t i = 0; i < node->data.repeat.body.count; i++) {
-                collect_strings_stmt(cg, node->data.repeat.body.nodes[i]);
+                collect_strings_stmt(cg, ast_list_nodes(&node->data.repeat.body)[i]);
             }
             break;
         case NODE_WHILE:
             collect_strings_expr(cg, node->data.while_loop.condition);
             for (size_t i = 0; i < node->data.while_loop.body.count; i++) {
-                collect_strings_stmt(cg, node->data.while_loop.body.nodes[i]);
+                collect_strings_stmt(cg, ast_list_nodes(&node->data.while_loop.body)[i]);
             }
             break;
         case NODE_JSON_SET:
@@ -283,13 +583,13 @@ static void collect_strings_stmt(CodeGen *cg, ASTNode *node) {
 
 static void collect_strings_func(CodeGen *cg, ASTNode *func) {
     for (size_t i = 0; i < func->data.func_def.body.count; i++) {
-        collect_strings_stmt(cg, func->data.func_def.body.nodes[i]);
+        collect_strings_stmt(cg, ast_list_nodes(&func->data.func_def.body)[i]);
     }
 }
 
 static void collect_strings(CodeGen *cg, ASTNode *program) {
     for (size_t i = 0; i < program->data.program.functions.count; i++) {
-        collect_strings_func(cg, program->data.program.functions.nodes[i]);
+        collect_strings_func(cg, ast_list_nodes(&program->data.program.functions)[i]);
     }
 }
 
@@ -299,144 +599,119 @@ static void collect_strings(CodeGen *cg, ASTNode *program) {
 static int codegen_expr(CodeGen *cg, ASTNode *node) {
     if (!node) return -1;
 
+    // Int arithmetic is done in i64 and widened where a double is needed
+    if (node->type != NODE_NUM && native_int(cg, node)) {
+        int int_reg = codegen_int(cg, node);
+        if (int_reg < 0) return -1;
+        int reg = next_temp(cg);
+        ir_emit(cg->out, "  %%t%d = sitofp i64 %%t%d to double\n", reg, int_reg);
+        return reg;
+    }
+
     switch (node->type) {
         case NODE_NUM: {
             int reg = next_temp(cg);
             double val = node->data.num.value;
-            // Ensure the number has a decimal point for LLVM IR
-            if (val == (long long)val && val >= -1e15 && val <= 1e15) {
-                fprintf(cg->out, "  %%t%d = fadd double 0.0, %.1f\n", reg, val);
+            // Ensure the number has a decimal point for LLVM IR; anything
+            // else (folded fractions, -0.0, NaN, inf) goes out exactly, as hex
+            char literal[64];
+            if (val >= -1e15 && val <= 1e15 && val == (long long)val && !(val == 0 && signbit(val))) {
+                snprintf(literal, sizeof(literal), "%.1f", val);
             } else {
-                fprintf(cg->out, "  %%t%d = fadd double 0.0, %e\n", reg, val);
+                uint64_t bits;
+                memcpy(&bits, &val, sizeof(bits));
+                snprintf(literal, sizeof(literal), "0x%016llX", (unsigned long long)bits);
             }
+            // -0.0 is the identity of fadd, so a folded -0.0 keeps its sign
+            ir_emit(cg->out, "  %%t%d = fadd double -0.0, %s\n", reg, literal);
             return reg;
         }
 
         case NODE_STR: {
             // Strings need runtime support - for now, just return 0
             int reg = next_temp(cg);
-            fprintf(cg->out, "  ; string: \"%s\"\n", node->data.str.value);
-            fprintf(cg->out, "  %%t%d = fadd double 0.0, 0.0\n", reg);
+            ir_emit(cg->out, "  ; string: \"%s\"\n", node->data.str.value);
+            ir_emit(cg->out, "  %%t%d = fadd double 0.0, 0.0\n", reg);
             return reg;
         }
 
         case NODE_BOOL: {
             int reg = next_temp(cg);
-            fprintf(cg->out, "  %%t%d = fadd double 0.0, %d.0\n", reg, node->data.boolean.value ? 1 : 0);
+            ir_emit(cg->out, "  %%t%d = fadd double 0.0, %d.0\n", reg, node->data.boolean.value ? 1 : 0);
             return reg;
         }
 
         case NODE_VAR: {
-            // Check locals first
-            int local_reg = find_local(cg, node->data.var.name);
-            if (local_reg >= 0) {
-                int reg = next_temp(cg);
-                fprintf(cg->out, "  %%t%d = load double, double* %%local%d\n", reg, local_reg);
-                return reg;
+            if (node->data.var.bind == BIND_LOCAL) {
+                return local_value(cg, node->data.var.slot);
             }
 
-            // Check parameters
-            int param_idx = find_param(cg, node->data.var.name);
-            if (param_idx >= 0) {
+            if (node->data.var.bind == BIND_PARAM) {
                 // Parameters are already in registers
                 int reg = next_temp(cg);
-                fprintf(cg->out, "  %%t%d = fadd double 0.0, %%arg%d\n", reg, param_idx);
+                ir_emit(cg->out, "  %%t%d = fadd double 0.0, %%arg%d\n", reg, node->data.var.slot);
                 return reg;
             }
 
-            fprintf(stderr, "Error: Unknown variable '%s'\n", node->data.var.name);
+            fprintf(stderr, "Error: Unknown variable '%s'\n", symbol_name(node->data.var.name));
             return -1;
         }
 
         case NODE_POSITIONAL: {
             // Positional parameter reference (first, second, etc.)
             int reg = next_temp(cg);
-            fprintf(cg->out, "  %%t%d = fadd double 0.0, %%arg%d\n", reg, node->data.positional.index);
+            ir_emit(cg->out, "  %%t%d = fadd double 0.0, %%arg%d\n", reg, node->data.positional.index);
             return reg;
         }
 
         case NODE_BINOP: {
+            if (node->vtype == TYPE_BOOL) {
+                // Comparison or and/or: compute the i1, then widen it
+                int cond_reg = codegen_cond(cg, node);
+                if (cond_reg < 0) return -1;
+                int result_reg = next_temp(cg);
+                ir_emit(cg->out, "  %%t%d = uitofp i1 %%t%d to double\n", result_reg, cond_reg);
+                return result_reg;
+            }
+
             int left_reg = codegen_expr(cg, node->data.binop.left);
             int right_reg = codegen_expr(cg, node->data.binop.right);
             if (left_reg < 0 || right_reg < 0) return -1;
 
             int result_reg = next_temp(cg);
-            const char *op = node->data.binop.op;
-
-            if (strcmp(op, "plus") == 0) {
-                fprintf(cg->out, "  %%t%d = fadd double %%t%d, %%t%d\n", result_reg, left_reg, right_reg);
-            } else if (strcmp(op, "minus") == 0) {
-                fprintf(cg->out, "  %%t%d = fsub double %%t%d, %%t%d\n", result_reg, left_reg, right_reg);
-            } else if (strcmp(op, "times") == 0) {
-                fprintf(cg->out, "  %%t%d = fmul double %%t%d, %%t%d\n", result_reg, left_reg, right_reg);
-            } else if (strcmp(op, "over") == 0) {
-                fprintf(cg->out, "  %%t%d = fdiv double %%t%d, %%t%d\n", result_reg, left_reg, right_reg);
-            } else if (strcmp(op, "mod") == 0) {
-                fprintf(cg->out, "  %%t%d = frem double %%t%d, %%t%d\n", result_reg, left_reg, right_reg);
-            } else if (strcmp(op, "eq") == 0) {
-                int cmp_reg = next_temp(cg);
-                fprintf(cg->out, "  %%t%d = fcmp oeq double %%t%d, %%t%d\n", cmp_reg, left_reg, right_reg);
-                fprintf(cg->out, "  %%t%d = uitofp i1 %%t%d to double\n", result_reg, cmp_reg);
-            } else if (strcmp(op, "neq") == 0) {
-                int cmp_reg = next_temp(cg);
-                fprintf(cg->out, "  %%t%d = fcmp one double %%t%d, %%t%d\n", cmp_reg, left_reg, right_reg);
-                fprintf(cg->out, "  %%t%d = uitofp i1 %%t%d to double\n", result_reg, cmp_reg);
-            } else if (strcmp(op, "lt") == 0) {
-                int cmp_reg = next_temp(cg);
-                fprintf(cg->out, "  %%t%d = fcmp olt double %%t%d, %%t%d\n", cmp_reg, left_reg, right_reg);
-                fprintf(cg->out, "  %%t%d = uitofp i1 %%t%d to double\n", result_reg, cmp_reg);
-            } else if (strcmp(op, "gt") == 0) {
-                int cmp_reg = next_temp(cg);
-                fprintf(cg->out, "  %%t%d = fcmp ogt double %%t%d, %%t%d\n", cmp_reg, left_reg, right_reg);
-                fprintf(cg->out, "  %%t%d = uitofp i1 %%t%d to double\n", result_reg, cmp_reg);
-            } else if (strcmp(op, "lte") == 0) {
-                int cmp_reg = next_temp(cg);
-                fprintf(cg->out, "  %%t%d = fcmp ole double %%t%d, %%t%d\n", cmp_reg, left_reg, right_reg);
-                fprintf(cg->out, "  %%t%d = uitofp i1 %%t%d to double\n", result_reg, cmp_reg);
-            } else if (strcmp(op, "gte") == 0) {
-                int cmp_reg = next_temp(cg);
-                fprintf(cg->out, "  %%t%d = fcmp oge double %%t%d, %%t%d\n", cmp_reg, left_reg, right_reg);
-                fprintf(cg->out, "  %%t%d = uitofp i1 %%t%d to double\n", result_reg, cmp_reg);
-            } else if (strcmp(op, "and") == 0) {
-                // Logical and: both non-zero
-                int left_bool = next_temp(cg);
-                int right_bool = next_temp(cg);
-                int and_reg = next_temp(cg);
-                fprintf(cg->out, "  %%t%d = fcmp one double %%t%d, 0.0\n", left_bool, left_reg);
-                fprintf(cg->out, "  %%t%d = fcmp one double %%t%d, 0.0\n", right_bool, right_reg);
-                fprintf(cg->out, "  %%t%d = and i1 %%t%d, %%t%d\n", and_reg, left_bool, right_bool);
-                fprintf(cg->out, "  %%t%d = uitofp i1 %%t%d to double\n", result_reg, and_reg);
-            } else if (strcmp(op, "or") == 0) {
-                // Logical or: either non-zero
-                int left_bool = next_temp(cg);
-                int right_bool = next_temp(cg);
-                int or_reg = next_temp(cg);
-                fprintf(cg->out, "  %%t%d = fcmp one double %%t%d, 0.0\n", left_bool, left_reg);
-                fprintf(cg->out, "  %%t%d = fcmp one double %%t%d, 0.0\n", right_bool, right_reg);
-                fprintf(cg->out, "  %%t%d = or i1 %%t%d, %%t%d\n", or_reg, left_bool, right_bool);
-                fprintf(cg->out, "  %%t%d = uitofp i1 %%t%d to double\n", result_reg, or_reg);
-            } else {
-                fprintf(stderr, "Error: Unknown operator '%s'\n", op);
-                return -1;
+
+            switch (node->data.binop.op) {
+                case OP_PLUS:
+                case OP_MINUS:
+                case OP_TIMES:
+                case OP_OVER:
+                case OP_MOD:
+                    ir_emit(cg->out, "  %%t%d = %s double %%t%d, %%t%d\n", result_reg,
+                            arith_instruction(node->data.binop.op), left_reg, right_reg);
+                    break;
+                default:
+                    fprintf(stderr, "Error: Unknown operator '%s'\n", op_name(node->data.binop.op));
+                    return -1;
             }
 
             return result_reg;
         }
 
         case NODE_UNARYOP: {
+            if (node->data.unaryop.op == OP_NOT) {
+                int cond_reg = codegen_cond(cg, node);
+                if (cond_reg < 0) return -1;
+                int result_reg = next_temp(cg);
+                ir_emit(cg->out, "  %%t%d = uitofp i1 %%t%d to double\n", result_reg, cond_reg);
+                return result_reg;
+            }
+
             int operand_reg = codegen_expr(cg, node->data.unaryop.operand);
             if (operand_reg < 0) return -1;
 
+            // Negate: 0 - x
             int result_reg = next_temp(cg);
-            if (strcmp(node->data.unaryop.op, "not") == 0) {
-                int bool_reg = next_temp(cg);
-                fprintf(cg->out, "  %%t%d = fcmp oeq double %%t%d, 0.0\n", bool_reg, operand_reg);
-                fprintf(cg->out, "  %%t%d = uitofp i1 %%t%d to double\n", result_reg, bool_reg);
-            } else if (strcmp(node->data.unaryop.op, "neg") == 0) {
-                // Negate: 0 - x
-                fprintf(cg->out, "  %%t%d = fsub double 0.0, %%t%d\n", result_reg, operand_reg);
-            }
-
+            ir_emit(cg->out, "  %%t%d = fsub double 0.0, %%t%d\n", result_reg, operand_reg);
             return result_reg;
         }
 
@@ -445,7 +720,7 @@ static int codegen_expr(CodeGen *cg, ASTNode *node) {
 
             // User-defined function call (no module)
             if (node->data.call.module == NULL) {
-                fprintf(cg->out, "  ; call %s\n", node->data.call.func);
+                ir_emit(cg->out, "  ; call %s\n", node->data.call.func);
 
                 // Evaluate all arguments first
                 size_t argc = node->data.call.args.count;
@@ -455,61 +730,61 @@ static int codegen_expr(CodeGen *cg, ASTNode *node) {
                     return -1;
                 }
                 for (size_t i = 0; i < argc; i++) {
-                    arg_regs[i] = codegen_expr(cg, node->data.call.args.nodes[i]);
+                    arg_regs[i] = codegen_expr(cg, ast_list_nodes(&node->data.call.args)[i]);
                 }
 
                 // Generate call instruction
-                fprintf(cg->out, "  %%t%d = call double @%s(", result_reg, node->data.call.func);
+                ir_emit(cg->out, "  %%t%d = call double @%s(", result_reg, node->data.call.func);
                 for (size_t i = 0; i < node->data.call.args.count; i++) {
-                    if (i > 0) fprintf(cg->out, ", ");
-                    fprintf(cg->out, "double %%t%d", arg_regs[i]);
+                    if (i > 0) ir_emit(cg->out, ", ");
+                    ir_emit(cg->out, "double %%t%d", arg_regs[i]);
                 }
-                fprintf(cg->out, ")\n");
+                ir_emit(cg->out, ")\n");
 
                 free(arg_regs);
                 return result_reg;
             }
 
             // Module calls
-            fprintf(cg->out, "  ; call %s.%s\n", node->data.call.module, node->data.call.func);
+            ir_emit(cg->out, "  ; call %s.%s\n", node->data.call.module, node->data.call.func);
 
             // For math functions, we can use LLVM intrinsics
             if (strcmp(node->data.call.module, "math") == 0) {
                 if (node->data.call.args.count > 0) {
-                    int arg_reg = codegen_expr(cg, node->data.call.args.nodes[0]);
+                    int arg_reg = codegen_expr(cg, ast_list_nodes(&node->data.call.args)[0]);
 
                     if (strcmp(node->data.call.func, "abs") == 0) {
-                        fprintf(cg->out, "  %%t%d = call double @llvm.fabs.f64(double %%t%d)\n", result_reg, arg_reg);
+                        ir_emit(cg->out, "  %%t%d = call double @llvm.fabs.f64(double %%t%d)\n", result_reg, arg_reg);
                         return result_reg;
                     } else if (strcmp(node->data.call.func, "sqrt") == 0) {
-                        fprintf(cg->out, "  %%t%d = call double @llvm.sqrt.f64(double %%t%d)\n", result_reg, arg_reg);
+                        ir_emit(cg->out, "  %%t%d = call double @llvm.sqrt.f64(double %%t%d)\n", result_reg, arg_reg);
                         return result_reg;
                     } else if (strcmp(node->data.call.func, "floor") == 0) {
-                        fprintf(cg->out, "  %%t%d = call double @llvm.floor.f64(double %%t%d)\n", result_reg, arg_reg);
+                        ir_emit(cg->out, "  %%t%d = call double @llvm.floor.f64(double %%t%d)\n", result_reg, arg_reg);
                         return result_reg;
                     } else if (strcmp(node->data.call.func, "ceil") == 0) {
-                        fprintf(cg->out, "  %%t%d = call double @llvm.ceil.f64(double %%t%d)\n", result_reg, arg_reg);
+                        ir_emit(cg->out, "  %%t%d = call double @llvm.ceil.f64(double %%t%d)\n", result_reg, arg_reg);
                         return result_reg;
                     } else if (strcmp(node->data.call.func, "sin") == 0) {
-                        fprintf(cg->out, "  %%t%d = call double @llvm.sin.f64(double %%t%d)\n", result_reg, arg_reg);
+                        ir_emit(cg->out, "  %%t%d = call double @llvm.sin.f64(double %%t%d)\n", result_reg, arg_reg);
                         return result_reg;
                     } else if (strcmp(node->data.call.func, "cos") == 0) {
-                        fprintf(cg->out, "  %%t%d = call double @llvm.cos.f64(double %%t%d)\n", result_reg, arg_reg);
+                        ir_emit(cg->out, "  %%t%d = call double @llvm.cos.f64(double %%t%d)\n", result_reg, arg_reg);
                         return result_reg;
                     }
 
                     if (node->data.call.args.count > 1) {
-                        int arg2_reg = codegen_expr(cg, node->data.call.args.nodes[1]);
+                        int arg2_reg = codegen_expr(cg, ast_list_nodes(&node->data.call.args)[1]);
                         if (strcmp(node->data.call.func, "min") == 0) {
-                            fprintf(cg->out, "  %%t%d = call double @llvm.minnum.f64(double %%t%d, double %%t%d)\n",
+                            ir_emit(cg->out, "  %%t%d = call double @llvm.minnum.f64(double %%t%d, double %%t%d)\n",
                                     result_reg, arg_reg, arg2_reg);
                             return result_reg;
                         } else if (strcmp(node->data.call.func, "max") == 0) {
-                            fprintf(cg->out, "  %%t%d = call double @llvm.maxnum.f64(double %%t%d, double %%t%d)\n",
+                            ir_emit(cg->out, "  %%t%d = call double @llvm.maxnum.f64(double %%t%d, double %%t%d)\n",
                                     result_reg, arg_reg, arg2_reg);
                             return result_reg;
                         } else if (strcmp(node->data.call.func, "pow") == 0) {
-                            fprintf(cg->out, "  %%t%d = call double @llvm.pow.f64(double %%t%d, double %%t%d)\n",
+                            ir_emit(cg->out, "  %%t%d = call double @llvm.pow.f64(double %%t%d, double %%t%d)\n",
                                     result_reg, arg_reg, arg2_reg);
                             return result_reg;
                         }
@@ -521,7 +796,7 @@ static int codegen_expr(CodeGen *cg, ASTNode *node) {
             if (strcmp(node->data.call.module, "http") == 0) {
                 if (node->data.call.args.count > 0) {
                     // Get URL argument (must be a string literal)
-                    ASTNode *url_node = node->data.call.args.nodes[0];
+                    ASTNode *url_node = ast_list_nodes(&node->data.call.args)[0];
                     
                     // Check for headers/auth markers
                     int has_auth_bearer = 0;
@@ -535,7 +810,7 @@ static int codegen_expr(CodeGen *cg, ASTNode *node) {
                                        strcmp(node->data.call.func, "delete") == 0) ? 1 : 2;
                     
                     for (size_t i = body_offset; i < node->data.call.args.count; i++) {
-                        ASTNode *arg = node->data.call.args.nodes[i];
+                        ASTNode *arg = ast_list_nodes(&node->data.call.args)[i];
                         if (arg->type == NODE_STR) {
                             if (strcmp(arg->data.str.value, "__auth_bearer__") == 0) {
                                 has_auth_bearer = 1;
@@ -557,7 +832,7 @@ static int codegen_expr(CodeGen *cg, ASTNode *node) {
                             int url_idx = cg->string_counter++;
                             size_t url_len = actual_string_len(url_node->data.str.value) + 1;
                             int url_ptr = next_temp(cg);
-                            fprintf(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
+                            ir_emit(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
                                     url_ptr, url_len, url_len, url_idx);
                             
                             int headers_ptr = 0;  // Will be null or pointer to headers JSON
@@ -566,24 +841,24 @@ static int codegen_expr(CodeGen *cg, ASTNode *node) {
                                 // Build headers with Bearer auth
                                 // Skip the marker string index (it was collected by collect_strings)
                                 cg->string_counter++;  // Skip "__auth_bearer__" marker
-                                ASTNode *token_node = node->data.call.args.nodes[auth_idx + 1];
+                                ASTNode *token_node = ast_list_nodes(&node->data.call.args)[auth_idx + 1];
                                 if (token_node->type == NODE_STR) {
                                     int token_idx = cg->string_counter++;
                                     size_t token_len = actual_string_len(token_node->data.str.value) + 1;
                                     int token_ptr = next_temp(cg);
-                                    fprintf(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
+                                    ir_emit(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
                                             token_ptr, token_len, token_len, token_idx);
                                     
                                     headers_ptr = next_temp(cg);
-                                    fprintf(cg->out, "  %%t%d = call i8* @nerd_http_auth_bearer(i8* %%t%d)\n", 
+                                    ir_emit(cg->out, "  %%t%d = call i8* @nerd_http_auth_bearer(i8* %%t%d)\n", 
                                             headers_ptr, token_ptr);
                                 }
                             } else if (has_auth_basic && auth_idx >= 0 && (size_t)(auth_idx + 2) < node->data.call.args.count) {
                                 // Build headers with Basic auth
                                 // Skip the marker string index (it was collected by collect_strings)
                                 cg->string_counter++;  // Skip "__auth_basic__" marker
-                                ASTNode *user_node = node->data.call.args.nodes[auth_idx + 1];
-                                ASTNode *pass_node = node->data.call.args.nodes[auth_idx + 2];
+                                ASTNode *user_node = ast_list_nodes(&node->data.call.args)[auth_idx + 1];
+                                ASTNode *pass_node = ast_list_nodes(&node->data.call.args)[auth_idx + 2];
                                 if (user_node->type == NODE_STR && pass_node->type == NODE_STR) {
                                     int user_idx = cg->string_counter++;
                                     int pass_idx = cg->string_counter++;
@@ -591,25 +866,25 @@ static int codegen_expr(CodeGen *cg, ASTNode *node) {
                                     size_t pass_len = actual_string_len(pass_node->data.str.value) + 1;
                                     
                                     int user_ptr = next_temp(cg);
-                                    fprintf(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
+                                    ir_emit(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
                                             user_ptr, user_len, user_len, user_idx);
                                     int pass_ptr = next_temp(cg);
-                                    fprintf(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
+                                    ir_emit(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
                                             pass_ptr, pass_len, pass_len, pass_idx);
                                     
                                     headers_ptr = next_temp(cg);
-                                    fprintf(cg->out, "  %%t%d = call i8* @nerd_http_auth_basic(i8* %%t%d, i8* %%t%d)\n", 
+                                    ir_emit(cg->out, "  %%t%d = call i8* @nerd_http_auth_basic(i8* %%t%d, i8* %%t%d)\n", 
                                             headers_ptr, user_ptr, pass_ptr);
                                 }
                             } else if (header_start >= 0) {
                                 // Build headers JSON from with pairs
                                 headers_ptr = next_temp(cg);
-                                fprintf(cg->out, "  %%t%d = call i8* @nerd_json_new()\n", headers_ptr);
+                                ir_emit(cg->out, "  %%t%d = call i8* @nerd_json_new()\n", headers_ptr);
                                 
                                 // Process header pairs
                                 for (size_t i = header_start; i + 1 < node->data.call.args.count; i += 2) {
-                                    ASTNode *hname = node->data.call.args.nodes[i];
-                                    ASTNode *hvalue = node->data.call.args.nodes[i + 1];
+                                    ASTNode *hname = ast_list_nodes(&node->data.call.args)[i];
+                                    ASTNode *hvalue = ast_list_nodes(&node->data.call.args)[i + 1];
                                     
                                     // Skip auth markers
                                     if (hname->type == NODE_STR && 
@@ -625,13 +900,13 @@ static int codegen_expr(CodeGen *cg, ASTNode *node) {
                                         size_t hvalue_len = actual_string_len(hvalue->data.str.value) + 1;
                                         
                                         int hname_ptr = next_temp(cg);
-                                        fprintf(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
+                                        ir_emit(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
                                                 hname_ptr, hname_len, hname_len, hname_idx);
                                         int hvalue_ptr = next_temp(cg);
-                                        fprintf(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
+                                        ir_emit(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
                                                 hvalue_ptr, hvalue_len, hvalue_len, hvalue_idx);
                                         
-                                        fprintf(cg->out, "  call void @nerd_json_set_string(i8* %%t%d, i8* %%t%d, i8* %%t%d)\n",
+                                        ir_emit(cg->out, "  call void @nerd_json_set_string(i8* %%t%d, i8* %%t%d, i8* %%t%d)\n",
                                                 headers_ptr, hname_ptr, hvalue_ptr);
                                     }
                                 }
@@ -640,32 +915,32 @@ static int codegen_expr(CodeGen *cg, ASTNode *node) {
                             // Call http_get_full with headers (or null)
                             int response_ptr = next_temp(cg);
                             if (headers_ptr > 0) {
-                                fprintf(cg->out, "  %%t%d = call i8* @nerd_http_get_full(i8* %%t%d, i8* %%t%d)\n", 
+                                ir_emit(cg->out, "  %%t%d = call i8* @nerd_http_get_full(i8* %%t%d, i8* %%t%d)\n", 
                                         response_ptr, url_ptr, headers_ptr);
                             } else {
-                                fprintf(cg->out, "  %%t%d = call i8* @nerd_http_get_full(i8* %%t%d, i8* null)\n", 
+                                ir_emit(cg->out, "  %%t%d = call i8* @nerd_http_get_full(i8* %%t%d, i8* null)\n", 
                                         response_ptr, url_ptr);
                             }
                             
                             // Print response via JSON stringify
                             int str_ptr = next_temp(cg);
-                            fprintf(cg->out, "  %%t%d = call i8* @nerd_json_stringify(i8* %%t%d)\n", str_ptr, response_ptr);
-                            fprintf(cg->out, "  call i32 (i8*, ...) @printf(i8* getelementptr ([4 x i8], [4 x i8]* @.fmt_str, i32 0, i32 0), i8* %%t%d)\n", str_ptr);
-                            fprintf(cg->out, "  call void @nerd_json_free_string(i8* %%t%d)\n", str_ptr);
-                            fprintf(cg->out, "  call void @nerd_json_free(i8* %%t%d)\n", response_ptr);
+                            ir_emit(cg->out, "  %%t%d = call i8* @nerd_json_stringify(i8* %%t%d)\n", str_ptr, response_ptr);
+                            ir_emit(cg->out, "  call i32 (i8*, ...) @printf(i8* getelementptr ([4 x i8], [4 x i8]* @.fmt_str, i32 0, i32 0), i8* %%t%d)\n", str_ptr);
+                            ir_emit(cg->out, "  call void @nerd_json_free_string(i8* %%t%d)\n", str_ptr);
+                            ir_emit(cg->out, "  call void @nerd_json_free(i8* %%t%d)\n", response_ptr);
                             
                             if (headers_ptr > 0) {
-                                fprintf(cg->out, "  call void @nerd_json_free(i8* %%t%d)\n", headers_ptr);
+                                ir_emit(cg->out, "  call void @nerd_json_free(i8* %%t%d)\n", headers_ptr);
                             }
                         }
 
-                        fprintf(cg->out, "  %%t%d = fadd double 0.0, 0.0\n", result_reg);
+                        ir_emit(cg->out, "  %%t%d = fadd double 0.0, 0.0\n", result_reg);
                         return result_reg;
                     }
 
                     // HTTP POST (with body and optional headers/auth)
                     if (strcmp(node->data.call.func, "post") == 0 && node->data.call.args.count >= 2) {
-                        ASTNode *body_node = node->data.call.args.nodes[1];
+                        ASTNode *body_node = ast_list_nodes(&node->data.call.args)[1];
 
                         if (url_node->type == NODE_STR && body_node->type == NODE_STR) {
                             int url_idx = cg->string_counter++;
@@ -675,11 +950,11 @@ static int codegen_expr(CodeGen *cg, ASTNode *node) {
                             size_t body_len = actual_string_len(body_node->data.str.value) + 1;
 
                             int url_ptr = next_temp(cg);
-                            fprintf(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
+                            ir_emit(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
                                     url_ptr, url_len, url_len, url_idx);
 
                             int body_ptr = next_temp(cg);
-                            fprintf(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
+                            ir_emit(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
                                     body_ptr, body_len, body_len, body_idx);
 
                             // Check for headers/auth (body_offset=2 for POST)
@@ -687,23 +962,23 @@ static int codegen_expr(CodeGen *cg, ASTNode *node) {
                             
                             if (has_auth_bearer && auth_idx >= 0 && (size_t)(auth_idx + 1) < node->data.call.args.count) {
                                 cg->string_counter++;  // Skip marker
-                                ASTNode *token_node = node->data.call.args.nodes[auth_idx + 1];
+                                ASTNode *token_node = ast_list_nodes(&node->data.call.args)[auth_idx + 1];
                                 if (token_node->type == NODE_STR) {
                                     int token_idx = cg->string_counter++;
                                     size_t token_len = actual_string_len(token_node->data.str.value) + 1;
                                     int token_ptr = next_temp(cg);
-                                    fprintf(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
+                                    ir_emit(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
                                             token_ptr, token_len, token_len, token_idx);
                                     headers_ptr = next_temp(cg);
-                                    fprintf(cg->out, "  %%t%d = call i8* @nerd_http_auth_bearer(i8* %%t%d)\n",
+                                    ir_emit(cg->out, "  %%t%d = call i8* @nerd_http_auth_bearer(i8* %%t%d)\n",
                                             headers_ptr, token_ptr);
                                 }
                             } else if (header_start >= 0) {
                                 headers_ptr = next_temp(cg);
-                                fprintf(cg->out, "  %%t%d = call i8* @nerd_json_new()\n", headers_ptr);
+                                ir_emit(cg->out, "  %%t%d = call i8* @nerd_json_new()\n", headers_ptr);
                                 for (size_t i = header_start; i + 1 < node->data.call.args.count; i += 2) {
-                                    ASTNode *hname = node->data.call.args.nodes[i];
-                                    ASTNode *hvalue = node->data.call.args.nodes[i + 1];
+                                    ASTNode *hname = ast_list_nodes(&node->data.call.args)[i];
+                                    ASTNode *hvalue = ast_list_nodes(&node->data.call.args)[i + 1];
                                     if (hname->type == NODE_STR && 
                                         (strcmp(hname->data.str.value, "__auth_bearer__") == 0 ||
                                          strcmp(hname->data.str.value, "__auth_basic__") == 0)) break;
@@ -714,11 +989,11 @@ static int codegen_expr(CodeGen *cg, ASTNode *node) {
                                         size_t hlen2 = actual_string_len(hvalue->data.str.value) + 1;
                                         int hp1 = next_temp(cg);
                                         int hp2 = next_temp(cg);
-                                        fprintf(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
+                                        ir_emit(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
                                                 hp1, hlen1, hlen1, hidx1);
-                                        fprintf(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
+                                        ir_emit(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
                                                 hp2, hlen2, hlen2, hidx2);
-                                        fprintf(cg->out, "  call void @nerd_json_set_string(i8* %%t%d, i8* %%t%d, i8* %%t%d)\n",
+                                        ir_emit(cg->out, "  call void @nerd_json_set_string(i8* %%t%d, i8* %%t%d, i8* %%t%d)\n",
                                                 headers_ptr, hp1, hp2);
                                     }
                                 }
@@ -727,31 +1002,31 @@ static int codegen_expr(CodeGen *cg, ASTNode *node) {
                             // Call http_post_full with headers
                             int response_ptr = next_temp(cg);
                             if (headers_ptr > 0) {
-                                fprintf(cg->out, "  %%t%d = call i8* @nerd_http_post_full(i8* %%t%d, i8* %%t%d, i8* %%t%d)\n",
+                                ir_emit(cg->out, "  %%t%d = call i8* @nerd_http_post_full(i8* %%t%d, i8* %%t%d, i8* %%t%d)\n",
                                         response_ptr, url_ptr, body_ptr, headers_ptr);
                             } else {
-                                fprintf(cg->out, "  %%t%d = call i8* @nerd_http_post_full(i8* %%t%d, i8* %%t%d, i8* null)\n",
+                                ir_emit(cg->out, "  %%t%d = call i8* @nerd_http_post_full(i8* %%t%d, i8* %%t%d, i8* null)\n",
                                         response_ptr, url_ptr, body_ptr);
                             }
 
                             // Print response via JSON stringify
                             int str_ptr = next_temp(cg);
-                            fprintf(cg->out, "  %%t%d = call i8* @nerd_json_stringify(i8* %%t%d)\n", str_ptr, response_ptr);
-                            fprintf(cg->out, "  call i32 (i8*, ...) @printf(i8* getelementptr ([4 x i8], [4 x i8]* @.fmt_str, i32 0, i32 0), i8* %%t%d)\n", str_ptr);
-                            fprintf(cg->out, "  call void @nerd_json_free_string(i8* %%t%d)\n", str_ptr);
-                            fprintf(cg->out, "  call void @nerd_json_free(i8* %%t%d)\n", response_ptr);
+                            ir_emit(cg->out, "  %%t%d = call i8* @nerd_json_stringify(i8* %%t%d)\n", str_ptr, response_ptr);
+                            ir_emit(cg->out, "  call i32 (i8*, ...) @printf(i8* getelementptr ([4 x i8], [4 x i8]* @.fmt_str, i32 0, i32 0), i8* %%t%d)\n", str_ptr);
+                            ir_emit(cg->out, "  call void @nerd_json_free_string(i8* %%t%d)\n", str_ptr);
+                            ir_emit(cg->out, "  call void @nerd_json_free(i8* %%t%d)\n", response_ptr);
                             if (headers_ptr > 0) {
-                                fprintf(cg->out, "  call void @nerd_json_free(i8* %%t%d)\n", headers_ptr);
+                                ir_emit(cg->out, "  call void @nerd_json_free(i8* %%t%d)\n", headers_ptr);
                             }
                         }
 
-                        fprintf(cg->out, "  %%t%d = fadd double 0.0, 0.0\n", result_reg);
+                        ir_emit(cg->out, "  %%t%d = fadd double 0.0, 0.0\n", result_reg);
                         return result_reg;
                     }
 
                     // HTTP PUT (with body)
                     if (strcmp(node->data.call.func, "put") == 0 && node->data.call.args.count >= 2) {
-                        ASTNode *body_node = node->data.call.args.nodes[1];
+                        ASTNode *body_node = ast_list_nodes(&node->data.call.args)[1];
 
                         if (url_node->type == NODE_STR && body_node->type == NODE_STR) {
                             int url_idx = cg->string_counter++;
@@ -761,27 +1036,27 @@ static int codegen_expr(CodeGen *cg, ASTNode *node) {
                             size_t body_len = actual_string_len(body_node->data.str.value) + 1;
 
                             int url_ptr = next_temp(cg);
-                            fprintf(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
+                            ir_emit(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
                                     url_ptr, url_len, url_len, url_idx);
 
                             int body_ptr = next_temp(cg);
-                            fprintf(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
+                            ir_emit(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
                                     body_ptr, body_len, body_len, body_idx);
 
                             // Call http_put (null headers for now)
                             int response_ptr = next_temp(cg);
-                            fprintf(cg->out, "  %%t%d = call i8* @nerd_http_put(i8* %%t%d, i8* %%t%d, i8* null)\n",
+                            ir_emit(cg->out, "  %%t%d = call i8* @nerd_http_put(i8* %%t%d, i8* %%t%d, i8* null)\n",
                                     response_ptr, url_ptr, body_ptr);
 
                             // Print response via JSON stringify
                             int str_ptr = next_temp(cg);
-                            fprintf(cg->out, "  %%t%d = call i8* @nerd_json_stringify(i8* %%t%d)\n", str_ptr, response_ptr);
-                            fprintf(cg->out, "  call i32 (i8*, ...) @printf(i8* getelementptr ([4 x i8], [4 x i8]* @.fmt_str, i32 0, i32 0), i8* %%t%d)\n", str_ptr);
-                            fprintf(cg->out, "  call void @nerd_json_free_string(i8* %%t%d)\n", str_ptr);
-                            fprintf(cg->out, "  call void @nerd_json_free(i8* %%t%d)\n", response_ptr);
+                            ir_emit(cg->out, "  %%t%d = call i8* @nerd_json_stringify(i8* %%t%d)\n", str_ptr, response_ptr);
+                            ir_emit(cg->out, "  call i32 (i8*, ...) @printf(i8* getelementptr ([4 x i8], [4 x i8]* @.fmt_str, i32 0, i32 0), i8* %%t%d)\n", str_ptr);
+                            ir_emit(cg->out, "  call void @nerd_json_free_string(i8* %%t%d)\n", str_ptr);
+                            ir_emit(cg->out, "  call void @nerd_json_free(i8* %%t%d)\n", response_ptr);
                         }
 
-                        fprintf(cg->out, "  %%t%d = fadd double 0.0, 0.0\n", result_reg);
+                        ir_emit(cg->out, "  %%t%d = fadd double 0.0, 0.0\n", result_reg);
                         return result_reg;
                     }
 
@@ -792,29 +1067,29 @@ static int codegen_expr(CodeGen *cg, ASTNode *node) {
                             size_t url_len = actual_string_len(url_node->data.str.value) + 1;
 
                             int url_ptr = next_temp(cg);
-                            fprintf(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
+                            ir_emit(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
                                     url_ptr, url_len, url_len, url_idx);
 
                             // Call http_delete (null headers for now)
                             int response_ptr = next_temp(cg);
-                            fprintf(cg->out, "  %%t%d = call i8* @nerd_http_delete(i8* %%t%d, i8* null)\n",
+                            ir_emit(cg->out, "  %%t%d = call i8* @nerd_http_delete(i8* %%t%d, i8* null)\n",
                                     response_ptr, url_ptr);
 
                             // Print response via JSON stringify
                             int str_ptr = next_temp(cg);
-                            fprintf(cg->out, "  %%t%d = call i8* @nerd_json_stringify(i8* %%t%d)\n", str_ptr, response_ptr);
-                            fprintf(cg->out, "  call i32 (i8*, ...) @printf(i8* getelementptr ([4 x i8], [4 x i8]* @.fmt_str, i32 0, i32 0), i8* %%t%d)\n", str_ptr);
-                            fprintf(cg->out, "  call void @nerd_json_free_string(i8* %%t%d)\n", str_ptr);
-                            fprintf(cg->out, "  call void @nerd_json_free(i8* %%t%d)\n", response_ptr);
+                            ir_emit(cg->out, "  %%t%d = call i8* @nerd_json_stringify(i8* %%t%d)\n", str_ptr, response_ptr);
+                            ir_emit(cg->out, "  call i32 (i8*, ...) @printf(i8* getelementptr ([4 x i8], [4 x i8]* @.fmt_str, i32 0, i32 0), i8* %%t%d)\n", str_ptr);
+                            ir_emit(cg->out, "  call void @nerd_json_free_string(i8* %%t%d)\n", str_ptr);
+                            ir_emit(cg->out, "  call void @nerd_json_free(i8* %%t%d)\n", response_ptr);
                         }
 
-                        fprintf(cg->out, "  %%t%d = fadd double 0.0, 0.0\n", result_reg);
+                        ir_emit(cg->out, "  %%t%d = fadd double 0.0, 0.0\n", result_reg);
                         return result_reg;
                     }
 
                     // HTTP PATCH (with body)
                     if (strcmp(node->data.call.func, "patch") == 0 && node->data.call.args.count >= 2) {
-                        ASTNode *body_node = node->data.call.args.nodes[1];
+                        ASTNode *body_node = ast_list_nodes(&node->data.call.args)[1];
 
                         if (url_node->type == NODE_STR && body_node->type == NODE_STR) {
                             int url_idx = cg->string_counter++;
@@ -824,27 +1099,27 @@ static int codegen_expr(CodeGen *cg, ASTNode *node) {
                             size_t body_len = actual_string_len(body_node->data.str.value) + 1;
 
                             int url_ptr = next_temp(cg);
-                            fprintf(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
+                            ir_emit(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
                                     url_ptr, url_len, url_len, url_idx);
 
                             int body_ptr = next_temp(cg);
-                            fprintf(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
+                            ir_emit(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
                                     body_ptr, body_len, body_len, body_idx);
 
                             // Call http_patch (null headers for now)
                             int response_ptr = next_temp(cg);
-                            fprintf(cg->out, "  %%t%d = call i8* @nerd_http_patch(i8* %%t%d, i8* %%t%d, i8* null)\n",
+                            ir_emit(cg->out, "  %%t%d = call i8* @nerd_http_patch(i8* %%t%d, i8* %%t%d, i8* null)\n",
                                     response_ptr, url_ptr, body_ptr);
 
                             // Print response via JSON stringify
                             int str_ptr = next_temp(cg);
-                            fprintf(cg->out, "  %%t%d = call i8* @nerd_json_stringify(i8* %%t%d)\n", str_ptr, response_ptr);
-                            fprintf(cg->out, "  call i32 (i8*, ...) @printf(i8* getelementptr ([4 x i8], [4 x i8]* @.fmt_str, i32 0, i32 0), i8* %%t%d)\n", str_ptr);
-                            fprintf(cg->out, "  call void @nerd_json_free_string(i8* %%t%d)\n", str_ptr);
-                            fprintf(cg->out, "  call void @nerd_json_free(i8* %%t%d)\n", response_ptr);
+                            ir_emit(cg->out, "  %%t%d = call i8* @nerd_json_stringify(i8* %%t%d)\n", str_ptr, response_ptr);
+                            ir_emit(cg->out, "  call i32 (i8*, ...) @printf(i8* getelementptr ([4 x i8], [4 x i8]* @.fmt_str, i32 0, i32 0), i8* %%t%d)\n", str_ptr);
+                            ir_emit(cg->out, "  call void @nerd_json_free_string(i8* %%t%d)\n", str_ptr);
+                            ir_emit(cg->out, "  call void @nerd_json_free(i8* %%t%d)\n", response_ptr);
                         }
 
-                        fprintf(cg->out, "  %%t%d = fadd double 0.0, 0.0\n", result_reg);
+                        ir_emit(cg->out, "  %%t%d = fadd double 0.0, 0.0\n", result_reg);
                         return result_reg;
                     }
                 }
@@ -853,7 +1128,7 @@ static int codegen_expr(CodeGen *cg, ASTNode *node) {
             // MCP module calls
             if (strcmp(node->data.call.module, "mcp") == 0) {
                 if (node->data.call.args.count >= 1) {
-                    ASTNode *url_node = node->data.call.args.nodes[0];
+                    ASTNode *url_node = ast_list_nodes(&node->data.call.args)[0];
 
                     // mcp tools url - list tools from MCP server
                     if (strcmp(node->data.call.func, "tools") == 0) {
@@ -862,25 +1137,25 @@ static int codegen_expr(CodeGen *cg, ASTNode *node) {
                             size_t url_len = actual_string_len(url_node->data.str.value) + 1;
 
                             int url_ptr = next_temp(cg);
-                            fprintf(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
+                            ir_emit(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
                                     url_ptr, url_len, url_len, url_idx);
 
                             // Call mcp_list
                             int response_ptr = next_temp(cg);
-                            fprintf(cg->out, "  %%t%d = call i8* @nerd_mcp_list(i8* %%t%d)\n", response_ptr, url_ptr);
+                            ir_emit(cg->out, "  %%t%d = call i8* @nerd_mcp_list(i8* %%t%d)\n", response_ptr, url_ptr);
 
                             // Free response
-                            fprintf(cg->out, "  call void @nerd_mcp_free(i8* %%t%d)\n", response_ptr);
+                            ir_emit(cg->out, "  call void @nerd_mcp_free(i8* %%t%d)\n", response_ptr);
                         }
 
-                        fprintf(cg->out, "  %%t%d = fadd double 0.0, 0.0\n", result_reg);
+                        ir_emit(cg->out, "  %%t%d = fadd double 0.0, 0.0\n", result_reg);
                         return result_reg;
                     }
 
                     // mcp send url tool_name args_json - call a tool
                     if (strcmp(node->data.call.func, "send") == 0 && node->data.call.args.count >= 3) {
-                        ASTNode *tool_node = node->data.call.args.nodes[1];
-                        ASTNode *args_node = node->data.call.args.nodes[2];
+                        ASTNode *tool_node = ast_list_nodes(&node->data.call.args)[1];
+                        ASTNode *args_node = ast_list_nodes(&node->data.call.args)[2];
 
                         if (url_node->type == NODE_STR && tool_node->type == NODE_STR && args_node->type == NODE_STR) {
                             int url_idx = cg->string_counter++;
@@ -892,27 +1167,27 @@ static int codegen_expr(CodeGen *cg, ASTNode *node) {
                             size_t args_len = actual_string_len(args_node->data.str.value) + 1;
 
                             int url_ptr = next_temp(cg);
-                            fprintf(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
+                            ir_emit(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
                                     url_ptr, url_len, url_len, url_idx);
 
                             int tool_ptr = next_temp(cg);
-                            fprintf(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
+                            ir_emit(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
                                     tool_ptr, tool_len, tool_len, tool_idx);
 
                             int args_ptr = next_temp(cg);
-                            fprintf(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
+                            ir_emit(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
                                     args_ptr, args_len, args_len, args_idx);
 
                             // Call mcp_send
                             int response_ptr = next_temp(cg);
-                            fprintf(cg->out, "  %%t%d = call i8* @nerd_mcp_send(i8* %%t%d, i8* %%t%d, i8* %%t%d)\n",
+                            ir_emit(cg->out, "  %%t%d = call i8* @nerd_mcp_send(i8* %%t%d, i8* %%t%d, i8* %%t%d)\n",
                                     response_ptr, url_ptr, tool_ptr, args_ptr);
 
                             // Free response
-                            fprintf(cg->out, "  call void @nerd_mcp_free(i8* %%t%d)\n", response_ptr);
+                            ir_emit(cg->out, "  call void @nerd_mcp_free(i8* %%t%d)\n", response_ptr);
                         }
 
-                        fprintf(cg->out, "  %%t%d = fadd double 0.0, 0.0\n", result_reg);
+                        ir_emit(cg->out, "  %%t%d = fadd double 0.0, 0.0\n", result_reg);
                         return result_reg;
                     }
 
@@ -923,25 +1198,25 @@ static int codegen_expr(CodeGen *cg, ASTNode *node) {
                             size_t url_len = actual_string_len(url_node->data.str.value) + 1;
 
                             int url_ptr = next_temp(cg);
-                            fprintf(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
+                            ir_emit(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
                                     url_ptr, url_len, url_len, url_idx);
 
                             // Call mcp_init
                             int response_ptr = next_temp(cg);
-                            fprintf(cg->out, "  %%t%d = call i8* @nerd_mcp_init(i8* %%t%d)\n", response_ptr, url_ptr);
+                            ir_emit(cg->out, "  %%t%d = call i8* @nerd_mcp_init(i8* %%t%d)\n", response_ptr, url_ptr);
 
                             // Free response
-                            fprintf(cg->out, "  call void @nerd_mcp_free(i8* %%t%d)\n", response_ptr);
+                            ir_emit(cg->out, "  call void @nerd_mcp_free(i8* %%t%d)\n", response_ptr);
                         }
 
-                        fprintf(cg->out, "  %%t%d = fadd double 0.0, 0.0\n", result_reg);
+                        ir_emit(cg->out, "  %%t%d = fadd double 0.0, 0.0\n", result_reg);
                         return result_reg;
                     }
 
                     // mcp use url tool_name args_json - use a tool (natural English alias for send)
                     if (strcmp(node->data.call.func, "use") == 0 && node->data.call.args.count >= 3) {
-                        ASTNode *tool_node = node->data.call.args.nodes[1];
-                        ASTNode *args_node = node->data.call.args.nodes[2];
+                        ASTNode *tool_node = ast_list_nodes(&node->data.call.args)[1];
+                        ASTNode *args_node = ast_list_nodes(&node->data.call.args)[2];
 
                         if (url_node->type == NODE_STR && tool_node->type == NODE_STR && args_node->type == NODE_STR) {
                             int url_idx = cg->string_counter++;
@@ -953,27 +1228,27 @@ static int codegen_expr(CodeGen *cg, ASTNode *node) {
                             size_t args_len = actual_string_len(args_node->data.str.value) + 1;
 
                             int url_ptr = next_temp(cg);
-                            fprintf(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
+                            ir_emit(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
                                     url_ptr, url_len, url_len, url_idx);
 
                             int tool_ptr = next_temp(cg);
-                            fprintf(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
+                            ir_emit(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
                                     tool_ptr, tool_len, tool_len, tool_idx);
 
                             int args_ptr = next_temp(cg);
-                            fprintf(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
+                            ir_emit(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
                                     args_ptr, args_len, args_len, args_idx);
 
                             // Call mcp_use (alias for mcp_send)
                             int response_ptr = next_temp(cg);
-                            fprintf(cg->out, "  %%t%d = call i8* @nerd_mcp_use(i8* %%t%d, i8* %%t%d, i8* %%t%d)\n",
+                            ir_emit(cg->out, "  %%t%d = call i8* @nerd_mcp_use(i8* %%t%d, i8* %%t%d, i8* %%t%d)\n",
                                     response_ptr, url_ptr, tool_ptr, args_ptr);
 
                             // Free response
-                            fprintf(cg->out, "  call void @nerd_mcp_free(i8* %%t%d)\n", response_ptr);
+                            ir_emit(cg->out, "  call void @nerd_mcp_free(i8* %%t%d)\n", response_ptr);
                         }
 
-                        fprintf(cg->out, "  %%t%d = fadd double 0.0, 0.0\n", result_reg);
+                        ir_emit(cg->out, "  %%t%d = fadd double 0.0, 0.0\n", result_reg);
                         return result_reg;
                     }
 
@@ -984,24 +1259,24 @@ static int codegen_expr(CodeGen *cg, ASTNode *node) {
                             size_t url_len = actual_string_len(url_node->data.str.value) + 1;
 
                             int url_ptr = next_temp(cg);
-                            fprintf(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
+                            ir_emit(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
                                     url_ptr, url_len, url_len, url_idx);
 
                             // Call mcp_resources
                             int response_ptr = next_temp(cg);
-                            fprintf(cg->out, "  %%t%d = call i8* @nerd_mcp_resources(i8* %%t%d)\n", response_ptr, url_ptr);
+                            ir_emit(cg->out, "  %%t%d = call i8* @nerd_mcp_resources(i8* %%t%d)\n", response_ptr, url_ptr);
 
                             // Free response
-                            fprintf(cg->out, "  call void @nerd_mcp_free(i8* %%t%d)\n", response_ptr);
+                            ir_emit(cg->out, "  call void @nerd_mcp_free(i8* %%t%d)\n", response_ptr);
                         }
 
-                        fprintf(cg->out, "  %%t%d = fadd double 0.0, 0.0\n", result_reg);
+                        ir_emit(cg->out, "  %%t%d = fadd double 0.0, 0.0\n", result_reg);
                         return result_reg;
                     }
 
                     // mcp read url uri - read a resource
                     if (strcmp(node->data.call.func, "read") == 0 && node->data.call.args.count >= 2) {
-                        ASTNode *uri_node = node->data.call.args.nodes[1];
+                        ASTNode *uri_node = ast_list_nodes(&node->data.call.args)[1];
 
                         if (url_node->type == NODE_STR && uri_node->type == NODE_STR) {
                             int url_idx = cg->string_counter++;
@@ -1011,23 +1286,23 @@ static int codegen_expr(CodeGen *cg, ASTNode *node) {
                             size_t uri_len = actual_string_len(uri_node->data.str.value) + 1;
 
                             int url_ptr = next_temp(cg);
-                            fprintf(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
+                            ir_emit(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
                                     url_ptr, url_len, url_len, url_idx);
 
                             int uri_ptr = next_temp(cg);
-                            fprintf(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
+                            ir_emit(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
                                     uri_ptr, uri_len, uri_len, uri_idx);
 
                             // Call mcp_read
                             int response_ptr = next_temp(cg);
-                            fprintf(cg->out, "  %%t%d = call i8* @nerd_mcp_read(i8* %%t%d, i8* %%t%d)\n",
+                            ir_emit(cg->out, "  %%t%d = call i8* @nerd_mcp_read(i8* %%t%d, i8* %%t%d)\n",
                                     response_ptr, url_ptr, uri_ptr);
 
                             // Free response
-                            fprintf(cg->out, "  call void @nerd_mcp_free(i8* %%t%d)\n", response_ptr);
+                            ir_emit(cg->out, "  call void @nerd_mcp_free(i8* %%t%d)\n", response_ptr);
                         }
 
-                        fprintf(cg->out, "  %%t%d = fadd double 0.0, 0.0\n", result_reg);
+                        ir_emit(cg->out, "  %%t%d = fadd double 0.0, 0.0\n", result_reg);
                         return result_reg;
                     }
 
@@ -1038,25 +1313,25 @@ static int codegen_expr(CodeGen *cg, ASTNode *node) {
                             size_t url_len = actual_string_len(url_node->data.str.value) + 1;
 
                             int url_ptr = next_temp(cg);
-                            fprintf(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
+                            ir_emit(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
                                     url_ptr, url_len, url_len, url_idx);
 
                             // Call mcp_prompts
                             int response_ptr = next_temp(cg);
-                            fprintf(cg->out, "  %%t%d = call i8* @nerd_mcp_prompts(i8* %%t%d)\n", response_ptr, url_ptr);
+                            ir_emit(cg->out, "  %%t%d = call i8* @nerd_mcp_prompts(i8* %%t%d)\n", response_ptr, url_ptr);
 
                             // Free response
-                            fprintf(cg->out, "  call void @nerd_mcp_free(i8* %%t%d)\n", response_ptr);
+                            ir_emit(cg->out, "  call void @nerd_mcp_free(i8* %%t%d)\n", response_ptr);
                         }
 
-                        fprintf(cg->out, "  %%t%d = fadd double 0.0, 0.0\n", result_reg);
+                        ir_emit(cg->out, "  %%t%d = fadd double 0.0, 0.0\n", result_reg);
                         return result_reg;
                     }
 
                     // mcp prompt url name args_json - get a prompt template
                     if (strcmp(node->data.call.func, "prompt") == 0 && node->data.call.args.count >= 3) {
-                        ASTNode *name_node = node->data.call.args.nodes[1];
-                        ASTNode *args_node = node->data.call.args.nodes[2];
+                        ASTNode *name_node = ast_list_nodes(&node->data.call.args)[1];
+                        ASTNode *args_node = ast_list_nodes(&node->data.call.args)[2];
 
                         if (url_node->type == NODE_STR && name_node->type == NODE_STR && args_node->type == NODE_STR) {
                             int url_idx = cg->string_counter++;
@@ -1068,33 +1343,33 @@ static int codegen_expr(CodeGen *cg, ASTNode *node) {
                             size_t args_len = actual_string_len(args_node->data.str.value) + 1;
 
                             int url_ptr = next_temp(cg);
-                            fprintf(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
+                            ir_emit(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
                                     url_ptr, url_len, url_len, url_idx);
 
                             int name_ptr = next_temp(cg);
-                            fprintf(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
+                            ir_emit(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
                                     name_ptr, name_len, name_len, name_idx);
 
                             int args_ptr = next_temp(cg);
-                            fprintf(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
+                            ir_emit(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
                                     args_ptr, args_len, args_len, args_idx);
 
                             // Call mcp_prompt
                             int response_ptr = next_temp(cg);
-                            fprintf(cg->out, "  %%t%d = call i8* @nerd_mcp_prompt(i8* %%t%d, i8* %%t%d, i8* %%t%d)\n",
+                            ir_emit(cg->out, "  %%t%d = call i8* @nerd_mcp_prompt(i8* %%t%d, i8* %%t%d, i8* %%t%d)\n",
                                     response_ptr, url_ptr, name_ptr, args_ptr);
 
                             // Free response
-                            fprintf(cg->out, "  call void @nerd_mcp_free(i8* %%t%d)\n", response_ptr);
+                            ir_emit(cg->out, "  call void @nerd_mcp_free(i8* %%t%d)\n", response_ptr);
                         }
 
-                        fprintf(cg->out, "  %%t%d = fadd double 0.0, 0.0\n", result_reg);
+                        ir_emit(cg->out, "  %%t%d = fadd double 0.0, 0.0\n", result_reg);
                         return result_reg;
                     }
 
                     // mcp log url level - set logging level
                     if (strcmp(node->data.call.func, "log") == 0 && node->data.call.args.count >= 2) {
-                        ASTNode *level_node = node->data.call.args.nodes[1];
+                        ASTNode *level_node = ast_list_nodes(&node->data.call.args)[1];
 
                         if (url_node->type == NODE_STR && level_node->type == NODE_STR) {
                             int url_idx = cg->string_counter++;
@@ -1104,36 +1379,36 @@ static int codegen_expr(CodeGen *cg, ASTNode *node) {
                             size_t level_len = actual_string_len(level_node->data.str.value) + 1;
 
                             int url_ptr = next_temp(cg);
-                            fprintf(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
+                            ir_emit(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
                                     url_ptr, url_len, url_len, url_idx);
 
                             int level_ptr = next_temp(cg);
-                            fprintf(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
+                            ir_emit(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
                                     level_ptr, level_len, level_len, level_idx);
 
                             // Call mcp_log
                             int response_ptr = next_temp(cg);
-                            fprintf(cg->out, "  %%t%d = call i8* @nerd_mcp_log(i8* %%t%d, i8* %%t%d)\n",
+                            ir_emit(cg->out, "  %%t%d = call i8* @nerd_mcp_log(i8* %%t%d, i8* %%t%d)\n",
                                     response_ptr, url_ptr, level_ptr);
 
                             // Free response
-                            fprintf(cg->out, "  call void @nerd_mcp_free(i8* %%t%d)\n", response_ptr);
+                            ir_emit(cg->out, "  call void @nerd_mcp_free(i8* %%t%d)\n", response_ptr);
                         }
 
-                        fprintf(cg->out, "  %%t%d = fadd double 0.0, 0.0\n", result_reg);
+                        ir_emit(cg->out, "  %%t%d = fadd double 0.0, 0.0\n", result_reg);
                         return result_reg;
                     }
                 }
 
                 // Default for mcp module
-                fprintf(cg->out, "  %%t%d = fadd double 0.0, 0.0\n", result_reg);
+                ir_emit(cg->out, "  %%t%d = fadd double 0.0, 0.0\n", result_reg);
                 return result_reg;
             }
 
             // LLM module calls
             if (strcmp(node->data.call.module, "llm") == 0) {
                 if (node->data.call.args.count >= 1) {
-                    ASTNode *prompt_node = node->data.call.args.nodes[0];
+                    ASTNode *prompt_node = ast_list_nodes(&node->data.call.args)[0];
 
                     // llm claude "prompt" - Call Claude
                     if (strcmp(node->data.call.func, "claude") == 0) {
@@ -1142,119 +1417,91 @@ static int codegen_expr(CodeGen *cg, ASTNode *node) {
                             size_t prompt_len = actual_string_len(prompt_node->data.str.value) + 1;
 
                             int prompt_ptr = next_temp(cg);
-                            fprintf(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
+                            ir_emit(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
                                     prompt_ptr, prompt_len, prompt_len, prompt_idx);
 
                             // Call llm_claude
                             int response_ptr = next_temp(cg);
-                            fprintf(cg->out, "  %%t%d = call i8* @nerd_llm_claude(i8* %%t%d)\n", response_ptr, prompt_ptr);
+                            ir_emit(cg->out, "  %%t%d = call i8* @nerd_llm_claude(i8* %%t%d)\n", response_ptr, prompt_ptr);
 
                             // Free response
-                            fprintf(cg->out, "  call void @nerd_llm_free(i8* %%t%d)\n", response_ptr);
+                            ir_emit(cg->out, "  call void @nerd_llm_free(i8* %%t%d)\n", response_ptr);
                         }
 
-                        fprintf(cg->out, "  %%t%d = fadd double 0.0, 0.0\n", result_reg);
+                        ir_emit(cg->out, "  %%t%d = fadd double 0.0, 0.0\n", result_reg);
                         return result_reg;
                     }
                 }
 
-                fprintf(cg->out, "  %%t%d = fadd double 0.0, 0.0\n", result_reg);
+                ir_emit(cg->out, "  %%t%d = fadd double 0.0, 0.0\n", result_reg);
                 return result_reg;
             }
 
             // Default: return 0 for unimplemented calls
-            fprintf(cg->out, "  %%t%d = fadd double 0.0, 0.0\n", result_reg);
+            ir_emit(cg->out, "  %%t%d = fadd double 0.0, 0.0\n", result_reg);
             return result_reg;
         }
 
         case NODE_JSON_NEW: {
             // Create new empty JSON object
             int result_reg = next_temp(cg);
-            fprintf(cg->out, "  %%t%d = call i8* @nerd_json_new()\n", result_reg);
+            ir_emit(cg->out, "  %%t%d = call i8* @nerd_json_new()\n", result_reg);
             return result_reg;
         }
 
         case NODE_JSON_ACCESS: {
-            // obj."path" - get value from JSON
-            int obj_reg;
-            
-            // Check if object is a pointer local (JSON variable)
-            if (node->data.json_access.object->type == NODE_VAR) {
-                const char *var_name = node->data.json_access.object->data.var.name;
-                int ptr_local = find_ptr_local(cg, var_name);
-                if (ptr_local >= 0) {
-                    // Load pointer from pointer local
-                    obj_reg = next_temp(cg);
-                    fprintf(cg->out, "  %%t%d = load i8*, i8** %%plocal%d\n", obj_reg, ptr_local);
-                } else {
-                    // Fall back to normal expression evaluation
-                    obj_reg = codegen_expr(cg, node->data.json_access.object);
-                }
-            } else {
-                obj_reg = codegen_expr(cg, node->data.json_access.object);
+            // obj."path" - get value from JSON, with the getter for its type
+            if (node->vtype == TYPE_JSON) return codegen_object(cg, node);
+            if (node->vtype == TYPE_BOOL) {
+                int cond_reg = codegen_cond(cg, node);
+                if (cond_reg < 0) return -1;
+                int result_reg = next_temp(cg);
+                ir_emit(cg->out, "  %%t%d = uitofp i1 %%t%d to double\n", result_reg, cond_reg);
+                return result_reg;
             }
-            if (obj_reg < 0) return -1;
 
-            // Use pre-collected string index
-            int path_idx = cg->string_counter++;
-            size_t path_len = strlen(node->data.json_access.path) + 1;
-            int path_ptr = next_temp(cg);
-            fprintf(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
-                    path_ptr, path_len, path_len, path_idx);
+            int obj_reg = codegen_object(cg, node->data.json_access.object);
+            if (obj_reg < 0) return -1;
+            int path_ptr = codegen_path(cg, node->data.json_access.path);
 
-            // Call get_number by default (we'll need type inference later)
             int result_reg = next_temp(cg);
-            fprintf(cg->out, "  %%t%d = call double @nerd_json_get_number(i8* %%t%d, i8* %%t%d)\n",
+            ir_emit(cg->out, "  %%t%d = call double @nerd_json_get_number(i8* %%t%d, i8* %%t%d)\n",
                     result_reg, obj_reg, path_ptr);
             return result_reg;
         }
 
         case NODE_JSON_HAS: {
             // obj?"key" - check if key exists
-            int obj_reg = codegen_expr(cg, node->data.json_has.object);
-            if (obj_reg < 0) return -1;
-
-            int path_idx = cg->string_counter++;
-            size_t path_len = strlen(node->data.json_has.path) + 1;
-            int path_ptr = next_temp(cg);
-            fprintf(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
-                    path_ptr, path_len, path_len, path_idx);
-
-            int has_reg = next_temp(cg);
-            fprintf(cg->out, "  %%t%d = call i32 @nerd_json_has(i8* %%t%d, i8* %%t%d)\n",
-                    has_reg, obj_reg, path_ptr);
+            int cond_reg = codegen_cond(cg, node);
+            if (cond_reg < 0) return -1;
 
             // Convert to double for NERD's type system
             int result_reg = next_temp(cg);
-            fprintf(cg->out, "  %%t%d = sitofp i32 %%t%d to double\n", result_reg, has_reg);
+            ir_emit(cg->out, "  %%t%d = uitofp i1 %%t%d to double\n", result_reg, cond_reg);
             return result_reg;
         }
 
         case NODE_JSON_COUNT: {
             // obj."path".count - get array length
-            int obj_reg = codegen_expr(cg, node->data.json_count.object);
+            int obj_reg = codegen_object(cg, node->data.json_count.object);
             if (obj_reg < 0) return -1;
 
             int path_ptr;
             if (node->data.json_count.path) {
-                int path_idx = cg->string_counter++;
-                size_t path_len = strlen(node->data.json_count.path) + 1;
-                path_ptr = next_temp(cg);
-                fprintf(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
-                        path_ptr, path_len, path_len, path_idx);
+                path_ptr = codegen_path(cg, node->data.json_count.path);
             } else {
                 // NULL path for root level
                 path_ptr = next_temp(cg);
-                fprintf(cg->out, "  %%t%d = inttoptr i64 0 to i8*\n", path_ptr);
+                ir_emit(cg->out, "  %%t%d = inttoptr i64 0 to i8*\n", path_ptr);
             }
 
             int count_reg = next_temp(cg);
-            fprintf(cg->out, "  %%t%d = call i32 @nerd_json_count(i8* %%t%d, i8* %%t%d)\n",
+            ir_emit(cg->out, "  %%t%d = call i32 @nerd_json_count(i8* %%t%d, i8* %%t%d)\n",
                     count_reg, obj_reg, path_ptr);
 
             // Convert to double
             int result_reg = next_temp(cg);
-            fprintf(cg->out, "  %%t%d = sitofp i32 %%t%d to double\n", result_reg, count_reg);
+            ir_emit(cg->out, "  %%t%d = sitofp i32 %%t%d to double\n", result_reg, count_reg);
             return result_reg;
         }
 
@@ -1264,71 +1511,259 @@ static int codegen_expr(CodeGen *cg, ASTNode *node) {
     }
 }
 
+/*
+ * Generate code for a JSON object, returning an i8* register
+ */
+static int codegen_object(CodeGen *cg, ASTNode *node) {
+    if (node->type == NODE_VAR && node->data.var.bind == BIND_PTR_LOCAL) {
+        // Load pointer from pointer local
+        int reg = next_temp(cg);
+        ir_emit(cg->out, "  %%t%d = load i8*, i8** %%plocal%d\n", reg, node->data.var.slot);
+        return reg;
+    }
+
+    if (node->type == NODE_JSON_ACCESS) {
+        // Nested object: navigate to it
+        int obj_reg = codegen_object(cg, node->data.json_access.object);
+        if (obj_reg < 0) return -1;
+        int path_ptr = codegen_path(cg, node->data.json_access.path);
+
+        int reg = next_temp(cg);
+        ir_emit(cg->out, "  %%t%d = call i8* @nerd_json_get_object(i8* %%t%d, i8* %%t%d)\n",
+                reg, obj_reg, path_ptr);
+        return reg;
+    }
+
+    if (node->type == NODE_JSON_NEW) return codegen_expr(cg, node);
+
+    fprintf(stderr, "Error: Expected a JSON object\n");
+    return -1;
+}
+
+/*
+ * Generate code for an expression native_int accepts, returns an i64 register
+ */
+static int codegen_int(CodeGen *cg, ASTNode *node) {
+    if (!node) return -1;
+
+    switch (node->type) {
+        case NODE_NUM: {
+            int reg = next_temp(cg);
+            char literal[32];
+            snprintf(literal, sizeof(literal), "%lld", (long long)node->data.num.value);
+            ir_emit(cg->out, "  %%t%d = add i64 0, %s\n", reg, literal);
+            return reg;
+        }
+
+        case NODE_VAR:
+            return local_value(cg, node->data.var.slot);
+
+        default: {
+            // Mod by a nonzero constant, so srem is defined
+            int left_reg = codegen_int(cg, node->data.binop.left);
+            int right_reg = codegen_int(cg, node->data.binop.right);
+            if (left_reg < 0 || right_reg < 0) return -1;
+
+            int reg = next_temp(cg);
+            ir_emit(cg->out, "  %%t%d = srem i64 %%t%d, %%t%d\n", reg, left_reg, right_reg);
+            return reg;
+        }
+    }
+}
+
+/*
+ * Generate code for a condition, returning an i1 register
+ */
+static int codegen_cond(CodeGen *cg, ASTNode *node) {
+    if (!node) return -1;
+
+    switch (node->type) {
+        case NODE_BOOL: {
+            int reg = next_temp(cg);
+            ir_emit(cg->out, "  %%t%d = or i1 false, %s\n", reg, node->data.boolean.value ? "true" : "false");
+            return reg;
+        }
+
+        case NODE_BINOP: {
+            OpCode op = node->data.binop.op;
+            if (op == OP_AND || op == OP_OR) {
+                // Both sides are always evaluated
+                int left_reg = codegen_cond(cg, node->data.binop.left);
+                int right_reg = codegen_cond(cg, node->data.binop.right);
+                if (left_reg < 0 || right_reg < 0) return -1;
+
+                int reg = next_temp(cg);
+                ir_emit(cg->out, "  %%t%d = %s i1 %%t%d, %%t%d\n", reg,
+                        op == OP_AND ? "and" : "or", left_reg, right_reg);
+                return reg;
+            }
+            if (op >= OP_EQ && op <= OP_GTE) {
+                ASTNode *left = node->data.binop.left;
+                ASTNode *right = node->data.binop.right;
+                if (native_int(cg, left) && native_int(cg, right)) {
+                    int left_reg = codegen_int(cg, left);
+                    int right_reg = codegen_int(cg, right);
+                    if (left_reg < 0 || right_reg < 0) return -1;
+
+                    int reg = next_temp(cg);
+                    ir_emit(cg->out, "  %%t%d = icmp %s i64 %%t%d, %%t%d\n", reg,
+                            int_compare_predicate(op), left_reg, right_reg);
+                    return reg;
+                }
+
+                int left_reg = codegen_expr(cg, node->data.binop.left);
+                int right_reg = codegen_expr(cg, node->data.binop.right);
+                if (left_reg < 0 || right_reg < 0) return -1;
+
+                int reg = next_temp(cg);
+                ir_emit(cg->out, "  %%t%d = fcmp %s double %%t%d, %%t%d\n", reg,
+                        compare_predicate(op), left_reg, right_reg);
+                return reg;
+            }
+            break;
+        }
+
+        case NODE_UNARYOP:
+            if (node->data.unaryop.op == OP_NOT) {
+                ASTNode *operand = node->data.unaryop.operand;
+                int reg;
+                if (operand->vtype == TYPE_BOOL) {
+                    int operand_reg = codegen_cond(cg, operand);
+                    if (operand_reg < 0) return -1;
+                    reg = next_temp(cg);
+                    ir_emit(cg->out, "  %%t%d = xor i1 %%t%d, true\n", reg, operand_reg);
+                } else if (native_int(cg, operand)) {
+                    int operand_reg = codegen_int(cg, operand);
+                    if (operand_reg < 0) return -1;
+                    reg = next_temp(cg);
+                    ir_emit(cg->out, "  %%t%d = icmp eq i64 %%t%d, 0\n", reg, operand_reg);
+                } else {
+                    // Only zero is false (NaN is neither)
+                    int operand_reg = codegen_expr(cg, operand);
+                    if (operand_reg < 0) return -1;
+                    reg = next_temp(cg);
+                    ir_emit(cg->out, "  %%t%d = fcmp oeq double %%t%d, 0.0\n", reg, operand_reg);
+                }
+                return reg;
+            }
+            break;
+
+        case NODE_JSON_HAS:
+        case NODE_JSON_ACCESS: {
+            bool has = node->type == NODE_JSON_HAS;
+            if (!has && node->vtype != TYPE_BOOL) break;
+
+            // has/get_bool return an int: nonzero is true
+            ASTNode *object = has ? node->data.json_has.object : node->data.json_access.object;
+            int obj_reg = codegen_object(cg, object);
+            if (obj_reg < 0) return -1;
+            int path_ptr = codegen_path(cg, has ? node->data.json_has.path : node->data.json_access.path);
+
+            int int_reg = next_temp(cg);
+            ir_emit(cg->out, "  %%t%d = call i32 @nerd_json_%s(i8* %%t%d, i8* %%t%d)\n",
+                    int_reg, has ? "has" : "get_bool", obj_reg, path_ptr);
+            int reg = next_temp(cg);
+            ir_emit(cg->out, "  %%t%d = icmp ne i32 %%t%d, 0\n", reg, int_reg);
+            return reg;
+        }
+
+        default:
+            break;
+    }
+
+    // Any other value: nonzero is true
+    if (native_int(cg, node)) {
+        int value_reg = codegen_int(cg, node);
+        if (value_reg < 0) return -1;
+        int reg = next_temp(cg);
+        ir_emit(cg->out, "  %%t%d = icmp ne i64 %%t%d, 0\n", reg, value_reg);
+        return reg;
+    }
+    int value_reg = codegen_expr(cg, node);
+    if (value_reg < 0) return -1;
+    int reg = next_temp(cg);
+    ir_emit(cg->out, "  %%t%d = fcmp one double %%t%d, 0.0\n", reg, value_reg);
+    return reg;
+}
+
 /*
  * Generate code for statement
  */
 static void codegen_stmt(CodeGen *cg, ASTNode *node, int *result_reg) {
     if (!node) return;
+    ensure_block(cg);
 
     switch (node->type) {
         case NODE_RETURN: {
             int val_reg = codegen_expr(cg, node->data.ret.value);
             if (val_reg >= 0) {
-                fprintf(cg->out, "  ret double %%t%d\n", val_reg);
+                ir_emit(cg->out, "  ret double %%t%d\n", val_reg);
+                cg->terminated = true;
             }
             break;
         }
 
         case NODE_IF: {
-            int cond_reg = codegen_expr(cg, node->data.if_stmt.condition);
-            if (cond_reg < 0) return;
+            int bool_reg = codegen_cond(cg, node->data.if_stmt.condition);
+            if (bool_reg < 0) return;
 
-            int bool_reg = next_temp(cg);
             int then_label = next_label(cg);
             int else_label = next_label(cg);
             int end_label = next_label(cg);
 
-            fprintf(cg->out, "  %%t%d = fcmp one double %%t%d, 0.0\n", bool_reg, cond_reg);
+            // Locals either branch assigns may need a phi at the end
+            ASTNode *branches[2] = {node->data.if_stmt.then_stmt, node->data.if_stmt.else_stmt};
+            Merge merge;
+            if (!merge_init(cg, &merge, branches, 2, -1)) return;
+            int *before = malloc(sizeof(int) * (size_t)(merge.slot_count + 1));
+            if (!before) {
+                fprintf(stderr, "Error: Out of memory\n");
+                merge_free(&merge);
+                return;
+            }
+            for (int i = 0; i < merge.slot_count; i++) {
+                before[i] = cg->values[merge.slots[i]];
+            }
 
             if (node->data.if_stmt.else_stmt) {
                 // Has else branch
-                fprintf(cg->out, "  br i1 %%t%d, label %%then%d, label %%else%d\n", bool_reg, then_label, else_label);
+                ir_emit(cg->out, "  br i1 %%t%d, label %%then%d, label %%else%d\n", bool_reg, then_label, else_label);
+                cg->terminated = true;
 
                 // Then block
-                fprintf(cg->out, "then%d:\n", then_label);
+                begin_block(cg, "then", then_label);
                 codegen_stmt(cg, node->data.if_stmt.then_stmt, result_reg);
-                bool then_returns = (node->data.if_stmt.then_stmt->type == NODE_RETURN);
-                if (!then_returns) {
-                    fprintf(cg->out, "  br label %%end%d\n", end_label);
+                if (!cg->terminated) {
+                    merge_branch(cg, &merge, "end", end_label);
                 }
 
-                // Else block
-                fprintf(cg->out, "else%d:\n", else_label);
+                // Else block, starting from the values before the if
+                for (int i = 0; i < merge.slot_count; i++) {
+                    cg->values[merge.slots[i]] = before[i];
+                }
+                begin_block(cg, "else", else_label);
                 codegen_stmt(cg, node->data.if_stmt.else_stmt, result_reg);
-
-                // Check if else needs a branch to end
-                bool else_returns = (node->data.if_stmt.else_stmt->type == NODE_RETURN);
-
-                if (!else_returns) {
+                if (!cg->terminated) {
                     // Always branch to end after else block (including after nested if)
-                    fprintf(cg->out, "  br label %%end%d\n", end_label);
+                    merge_branch(cg, &merge, "end", end_label);
                 }
-
-                // Always emit end label for if-else (needed for merging control flow)
-                fprintf(cg->out, "end%d:\n", end_label);
             } else {
-                // No else branch
-                fprintf(cg->out, "  br i1 %%t%d, label %%then%d, label %%end%d\n", bool_reg, then_label, end_label);
+                // No else branch: skipping the then block is an edge to end
+                merge_edge(cg, &merge);
+                ir_emit(cg->out, "  br i1 %%t%d, label %%then%d, label %%end%d\n", bool_reg, then_label, end_label);
+                cg->terminated = true;
 
-                fprintf(cg->out, "then%d:\n", then_label);
+                begin_block(cg, "then", then_label);
                 codegen_stmt(cg, node->data.if_stmt.then_stmt, result_reg);
-
-                if (node->data.if_stmt.then_stmt->type != NODE_RETURN) {
-                    fprintf(cg->out, "  br label %%end%d\n", end_label);
+                if (!cg->terminated) {
+                    merge_branch(cg, &merge, "end", end_label);
                 }
-
-                fprintf(cg->out, "end%d:\n", end_label);
             }
+
+            // Always emit end label (needed for merging control flow)
+            merge_join(cg, &merge, "end", end_label);
+            free(before);
+            merge_free(&merge);
             break;
         }
 
@@ -1336,13 +1771,11 @@ static void codegen_stmt(CodeGen *cg, ASTNode *node, int *result_reg) {
             // Check if this is a JSON new (let x {})
             if (node->data.let.value->type == NODE_JSON_NEW) {
                 int json_reg = next_temp(cg);
-                fprintf(cg->out, "  %%t%d = call i8* @nerd_json_new()\n", json_reg);
+                ir_emit(cg->out, "  %%t%d = call i8* @nerd_json_new()\n", json_reg);
                 
                 // Store as pointer local
-                int ptr_local_id = (int)cg->ptr_local_count;
-                fprintf(cg->out, "  %%plocal%d = alloca i8*\n", ptr_local_id);
-                fprintf(cg->out, "  store i8* %%t%d, i8** %%plocal%d\n", json_reg, ptr_local_id);
-                add_ptr_local(cg, node->data.let.name, ptr_local_id);
+                int ptr_local_id = node->data.let.slot;
+                ir_emit(cg->out, "  store i8* %%t%d, i8** %%plocal%d\n", json_reg, ptr_local_id);
                 break;
             }
 
@@ -1352,7 +1785,7 @@ static void codegen_stmt(CodeGen *cg, ASTNode *node, int *result_reg) {
                 strcmp(val->data.call.module, "http") == 0 &&
                 val->data.call.args.count >= 1) {
                 
-                ASTNode *url_node = val->data.call.args.nodes[0];
+                ASTNode *url_node = ast_list_nodes(&val->data.call.args)[0];
                 
                 if (strcmp(val->data.call.func, "get") == 0 && url_node->type == NODE_STR) {
                     // let x http get "url" -> store JSON response
@@ -1366,18 +1799,16 @@ static void codegen_stmt(CodeGen *cg, ASTNode *node, int *result_reg) {
 
                     size_t url_len = actual_string_len(url_node->data.str.value) + 1;
                     int url_ptr = next_temp(cg);
-                    fprintf(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
+                    ir_emit(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
                             url_ptr, url_len, url_len, url_idx);
 
                     // Call http_get_json
                     int json_reg = next_temp(cg);
-                    fprintf(cg->out, "  %%t%d = call i8* @nerd_http_get_json(i8* %%t%d)\n", json_reg, url_ptr);
+                    ir_emit(cg->out, "  %%t%d = call i8* @nerd_http_get_json(i8* %%t%d)\n", json_reg, url_ptr);
 
                     // Store as pointer local
-                    int ptr_local_id = (int)cg->ptr_local_count;
-                    fprintf(cg->out, "  %%plocal%d = alloca i8*\n", ptr_local_id);
-                    fprintf(cg->out, "  store i8* %%t%d, i8** %%plocal%d\n", json_reg, ptr_local_id);
-                    add_ptr_local(cg, node->data.let.name, ptr_local_id);
+                    int ptr_local_id = node->data.let.slot;
+                    ir_emit(cg->out, "  store i8* %%t%d, i8** %%plocal%d\n", json_reg, ptr_local_id);
                     break;
                 }
 
@@ -1385,7 +1816,7 @@ static void codegen_stmt(CodeGen *cg, ASTNode *node, int *result_reg) {
                     val->data.call.args.count >= 2 &&
                     url_node->type == NODE_STR) {
                     // let x http post "url" body
-                    ASTNode *body_node = val->data.call.args.nodes[1];
+                    ASTNode *body_node = ast_list_nodes(&val->data.call.args)[1];
                     
                     int url_idx = cg->string_counter++;
                     if (cg->string_count >= cg->string_capacity) {
@@ -1397,7 +1828,7 @@ static void codegen_stmt(CodeGen *cg, ASTNode *node, int *result_reg) {
 
                     size_t url_len = actual_string_len(url_node->data.str.value) + 1;
                     int url_ptr = next_temp(cg);
-                    fprintf(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
+                    ir_emit(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
                             url_ptr, url_len, url_len, url_idx);
 
                     int json_reg;
@@ -1413,20 +1844,20 @@ static void codegen_stmt(CodeGen *cg, ASTNode *node, int *result_reg) {
 
                         size_t body_len = actual_string_len(body_node->data.str.value) + 1;
                         int body_ptr = next_temp(cg);
-                        fprintf(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
+                        ir_emit(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
                                 body_ptr, body_len, body_len, body_idx);
 
                         json_reg = next_temp(cg);
-                        fprintf(cg->out, "  %%t%d = call i8* @nerd_http_post_json(i8* %%t%d, i8* %%t%d)\n",
+                        ir_emit(cg->out, "  %%t%d = call i8* @nerd_http_post_json(i8* %%t%d, i8* %%t%d)\n",
                                 json_reg, url_ptr, body_ptr);
                     } else if (body_node->type == NODE_VAR) {
                         // Variable body (check if it's a JSON object)
-                        int ptr_local = find_ptr_local(cg, body_node->data.var.name);
-                        if (ptr_local >= 0) {
+                        if (body_node->data.var.bind == BIND_PTR_LOCAL) {
                             int body_ptr = next_temp(cg);
-                            fprintf(cg->out, "  %%t%d = load i8*, i8** %%plocal%d\n", body_ptr, ptr_local);
+                            ir_emit(cg->out, "  %%t%d = load i8*, i8** %%plocal%d\n",
+                                    body_ptr, body_node->data.var.slot);
                             json_reg = next_temp(cg);
-                            fprintf(cg->out, "  %%t%d = call i8* @nerd_http_post_json_body(i8* %%t%d, i8* %%t%d)\n",
+                            ir_emit(cg->out, "  %%t%d = call i8* @nerd_http_post_json_body(i8* %%t%d, i8* %%t%d)\n",
                                     json_reg, url_ptr, body_ptr);
                         } else {
                             fprintf(stderr, "Error: HTTP POST body must be a string or JSON object\n");
@@ -1438,10 +1869,8 @@ static void codegen_stmt(CodeGen *cg, ASTNode *node, int *result_reg) {
                     }
 
                     // Store as pointer local
-                    int ptr_local_id = (int)cg->ptr_local_count;
-                    fprintf(cg->out, "  %%plocal%d = alloca i8*\n", ptr_local_id);
-                    fprintf(cg->out, "  store i8* %%t%d, i8** %%plocal%d\n", json_reg, ptr_local_id);
-                    add_ptr_local(cg, node->data.let.name, ptr_local_id);
+                    int ptr_local_id = node->data.let.slot;
+                    ir_emit(cg->out, "  store i8* %%t%d, i8** %%plocal%d\n", json_reg, ptr_local_id);
                     break;
                 }
             }
@@ -1449,18 +1878,8 @@ static void codegen_stmt(CodeGen *cg, ASTNode *node, int *result_reg) {
             int val_reg = codegen_expr(cg, node->data.let.value);
             if (val_reg < 0) return;
 
-            // Check if variable already exists (reassignment)
-            int existing = find_local(cg, node->data.let.name);
-            if (existing >= 0) {
-                // Update existing variable
-                fprintf(cg->out, "  store double %%t%d, double* %%local%d\n", val_reg, existing);
-            } else {
-                // Create new variable
-                int local_id = (int)cg->local_count;
-                fprintf(cg->out, "  %%local%d = alloca double\n", local_id);
-                fprintf(cg->out, "  store double %%t%d, double* %%local%d\n", val_reg, local_id);
-                add_local(cg, node->data.let.name, local_id);
-            }
+            // The value becomes the local's; a later let of the name replaces it
+            set_local(cg, node->data.let.slot, val_reg);
             break;
         }
 
@@ -1472,54 +1891,75 @@ static void codegen_stmt(CodeGen *cg, ASTNode *node, int *result_reg) {
         case NODE_REPEAT: {
             // repeat n times [as i] ... done
             // Generates: for (i = 1; i <= n; i++) { body }
-
-            int count_reg = codegen_expr(cg, node->data.repeat.count);
+            // The counter is an i64 unless something else stores to it
+
+            int counter_id = node->data.repeat.slot;
+            bool is_int = int_slot(cg, counter_id);
+            ASTNode *count = node->data.repeat.count;
+            int count_reg;
+            if (is_int && native_int(cg, count)) {
+                count_reg = codegen_int(cg, count);
+            } else if (is_int) {
+                // Counting to a fraction stops at its integer part; NaN
+                // saturates to 0, so the loop runs zero times as before
+                int value_reg = codegen_expr(cg, count);
+                if (value_reg < 0) return;
+                count_reg = next_temp(cg);
+                ir_emit(cg->out, "  %%t%d = call i64 @llvm.fptosi.sat.i64.f64(double %%t%d)\n",
+                        count_reg, value_reg);
+            } else {
+                count_reg = codegen_expr(cg, count);
+            }
             if (count_reg < 0) return;
 
             int loop_start = next_label(cg);
             int loop_body = next_label(cg);
             int loop_end = next_label(cg);
 
-            // Allocate counter variable (starts at 1)
-            int counter_id = (int)cg->local_count;
-            fprintf(cg->out, "  %%local%d = alloca double\n", counter_id);
-            fprintf(cg->out, "  store double 1.0, double* %%local%d\n", counter_id);
-
-            // If there's an 'as' variable, set up the binding
-            if (node->data.repeat.var_name) {
-                add_local(cg, node->data.repeat.var_name, counter_id);
+            // Counter starts at 1; an 'as' name refers to it
+            int init_reg = next_temp(cg);
+            if (is_int) {
+                ir_emit(cg->out, "  %%t%d = add i64 0, 1\n", init_reg);
             } else {
-                // Need to track the counter even without a name
-                cg->local_count++;
+                ir_emit(cg->out, "  %%t%d = fadd double 0.0, 1.0\n", init_reg);
             }
+            set_local(cg, counter_id, init_reg);
 
-            // Loop condition check
-            fprintf(cg->out, "  br label %%loop_start%d\n", loop_start);
-            fprintf(cg->out, "loop_start%d:\n", loop_start);
-
-            int counter_val = next_temp(cg);
-            fprintf(cg->out, "  %%t%d = load double, double* %%local%d\n", counter_val, counter_id);
+            Loop loop;
+            if (!loop_begin(cg, &loop, &node->data.repeat.body, counter_id, "loop_start", loop_start)) return;
 
+            // Loop condition check
+            int counter_val = local_value(cg, counter_id);
             int cmp_reg = next_temp(cg);
-            fprintf(cg->out, "  %%t%d = fcmp ole double %%t%d, %%t%d\n", cmp_reg, counter_val, count_reg);
-            fprintf(cg->out, "  br i1 %%t%d, label %%loop_body%d, label %%loop_end%d\n", cmp_reg, loop_body, loop_end);
+            if (is_int) {
+                ir_emit(cg->out, "  %%t%d = icmp sle i64 %%t%d, %%t%d\n", cmp_reg, counter_val, count_reg);
+            } else {
+                ir_emit(cg->out, "  %%t%d = fcmp ole double %%t%d, %%t%d\n", cmp_reg, counter_val, count_reg);
+            }
+            ir_emit(cg->out, "  br i1 %%t%d, label %%loop_body%d, label %%loop_end%d\n", cmp_reg, loop_body, loop_end);
+            cg->terminated = true;
 
             // Loop body
-            fprintf(cg->out, "loop_body%d:\n", loop_body);
+            begin_block(cg, "loop_body", loop_body);
             for (size_t i = 0; i < node->data.repeat.body.count; i++) {
-                codegen_stmt(cg, node->data.repeat.body.nodes[i], result_reg);
+                codegen_stmt(cg, ast_list_nodes(&node->data.repeat.body)[i], result_reg);
             }
 
             // Increment counter
-            int inc_load = next_temp(cg);
-            int inc_add = next_temp(cg);
-            fprintf(cg->out, "  %%t%d = load double, double* %%local%d\n", inc_load, counter_id);
-            fprintf(cg->out, "  %%t%d = fadd double %%t%d, 1.0\n", inc_add, inc_load);
-            fprintf(cg->out, "  store double %%t%d, double* %%local%d\n", inc_add, counter_id);
-            fprintf(cg->out, "  br label %%loop_start%d\n", loop_start);
+            if (!cg->terminated) {
+                int counter_reg = local_value(cg, counter_id);
+                int inc_add = next_temp(cg);
+                if (is_int) {
+                    ir_emit(cg->out, "  %%t%d = add i64 %%t%d, 1\n", inc_add, counter_reg);
+                } else {
+                    ir_emit(cg->out, "  %%t%d = fadd double %%t%d, 1.0\n", inc_add, counter_reg);
+                }
+                set_local(cg, counter_id, inc_add);
+                merge_branch(cg, &loop.merge, "loop_start", loop_start);
+            }
 
             // Loop end
-            fprintf(cg->out, "loop_end%d:\n", loop_end);
+            loop_end_at(cg, &loop, "loop_end", loop_end);
             break;
         }
 
@@ -1530,76 +1970,78 @@ static void codegen_stmt(CodeGen *cg, ASTNode *node, int *result_reg) {
             int loop_body = next_label(cg);
             int loop_end = next_label(cg);
 
-            // Loop condition check
-            fprintf(cg->out, "  br label %%while_start%d\n", loop_start);
-            fprintf(cg->out, "while_start%d:\n", loop_start);
+            Loop loop;
+            if (!loop_begin(cg, &loop, &node->data.while_loop.body, -1, "while_start", loop_start)) return;
 
-            int cond_reg = codegen_expr(cg, node->data.while_loop.condition);
-            if (cond_reg < 0) return;
+            // Loop condition check
+            int bool_reg = codegen_cond(cg, node->data.while_loop.condition);
+            if (bool_reg < 0) {
+                loop_end_at(cg, &loop, NULL, loop_end);
+                return;
+            }
 
-            int bool_reg = next_temp(cg);
-            fprintf(cg->out, "  %%t%d = fcmp one double %%t%d, 0.0\n", bool_reg, cond_reg);
-            fprintf(cg->out, "  br i1 %%t%d, label %%while_body%d, label %%while_end%d\n", bool_reg, loop_body, loop_end);
+            ir_emit(cg->out, "  br i1 %%t%d, label %%while_body%d, label %%while_end%d\n", bool_reg, loop_body, loop_end);
+            cg->terminated = true;
 
             // Loop body
-            fprintf(cg->out, "while_body%d:\n", loop_body);
+            begin_block(cg, "while_body", loop_body);
             for (size_t i = 0; i < node->data.while_loop.body.count; i++) {
-                codegen_stmt(cg, node->data.while_loop.body.nodes[i], result_reg);
+                codegen_stmt(cg, ast_list_nodes(&node->data.while_loop.body)[i], result_reg);
+            }
+            if (!cg->terminated) {
+                merge_branch(cg, &loop.merge, "while_start", loop_start);
             }
-            fprintf(cg->out, "  br label %%while_start%d\n", loop_start);
 
             // Loop end
-            fprintf(cg->out, "while_end%d:\n", loop_end);
+            loop_end_at(cg, &loop, "while_end", loop_end);
             break;
         }
 
         case NODE_INC: {
             // inc var [amount] - increment variable
-            int existing = find_local(cg, node->data.inc.var_name);
+            int existing = node->data.inc.slot;
             if (existing < 0) {
-                fprintf(stderr, "Error: Unknown variable '%s' in inc\n", node->data.inc.var_name);
+                fprintf(stderr, "Error: Unknown variable '%s' in inc\n", symbol_name(node->data.inc.var_name));
                 return;
             }
 
-            int load_reg = next_temp(cg);
-            fprintf(cg->out, "  %%t%d = load double, double* %%local%d\n", load_reg, existing);
+            int load_reg = local_value(cg, existing);
 
             int amount_reg;
             if (node->data.inc.amount) {
                 amount_reg = codegen_expr(cg, node->data.inc.amount);
             } else {
                 amount_reg = next_temp(cg);
-                fprintf(cg->out, "  %%t%d = fadd double 0.0, 1.0\n", amount_reg);
+                ir_emit(cg->out, "  %%t%d = fadd double 0.0, 1.0\n", amount_reg);
             }
 
             int result_reg = next_temp(cg);
-            fprintf(cg->out, "  %%t%d = fadd double %%t%d, %%t%d\n", result_reg, load_reg, amount_reg);
-            fprintf(cg->out, "  store double %%t%d, double* %%local%d\n", result_reg, existing);
+            ir_emit(cg->out, "  %%t%d = fadd double %%t%d, %%t%d\n", result_reg, load_reg, amount_reg);
+            set_local(cg, existing, result_reg);
             break;
         }
 
         case NODE_DEC: {
             // dec var [amount] - decrement variable
-            int existing = find_local(cg, node->data.dec.var_name);
+            int existing = node->data.dec.slot;
             if (existing < 0) {
-                fprintf(stderr, "Error: Unknown variable '%s' in dec\n", node->data.dec.var_name);
+                fprintf(stderr, "Error: Unknown variable '%s' in dec\n", symbol_name(node->data.dec.var_name));
                 return;
             }
 
-            int load_reg = next_temp(cg);
-            fprintf(cg->out, "  %%t%d = load double, double* %%local%d\n", load_reg, existing);
+            int load_reg = local_value(cg, existing);
 
             int amount_reg;
             if (node->data.dec.amount) {
                 amount_reg = codegen_expr(cg, node->data.dec.amount);
             } else {
                 amount_reg = next_temp(cg);
-                fprintf(cg->out, "  %%t%d = fadd double 0.0, 1.0\n", amount_reg);
+                ir_emit(cg->out, "  %%t%d = fadd double 0.0, 1.0\n", amount_reg);
             }
 
             int result_reg = next_temp(cg);
-            fprintf(cg->out, "  %%t%d = fsub double %%t%d, %%t%d\n", result_reg, load_reg, amount_reg);
-            fprintf(cg->out, "  store double %%t%d, double* %%local%d\n", result_reg, existing);
+            ir_emit(cg->out, "  %%t%d = fsub double %%t%d, %%t%d\n", result_reg, load_reg, amount_reg);
+            set_local(cg, existing, result_reg);
             break;
         }
 
@@ -1608,14 +2050,13 @@ static void codegen_stmt(CodeGen *cg, ASTNode *node, int *result_reg) {
             
             // Get the JSON object pointer
             int obj_reg;
-            if (node->data.json_set.object->type == NODE_VAR) {
-                const char *var_name = node->data.json_set.object->data.var.name;
-                int ptr_local = find_ptr_local(cg, var_name);
-                if (ptr_local >= 0) {
+            ASTNode *object = node->data.json_set.object;
+            if (object->type == NODE_VAR) {
+                if (object->data.var.bind == BIND_PTR_LOCAL) {
                     obj_reg = next_temp(cg);
-                    fprintf(cg->out, "  %%t%d = load i8*, i8** %%plocal%d\n", obj_reg, ptr_local);
+                    ir_emit(cg->out, "  %%t%d = load i8*, i8** %%plocal%d\n", obj_reg, object->data.var.slot);
                 } else {
-                    fprintf(stderr, "Error: '%s' is not a JSON object\n", var_name);
+                    fprintf(stderr, "Error: '%s' is not a JSON object\n", symbol_name(object->data.var.name));
                     return;
                 }
             } else {
@@ -1624,11 +2065,7 @@ static void codegen_stmt(CodeGen *cg, ASTNode *node, int *result_reg) {
             }
 
             // Get key string (pre-collected)
-            int key_idx = cg->string_counter++;
-            size_t key_len = strlen(node->data.json_set.key) + 1;
-            int key_ptr = next_temp(cg);
-            fprintf(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
-                    key_ptr, key_len, key_len, key_idx);
+            int key_ptr = codegen_path(cg, node->data.json_set.key);
 
             // Get value
             ASTNode *val = node->data.json_set.value;
@@ -1637,21 +2074,30 @@ static void codegen_stmt(CodeGen *cg, ASTNode *node, int *result_reg) {
                 int val_idx = cg->string_counter++;
                 size_t val_len = actual_string_len(val->data.str.value) + 1;
                 int val_ptr = next_temp(cg);
-                fprintf(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
+                ir_emit(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
                         val_ptr, val_len, val_len, val_idx);
 
-                fprintf(cg->out, "  call void @nerd_json_set_string(i8* %%t%d, i8* %%t%d, i8* %%t%d)\n",
+                ir_emit(cg->out, "  call void @nerd_json_set_string(i8* %%t%d, i8* %%t%d, i8* %%t%d)\n",
                         obj_reg, key_ptr, val_ptr);
             } else if (val->type == NODE_BOOL) {
                 // Boolean value
                 int bool_val = val->data.boolean.value ? 1 : 0;
-                fprintf(cg->out, "  call void @nerd_json_set_bool(i8* %%t%d, i8* %%t%d, i32 %d)\n",
+                ir_emit(cg->out, "  call void @nerd_json_set_bool(i8* %%t%d, i8* %%t%d, i32 %d)\n",
                         obj_reg, key_ptr, bool_val);
+            } else if (val->vtype == TYPE_BOOL) {
+                // Comparison, has, ...: store a JSON bool
+                int cond_reg = codegen_cond(cg, val);
+                if (cond_reg >= 0) {
+                    int int_reg = next_temp(cg);
+                    ir_emit(cg->out, "  %%t%d = zext i1 %%t%d to i32\n", int_reg, cond_reg);
+                    ir_emit(cg->out, "  call void @nerd_json_set_bool(i8* %%t%d, i8* %%t%d, i32 %%t%d)\n",
+                            obj_reg, key_ptr, int_reg);
+                }
             } else {
                 // Numeric value
                 int val_reg = codegen_expr(cg, val);
                 if (val_reg >= 0) {
-                    fprintf(cg->out, "  call void @nerd_json_set_number(i8* %%t%d, i8* %%t%d, double %%t%d)\n",
+                    ir_emit(cg->out, "  call void @nerd_json_set_number(i8* %%t%d, i8* %%t%d, double %%t%d)\n",
                             obj_reg, key_ptr, val_reg);
                 }
             }
@@ -1668,15 +2114,15 @@ static void codegen_stmt(CodeGen *cg, ASTNode *node, int *result_reg) {
 
                 // Get string pointer and call printf
                 int ptr_reg = next_temp(cg);
-                fprintf(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
+                ir_emit(cg->out, "  %%t%d = getelementptr [%zu x i8], [%zu x i8]* @.str%d, i32 0, i32 0\n",
                         ptr_reg, len + 1, len + 1, str_id);
-                fprintf(cg->out, "  call i32 (i8*, ...) @printf(i8* getelementptr ([4 x i8], [4 x i8]* @.fmt_str, i32 0, i32 0), i8* %%t%d)\n",
+                ir_emit(cg->out, "  call i32 (i8*, ...) @printf(i8* getelementptr ([4 x i8], [4 x i8]* @.fmt_str, i32 0, i32 0), i8* %%t%d)\n",
                         ptr_reg);
             } else {
                 // Output number
                 int val_reg = codegen_expr(cg, val);
                 if (val_reg >= 0) {
-                    fprintf(cg->out, "  call i32 (i8*, ...) @printf(i8* getelementptr ([4 x i8], [4 x i8]* @.fmt_num, i32 0, i32 0), double %%t%d)\n",
+                    ir_emit(cg->out, "  call i32 (i8*, ...) @printf(i8* getelementptr ([4 x i8], [4 x i8]* @.fmt_num, i32 0, i32 0), double %%t%d)\n",
                             val_reg);
                 }
             }
@@ -1689,207 +2135,333 @@ static void codegen_stmt(CodeGen *cg, ASTNode *node, int *result_reg) {
     }
 }
 
+/*
+ * Mark the repeat counters that nothing else stores to: they count from
+ * 1 to at most the saturated count, so they fit in an i64. Statements
+ * are walked in emission order, and a counter's repeat is its first store.
+ */
+static void note_int_locals(CodeGen *cg, ASTNode *node) {
+    if (!node) return;
+
+    int slot = -1;
+    const ASTList *body = NULL;
+    switch (node->type) {
+        case NODE_LET:
+            if (node->data.let.bind == BIND_LOCAL) slot = node->data.let.slot;
+            break;
+        case NODE_INC:
+            slot = node->data.inc.slot;
+            break;
+        case NODE_DEC:
+            slot = node->data.dec.slot;
+            break;
+        case NODE_IF:
+            note_int_locals(cg, node->data.if_stmt.then_stmt);
+            note_int_locals(cg, node->data.if_stmt.else_stmt);
+            break;
+        case NODE_REPEAT:
+            slot = node->data.repeat.slot;
+            body = &node->data.repeat.body;
+            break;
+        case NODE_WHILE:
+            body = &node->data.while_loop.body;
+            break;
+        default:
+            break;
+    }
+
+    if (slot >= 0 && slot < cg->local_count) {
+        cg->int_slot[slot] = node->type == NODE_REPEAT && node->vtype == TYPE_INT;
+    }
+    for (size_t i = 0; body && i < body->count; i++) {
+        note_int_locals(cg, ast_list_nodes(body)[i]);
+    }
+}
+
 /*
  * Generate code for function
  */
 static void codegen_func(CodeGen *cg, ASTNode *func) {
-    clear_locals(cg);
     cg->current_func = func;
+    cg->temp_counter = 0;
 
-    // Set up parameter names
-    cg->param_count = func->data.func_def.params.count;
-    cg->param_names = malloc(sizeof(char*) * cg->param_count);
-    for (size_t i = 0; i < cg->param_count; i++) {
-        cg->param_names[i] = func->data.func_def.params.nodes[i]->data.param.name;
-    }
+    // Labels are local to a function, so numbering restarts with each one
+    // and a function's IR does not depend on the functions before it
+    cg->label_counter = 0;
 
     // Function signature
-    fprintf(cg->out, "define double @%s(", func->data.func_def.name);
-    for (size_t i = 0; i < cg->param_count; i++) {
-        if (i > 0) fprintf(cg->out, ", ");
-        fprintf(cg->out, "double %%arg%zu", i);
+    ir_emit(cg->out, "define double @%s(", symbol_name(func->data.func_def.name));
+    for (size_t i = 0; i < func->data.func_def.params.count; i++) {
+        if (i > 0) ir_emit(cg->out, ", ");
+        ir_emit(cg->out, "double %%arg%zu", i);
+    }
+    ir_emit(cg->out, ") {\n");
+
+    // No local has a value until its first let
+    int local_count = func->data.func_def.local_count;
+    if (local_count > cg->value_capacity) {
+        int *values = realloc(cg->values, sizeof(int) * (size_t)local_count);
+        if (values) cg->values = values;
+        bool *ints = realloc(cg->int_slot, sizeof(bool) * (size_t)local_count);
+        if (ints) cg->int_slot = ints;
+        int *marks = realloc(cg->slot_mark, sizeof(int) * (size_t)local_count);
+        if (marks) cg->slot_mark = marks;
+        if (!values || !ints || !marks) {
+            fprintf(stderr, "Error: Out of memory\n");
+            cg->out->failed = true;
+            return;
+        }
+        cg->value_capacity = local_count;
+    }
+    cg->local_count = local_count;
+    for (int i = 0; i < local_count; i++) {
+        cg->values[i] = -1;
+        cg->int_slot[i] = false;
+        cg->slot_mark[i] = 0;
+    }
+    cg->mark_stamp = 0;
+    for (size_t i = 0; i < func->data.func_def.body.count; i++) {
+        note_int_locals(cg, ast_list_nodes(&func->data.func_def.body)[i]);
+    }
+    begin_block(cg, "entry", -1);
+
+    // Every JSON let's pointer local lives in the entry block, so a let
+    // inside a loop only stores and the stack stays the same size
+    for (int i = 0; i < func->data.func_def.ptr_count; i++) {
+        ir_emit(cg->out, "  %%plocal%d = alloca i8*\n", i);
     }
-    fprintf(cg->out, ") {\n");
-    fprintf(cg->out, "entry:\n");
 
     // Generate body
     int result_reg = -1;
-    bool has_return = false;
     for (size_t i = 0; i < func->data.func_def.body.count; i++) {
-        ASTNode *stmt = func->data.func_def.body.nodes[i];
-        codegen_stmt(cg, stmt, &result_reg);
-        if (stmt->type == NODE_RETURN) {
-            has_return = true;
-        }
+        codegen_stmt(cg, ast_list_nodes(&func->data.func_def.body)[i], &result_reg);
     }
 
-    // Default return if no explicit return (required for valid LLVM IR)
-    if (!has_return) {
-        fprintf(cg->out, "  ret double 0.0\n");
+    // Default return if the last block falls off the end (required for valid LLVM IR)
+    if (!cg->terminated) {
+        ir_emit(cg->out, "  ret double 0.0\n");
     }
-    fprintf(cg->out, "}\n\n");
-
-    free(cg->param_names);
-    cg->param_names = NULL;
-    cg->param_count = 0;
+    ir_emit(cg->out, "}\n\n");
 }
 
 /*
- * Generate LLVM IR for program
+ * Emit the module header: runtime declarations and format strings
  */
-bool codegen_llvm(NerdContext *ctx, const char *output_path) {
-    FILE *out = fopen(output_path, "w");
-    if (!out) {
-        ctx->error_msg = nerd_strdup("Failed to open output file");
-        return false;
-    }
-
-    CodeGen *cg = codegen_create(out);
-    if (!cg) {
-        fclose(out);
-        ctx->error_msg = nerd_strdup("Failed to create code generator");
-        return false;
-    }
-
+void codegen_prelude(IRBuffer *out) {
     // Header
-    fprintf(out, "; NERD Compiled Program\n");
-    fprintf(out, "; Generated by NERD Bootstrap Compiler\n\n");
+    ir_emit(out, "; NERD Compiled Program\n");
+    ir_emit(out, "; Generated by NERD Bootstrap Compiler\n\n");
 
     // Declare LLVM intrinsics
-    fprintf(out, "declare double @llvm.fabs.f64(double)\n");
-    fprintf(out, "declare double @llvm.sqrt.f64(double)\n");
-    fprintf(out, "declare double @llvm.floor.f64(double)\n");
-    fprintf(out, "declare double @llvm.ceil.f64(double)\n");
-    fprintf(out, "declare double @llvm.sin.f64(double)\n");
-    fprintf(out, "declare double @llvm.cos.f64(double)\n");
-    fprintf(out, "declare double @llvm.pow.f64(double, double)\n");
-    fprintf(out, "declare double @llvm.minnum.f64(double, double)\n");
-    fprintf(out, "declare double @llvm.maxnum.f64(double, double)\n");
-    fprintf(out, "\n");
+    ir_emit(out, "declare double @llvm.fabs.f64(double)\n");
+    ir_emit(out, "declare double @llvm.sqrt.f64(double)\n");
+    ir_emit(out, "declare double @llvm.floor.f64(double)\n");
+    ir_emit(out, "declare double @llvm.ceil.f64(double)\n");
+    ir_emit(out, "declare double @llvm.sin.f64(double)\n");
+    ir_emit(out, "declare double @llvm.cos.f64(double)\n");
+    ir_emit(out, "declare double @llvm.pow.f64(double, double)\n");
+    ir_emit(out, "declare double @llvm.minnum.f64(double, double)\n");
+    ir_emit(out, "declare double @llvm.maxnum.f64(double, double)\n");
+    ir_emit(out, "declare i64 @llvm.fptosi.sat.i64.f64(double)\n");
+    ir_emit(out, "\n");
 
     // Declare printf for output
-    fprintf(out, "declare i32 @printf(i8*, ...)\n");
-    fprintf(out, "\n");
+    ir_emit(out, "declare i32 @printf(i8*, ...)\n");
+    ir_emit(out, "\n");
 
     // HTTP runtime declarations (legacy)
-    fprintf(out, "declare i8* @nerd_http_get(i8*)\n");
-    fprintf(out, "declare i8* @nerd_http_post(i8*, i8*)\n");
-    fprintf(out, "declare void @nerd_http_free(i8*)\n");
-    fprintf(out, "declare i8* @nerd_http_get_json(i8*)\n");
-    fprintf(out, "declare i8* @nerd_http_post_json(i8*, i8*)\n");
-    fprintf(out, "declare i8* @nerd_http_post_json_body(i8*, i8*)\n");
+    ir_emit(out, "declare i8* @nerd_http_get(i8*)\n");
+    ir_emit(out, "declare i8* @nerd_http_post(i8*, i8*)\n");
+    ir_emit(out, "declare void @nerd_http_free(i8*)\n");
+    ir_emit(out, "declare i8* @nerd_http_get_json(i8*)\n");
+    ir_emit(out, "declare i8* @nerd_http_post_json(i8*, i8*)\n");
+    ir_emit(out, "declare i8* @nerd_http_post_json_body(i8*, i8*)\n");
     // HTTP runtime declarations (full)
-    fprintf(out, "declare i8* @nerd_http_request(i8*, i8*, i8*, i8*)\n");
-    fprintf(out, "declare i8* @nerd_http_get_full(i8*, i8*)\n");
-    fprintf(out, "declare i8* @nerd_http_post_full(i8*, i8*, i8*)\n");
-    fprintf(out, "declare i8* @nerd_http_put(i8*, i8*, i8*)\n");
-    fprintf(out, "declare i8* @nerd_http_delete(i8*, i8*)\n");
-    fprintf(out, "declare i8* @nerd_http_patch(i8*, i8*, i8*)\n");
-    fprintf(out, "declare i8* @nerd_http_auth_bearer(i8*)\n");
-    fprintf(out, "declare i8* @nerd_http_auth_basic(i8*, i8*)\n");
-    fprintf(out, "\n");
+    ir_emit(out, "declare i8* @nerd_http_request(i8*, i8*, i8*, i8*)\n");
+    ir_emit(out, "declare i8* @nerd_http_get_full(i8*, i8*)\n");
+    ir_emit(out, "declare i8* @nerd_http_post_full(i8*, i8*, i8*)\n");
+    ir_emit(out, "declare i8* @nerd_http_put(i8*, i8*, i8*)\n");
+    ir_emit(out, "declare i8* @nerd_http_delete(i8*, i8*)\n");
+    ir_emit(out, "declare i8* @nerd_http_patch(i8*, i8*, i8*)\n");
+    ir_emit(out, "declare i8* @nerd_http_auth_bearer(i8*)\n");
+    ir_emit(out, "declare i8* @nerd_http_auth_basic(i8*, i8*)\n");
+    ir_emit(out, "\n");
 
     // MCP runtime declarations
-    fprintf(out, "declare i8* @nerd_mcp_list(i8*)\n");
-    fprintf(out, "declare i8* @nerd_mcp_send(i8*, i8*, i8*)\n");
-    fprintf(out, "declare i8* @nerd_mcp_use(i8*, i8*, i8*)\n");
-    fprintf(out, "declare i8* @nerd_mcp_init(i8*)\n");
-    fprintf(out, "declare i8* @nerd_mcp_resources(i8*)\n");
-    fprintf(out, "declare i8* @nerd_mcp_read(i8*, i8*)\n");
-    fprintf(out, "declare i8* @nerd_mcp_prompts(i8*)\n");
-    fprintf(out, "declare i8* @nerd_mcp_prompt(i8*, i8*, i8*)\n");
-    fprintf(out, "declare i8* @nerd_mcp_log(i8*, i8*)\n");
-    fprintf(out, "declare void @nerd_mcp_free(i8*)\n");
-    fprintf(out, "\n");
+    ir_emit(out, "declare i8* @nerd_mcp_list(i8*)\n");
+    ir_emit(out, "declare i8* @nerd_mcp_send(i8*, i8*, i8*)\n");
+    ir_emit(out, "declare i8* @nerd_mcp_use(i8*, i8*, i8*)\n");
+    ir_emit(out, "declare i8* @nerd_mcp_init(i8*)\n");
+    ir_emit(out, "declare i8* @nerd_mcp_resources(i8*)\n");
+    ir_emit(out, "declare i8* @nerd_mcp_read(i8*, i8*)\n");
+    ir_emit(out, "declare i8* @nerd_mcp_prompts(i8*)\n");
+    ir_emit(out, "declare i8* @nerd_mcp_prompt(i8*, i8*, i8*)\n");
+    ir_emit(out, "declare i8* @nerd_mcp_log(i8*, i8*)\n");
+    ir_emit(out, "declare void @nerd_mcp_free(i8*)\n");
+    ir_emit(out, "\n");
 
     // LLM runtime declarations
-    fprintf(out, "declare i8* @nerd_llm_claude(i8*)\n");
-    fprintf(out, "declare void @nerd_llm_free(i8*)\n");
-    fprintf(out, "\n");
+    ir_emit(out, "declare i8* @nerd_llm_claude(i8*)\n");
+    ir_emit(out, "declare void @nerd_llm_free(i8*)\n");
+    ir_emit(out, "\n");
 
     // JSON runtime declarations
-    fprintf(out, "declare i8* @nerd_json_new()\n");
-    fprintf(out, "declare i8* @nerd_json_parse(i8*)\n");
-    fprintf(out, "declare i8* @nerd_json_get_string(i8*, i8*)\n");
-    fprintf(out, "declare double @nerd_json_get_number(i8*, i8*)\n");
-    fprintf(out, "declare i32 @nerd_json_get_bool(i8*, i8*)\n");
-    fprintf(out, "declare i8* @nerd_json_get_object(i8*, i8*)\n");
-    fprintf(out, "declare i32 @nerd_json_count(i8*, i8*)\n");
-    fprintf(out, "declare i32 @nerd_json_has(i8*, i8*)\n");
-    fprintf(out, "declare void @nerd_json_set_string(i8*, i8*, i8*)\n");
-    fprintf(out, "declare void @nerd_json_set_number(i8*, i8*, double)\n");
-    fprintf(out, "declare void @nerd_json_set_bool(i8*, i8*, i32)\n");
-    fprintf(out, "declare i8* @nerd_json_stringify(i8*)\n");
-    fprintf(out, "declare void @nerd_json_free(i8*)\n");
-    fprintf(out, "declare void @nerd_json_free_string(i8*)\n");
-    fprintf(out, "\n");
+    ir_emit(out, "declare i8* @nerd_json_new()\n");
+    ir_emit(out, "declare i8* @nerd_json_parse(i8*)\n");
+    ir_emit(out, "declare i8* @nerd_json_get_string(i8*, i8*)\n");
+    ir_emit(out, "declare double @nerd_json_get_number(i8*, i8*)\n");
+    ir_emit(out, "declare i32 @nerd_json_get_bool(i8*, i8*)\n");
+    ir_emit(out, "declare i8* @nerd_json_get_object(i8*, i8*)\n");
+    ir_emit(out, "declare i32 @nerd_json_count(i8*, i8*)\n");
+    ir_emit(out, "declare i32 @nerd_json_has(i8*, i8*)\n");
+    ir_emit(out, "declare void @nerd_json_set_string(i8*, i8*, i8*)\n");
+    ir_emit(out, "declare void @nerd_json_set_number(i8*, i8*, double)\n");
+    ir_emit(out, "declare void @nerd_json_set_bool(i8*, i8*, i32)\n");
+    ir_emit(out, "declare i8* @nerd_json_stringify(i8*)\n");
+    ir_emit(out, "declare void @nerd_json_free(i8*)\n");
+    ir_emit(out, "declare void @nerd_json_free_string(i8*)\n");
+    ir_emit(out, "\n");
 
     // Format strings for output
-    fprintf(out, "@.fmt_num = private constant [4 x i8] c\"%%g\\0A\\00\"\n");
-    fprintf(out, "@.fmt_str = private constant [4 x i8] c\"%%s\\0A\\00\"\n");
-    fprintf(out, "@.fmt_int = private constant [6 x i8] c\"%%.0f\\0A\\00\"\n");
-    fprintf(out, "\n");
+    ir_emit(out, "@.fmt_num = private constant [4 x i8] c\"%%g\\0A\\00\"\n");
+    ir_emit(out, "@.fmt_str = private constant [4 x i8] c\"%%s\\0A\\00\"\n");
+    ir_emit(out, "@.fmt_int = private constant [6 x i8] c\"%%.0f\\0A\\00\"\n");
+    ir_emit(out, "\n");
+}
 
-    // Collect all string literals from AST
-    ASTNode *program = ctx->ast;
-    collect_strings(cg, program);
+/*
+ * Emit the global for string literal @.str<index>
+ */
+void codegen_string_decl(IRBuffer *out, size_t index, const char *s) {
+    size_t src_len = strlen(s);
 
-    // Output string literal declarations
-    for (size_t i = 0; i < cg->string_count; i++) {
-        const char *s = cg->string_literals[i];
-        size_t src_len = strlen(s);
-
-        // First pass: count actual length after processing escapes
-        size_t actual_len = 0;
-        for (size_t j = 0; j < src_len; j++) {
-            if (s[j] == '\\' && j + 1 < src_len) {
-                j++;  // Skip escape sequence, counts as 1 char
-            }
-            actual_len++;
+    // First pass: count actual length after processing escapes
+    size_t actual_len = 0;
+    for (size_t j = 0; j < src_len; j++) {
+        if (s[j] == '\\' && j + 1 < src_len) {
+            j++;  // Skip escape sequence, counts as 1 char
         }
+        actual_len++;
+    }
 
-        fprintf(out, "@.str%zu = private constant [%zu x i8] c\"", i, actual_len + 1);
-        for (size_t j = 0; j < src_len; j++) {
-            char c = s[j];
-            if (c == '\\' && j + 1 < src_len) {
-                // Handle escape sequences
-                char next = s[j + 1];
-                if (next == '"') {
-                    fprintf(out, "\\22");  // Quote
-                    j++;
-                } else if (next == '\\') {
-                    fprintf(out, "\\5C");  // Backslash
-                    j++;
-                } else if (next == 'n') {
-                    fprintf(out, "\\0A");  // Newline
-                    j++;
-                } else if (next == 't') {
-                    fprintf(out, "\\09");  // Tab
-                    j++;
-                } else {
-                    // Unknown escape, output as-is
-                    fprintf(out, "\\5C");
-                }
-            } else if (c == '"') {
-                fprintf(out, "\\22");
-            } else if (c >= 32 && c < 127) {
-                fputc(c, out);
+    ir_emit(out, "@.str%zu = private constant [%zu x i8] c\"", index, actual_len + 1);
+    for (size_t j = 0; j < src_len; j++) {
+        char c = s[j];
+        if (c == '\\' && j + 1 < src_len) {
+            // Handle escape sequences
+            char next = s[j + 1];
+            if (next == '"') {
+                ir_emit(out, "\\22");  // Quote
+                j++;
+            } else if (next == '\\') {
+                ir_emit(out, "\\5C");  // Backslash
+                j++;
+            } else if (next == 'n') {
+                ir_emit(out, "\\0A");  // Newline
+                j++;
+            } else if (next == 't') {
+                ir_emit(out, "\\09");  // Tab
+                j++;
             } else {
-                fprintf(out, "\\%02X", (unsigned char)c);
+                // Unknown escape, output as-is
+                ir_emit(out, "\\5C");
             }
+        } else if (c == '"') {
+            ir_emit(out, "\\22");
+        } else if (c >= 32 && c < 127) {
+            ir_append(out, &c, 1);
+        } else {
+            static const char hex[] = "0123456789ABCDEF";
+            char escaped[3] = {'\\', hex[(unsigned char)c >> 4], hex[c & 0xf]};
+            ir_append(out, escaped, 3);
         }
-        fprintf(out, "\\00\"\n");
+    }
+    ir_emit(out, "\\00\"\n");
+}
+
+/*
+ * Emit one function on its own, with string literal references numbered
+ * from @.str0 in the order codegen_llvm would number them
+ *
+ * The function's literals are handed back in *strings (the caller frees
+ * each and the array). Returns the number of @.str references used, which
+ * is how far the numbering moves on for the next function.
+ */
+size_t codegen_function(CodeGen *cg, ASTNode *func, IRBuffer *out,
+                        char ***strings, size_t *string_count) {
+    // Collect into a fresh list and take it over
+    for (size_t i = 0; i < cg->string_count; i++) {
+        free(cg->string_literals[i]);
+    }
+    cg->string_count = 0;
+    collect_strings_func(cg, func);
+    *strings = cg->string_literals;
+    *string_count = cg->string_count;
+    cg->string_literals = malloc(sizeof(char*) * cg->string_capacity);
+    cg->string_count = 0;
+
+    cg->out = out;
+    cg->string_counter = 0;
+    codegen_func(cg, func);
+    return (size_t)cg->string_counter;
+}
+
+/*
+ * Generate LLVM IR for program into a buffer
+ */
+bool codegen_module(NerdContext *ctx, IRBuffer *out) {
+    CodeGen *cg = codegen_create(out);
+    if (!cg) {
+        ctx->error_msg = nerd_strdup("Failed to create code generator");
+        return false;
+    }
+
+    codegen_prelude(out);
+
+    // Collect all string literals from AST
+    ASTNode *program = ctx->ast;
+    collect_strings(cg, program);
+
+    // Output string literal declarations
+    for (size_t i = 0; i < cg->string_count; i++) {
+        codegen_string_decl(out, i, cg->string_literals[i]);
     }
     if (cg->string_count > 0) {
-        fprintf(out, "\n");
+        ir_emit(out, "\n");
     }
 
     // Generate functions
     for (size_t i = 0; i < program->data.program.functions.count; i++) {
-        codegen_func(cg, program->data.program.functions.nodes[i]);
+        codegen_func(cg, ast_list_nodes(&program->data.program.functions)[i]);
     }
 
     codegen_free(cg);
-    fclose(out);
+    if (out->failed) {
+        ctx->error_msg = nerd_strdup("Failed to generate code");
+        return false;
+    }
     return true;
 }
+
+/*
+ * Generate LLVM IR for program into a file
+ */
+bool codegen_llvm(NerdContext *ctx, const char *output_path) {
+    FILE *file = fopen(output_path, "w");
+    if (!file) {
+        ctx->error_msg = nerd_strdup("Failed to open output file");
+        return false;
+    }
+
+    IRBuffer out;
+    ir_init(&out, file);
+    bool ok = codegen_module(ctx, &out);
+    bool written = ir_flush(&out);
+    if (fclose(file) != 0) written = false;
+    if (ok && !written) {
+        ctx->error_msg = nerd_strdup("Failed to write output file");
+        ok = false;
+    }
+    ir_free(&out);
+    return ok;
+}
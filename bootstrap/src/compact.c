@@ -0,0 +1,698 @@
+/*
+ * NERD Compact AST - Index-based tree with per-kind node sizes
+ *
+ * The parser builds ASTNodes, each sized for the largest member of the
+ * union. compact_from_ast flattens a program into three arrays (see
+ * CompactAST in nerd.h) where a Var is three words and a BinOp four;
+ * compact_to_ast rebuilds the pointer form when codegen needs it.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include "nerd.h"
+
+#define KIND_COUNT (NODE_JSON_SET + 1)
+#define HEADER_WORDS 2          // kind/value, line
+
+/*
+ * Payload layout of each kind: child refs, then (start, count) list ranges,
+ * then the name symbol, then string offsets, then a double if has_num
+ */
+typedef struct {
+    uint8_t children;
+    uint8_t lists;
+    uint8_t name;
+    uint8_t strings;
+    uint8_t has_num;
+} NodeLayout;
+
+static const NodeLayout layouts[KIND_COUNT] = {
+    [NODE_PROGRAM]     = { .lists = 2 },
+    [NODE_FUNC_DEF]    = { .children = 1, .lists = 2, .name = 1 },
+    [NODE_TYPE_DEF]    = { .children = 2, .lists = 1, .name = 1 },
+    [NODE_PARAM]       = { .children = 1, .name = 1 },
+    [NODE_RETURN]      = { .children = 1 },
+    [NODE_IF]          = { .children = 3 },
+    [NODE_LET]         = { .children = 1, .name = 1 },
+    [NODE_EXPR_STMT]   = { .children = 1 },
+    [NODE_OUT]         = { .children = 1 },
+    [NODE_REPEAT]      = { .children = 1, .lists = 1, .name = 1 },
+    [NODE_WHILE]       = { .children = 1, .lists = 1 },
+    [NODE_INC]         = { .children = 1, .name = 1 },
+    [NODE_DEC]         = { .children = 1, .name = 1 },
+    [NODE_BINOP]       = { .children = 2 },
+    [NODE_UNARYOP]     = { .children = 1 },
+    [NODE_CALL]        = { .lists = 1, .strings = 2 },
+    [NODE_NUM]         = { .has_num = 1 },
+    [NODE_STR]         = { .strings = 1 },
+    [NODE_BOOL]        = { 0 },
+    [NODE_VAR]         = { .name = 1 },
+    [NODE_POSITIONAL]  = { 0 },
+    [NODE_JSON_NEW]    = { 0 },
+    [NODE_JSON_ACCESS] = { .children = 1, .strings = 1 },
+    [NODE_JSON_HAS]    = { .children = 1, .strings = 1 },
+    [NODE_JSON_COUNT]  = { .children = 1, .strings = 1 },
+    [NODE_JSON_SET]    = { .children = 2, .strings = 1 },
+};
+
+/*
+ * Word offsets of each payload section relative to the node
+ */
+static uint32_t list_offset(const NodeLayout *l) {
+    return HEADER_WORDS + l->children;
+}
+
+static uint32_t name_offset(const NodeLayout *l) {
+    return list_offset(l) + 2u * l->lists;
+}
+
+static uint32_t string_offset(const NodeLayout *l) {
+    return name_offset(l) + l->name;
+}
+
+static uint32_t num_offset(const NodeLayout *l) {
+    return string_offset(l) + l->strings;
+}
+
+static uint32_t node_words(const NodeLayout *l) {
+    return num_offset(l) + 2u * l->has_num;
+}
+
+typedef struct {
+    CompactAST *ast;
+    NodeRef *stack;         // Refs of list entries converted so far
+    size_t stack_count;
+    size_t stack_capacity;
+    bool failed;
+} CompactBuilder;
+
+/*
+ * Grow an array to hold at least `need` elements
+ */
+static bool compact_reserve(CompactBuilder *b, void **array, size_t *capacity,
+                            size_t need, size_t elem) {
+    if (need <= *capacity) return true;
+    size_t cap = *capacity ? *capacity : 256;
+    while (cap < need) cap *= 2;
+    void *grown = realloc(*array, cap * elem);
+    if (!grown) {
+        b->failed = true;
+        return false;
+    }
+    *array = grown;
+    *capacity = cap;
+    return true;
+}
+
+/*
+ * Copy a string into the pool, returning its offset
+ */
+static uint32_t compact_add_string(CompactBuilder *b, const char *s) {
+    if (!s) return STR_NONE;
+    CompactAST *ast = b->ast;
+    size_t len = strlen(s) + 1;
+    if (!compact_reserve(b, (void **)&ast->strings, &ast->string_capacity,
+                         ast->string_len + len, 1)) {
+        return STR_NONE;
+    }
+    uint32_t offset = (uint32_t)ast->string_len;
+    memcpy(ast->strings + offset, s, len);
+    ast->string_len += len;
+    return offset;
+}
+
+static NodeRef compact_node(CompactBuilder *b, ASTNode *node);
+
+/*
+ * Convert a list and store its range at words[at], words[at + 1]
+ *
+ * Entries are collected on the builder stack first, since converting an
+ * entry appends that entry's own lists to the shared array.
+ */
+static void compact_add_list(CompactBuilder *b, ASTList *list, uint32_t at) {
+    size_t base = b->stack_count;
+    ASTNode **nodes = ast_list_nodes(list);
+    for (size_t i = 0; i < list->count; i++) {
+        NodeRef ref = compact_node(b, nodes[i]);
+        if (!compact_reserve(b, (void **)&b->stack, &b->stack_capacity,
+                             b->stack_count + 1, sizeof(NodeRef))) {
+            return;
+        }
+        b->stack[b->stack_count++] = ref;
+    }
+
+    CompactAST *ast = b->ast;
+    size_t count = b->stack_count - base;
+    if (!compact_reserve(b, (void **)&ast->lists, &ast->list_capacity,
+                         ast->list_count + count, sizeof(NodeRef))) {
+        return;
+    }
+    memcpy(ast->lists + ast->list_count, b->stack + base, count * sizeof(NodeRef));
+    ast->words[at] = (uint32_t)ast->list_count;
+    ast->words[at + 1] = (uint32_t)count;
+    ast->list_count += count;
+    b->stack_count = base;
+}
+
+/*
+ * Convert one node and its subtree
+ */
+static NodeRef compact_node(CompactBuilder *b, ASTNode *node) {
+    if (!node || b->failed) return NODE_NONE;
+    if ((unsigned)node->type >= KIND_COUNT) {
+        b->failed = true;
+        return NODE_NONE;
+    }
+
+    CompactAST *ast = b->ast;
+    const NodeLayout *l = &layouts[node->type];
+    if (!compact_reserve(b, (void **)&ast->words, &ast->word_capacity,
+                         ast->word_count + node_words(l), sizeof(uint32_t))) {
+        return NODE_NONE;
+    }
+
+    // Reserve the node's words up front; children go after it in the pool.
+    // Fields are written through ast->words[...] since the pool may move.
+    NodeRef n = (NodeRef)ast->word_count;
+    ast->word_count += node_words(l);
+    memset(ast->words + n, 0, node_words(l) * sizeof(uint32_t));
+    ast->words[n + 1] = (uint32_t)node->line;
+
+    uint32_t value = 0;
+    uint32_t c = n + HEADER_WORDS;
+    uint32_t lists = n + list_offset(l);
+    uint32_t name = n + name_offset(l);
+    uint32_t strings = n + string_offset(l);
+    NodeRef ref;
+
+    switch (node->type) {
+        case NODE_PROGRAM:
+            compact_add_list(b, &node->data.program.types, lists);
+            compact_add_list(b, &node->data.program.functions, lists + 2);
+            break;
+
+        case NODE_FUNC_DEF:
+            ast->words[name] = node->data.func_def.name;
+            compact_add_list(b, &node->data.func_def.params, lists);
+            compact_add_list(b, &node->data.func_def.body, lists + 2);
+            ref = compact_node(b, node->data.func_def.return_type);
+            ast->words[c] = ref;
+            break;
+
+        case NODE_TYPE_DEF:
+            value = node->data.type_def.is_union;
+            ast->words[name] = node->data.type_def.name;
+            compact_add_list(b, &node->data.type_def.fields, lists);
+            ref = compact_node(b, node->data.type_def.ok_type);
+            ast->words[c] = ref;
+            ref = compact_node(b, node->data.type_def.err_type);
+            ast->words[c + 1] = ref;
+            break;
+
+        case NODE_PARAM:
+            ast->words[name] = node->data.param.name;
+            ref = compact_node(b, node->data.param.param_type);
+            ast->words[c] = ref;
+            break;
+
+        case NODE_RETURN:
+            value = (uint32_t)node->data.ret.variant;
+            ref = compact_node(b, node->data.ret.value);
+            ast->words[c] = ref;
+            break;
+
+        case NODE_IF:
+            ref = compact_node(b, node->data.if_stmt.condition);
+            ast->words[c] = ref;
+            ref = compact_node(b, node->data.if_stmt.then_stmt);
+            ast->words[c + 1] = ref;
+            ref = compact_node(b, node->data.if_stmt.else_stmt);
+            ast->words[c + 2] = ref;
+            break;
+
+        case NODE_LET:
+            ast->words[name] = node->data.let.name;
+            ref = compact_node(b, node->data.let.value);
+            ast->words[c] = ref;
+            break;
+
+        case NODE_EXPR_STMT:
+            ref = compact_node(b, node->data.expr_stmt.expr);
+            ast->words[c] = ref;
+            break;
+
+        case NODE_OUT:
+            ref = compact_node(b, node->data.out.value);
+            ast->words[c] = ref;
+            break;
+
+        case NODE_REPEAT:
+            ast->words[name] = node->data.repeat.var_name;
+            ref = compact_node(b, node->data.repeat.count);
+            ast->words[c] = ref;
+            compact_add_list(b, &node->data.repeat.body, lists);
+            break;
+
+        case NODE_WHILE:
+            ref = compact_node(b, node->data.while_loop.condition);
+            ast->words[c] = ref;
+            compact_add_list(b, &node->data.while_loop.body, lists);
+            break;
+
+        case NODE_INC:
+            ast->words[name] = node->data.inc.var_name;
+            ref = compact_node(b, node->data.inc.amount);
+            ast->words[c] = ref;
+            break;
+
+        case NODE_DEC:
+            ast->words[name] = node->data.dec.var_name;
+            ref = compact_node(b, node->data.dec.amount);
+            ast->words[c] = ref;
+            break;
+
+        case NODE_BINOP:
+            value = node->data.binop.op;
+            ref = compact_node(b, node->data.binop.left);
+            ast->words[c] = ref;
+            ref = compact_node(b, node->data.binop.right);
+            ast->words[c + 1] = ref;
+            break;
+
+        case NODE_UNARYOP:
+            value = node->data.unaryop.op;
+            ref = compact_node(b, node->data.unaryop.operand);
+            ast->words[c] = ref;
+            break;
+
+        case NODE_CALL: {
+            uint32_t module = compact_add_string(b, node->data.call.module);
+            uint32_t func = compact_add_string(b, node->data.call.func);
+            ast->words[strings] = module;
+            ast->words[strings + 1] = func;
+            compact_add_list(b, &node->data.call.args, lists);
+            break;
+        }
+
+        case NODE_NUM:
+            memcpy(ast->words + n + num_offset(l), &node->data.num.value, sizeof(double));
+            break;
+
+        case NODE_STR: {
+            uint32_t str = compact_add_string(b, node->data.str.value);
+            ast->words[strings] = str;
+            break;
+        }
+
+        case NODE_BOOL:
+            value = node->data.boolean.value;
+            break;
+
+        case NODE_VAR:
+            ast->words[name] = node->data.var.name;
+            break;
+
+        case NODE_POSITIONAL:
+            value = (uint32_t)node->data.positional.index;
+            break;
+
+        case NODE_JSON_NEW:
+            break;
+
+        case NODE_JSON_ACCESS:
+        case NODE_JSON_HAS:
+        case NODE_JSON_COUNT: {
+            // The three share a layout: object, path
+            uint32_t path = compact_add_string(b, node->data.json_access.path);
+            ast->words[strings] = path;
+            ref = compact_node(b, node->data.json_access.object);
+            ast->words[c] = ref;
+            break;
+        }
+
+        case NODE_JSON_SET: {
+            uint32_t key = compact_add_string(b, node->data.json_set.key);
+            ast->words[strings] = key;
+            ref = compact_node(b, node->data.json_set.object);
+            ast->words[c] = ref;
+            ref = compact_node(b, node->data.json_set.value);
+            ast->words[c + 1] = ref;
+            break;
+        }
+    }
+
+    if (b->failed) return NODE_NONE;
+    ast->words[n] = (uint32_t)node->type | (value << 8);
+    return n;
+}
+
+/*
+ * Flatten a program into a compact AST (NULL if out of memory)
+ *
+ * The pointer tree is left untouched and can be freed afterwards.
+ */
+CompactAST *compact_from_ast(ASTNode *program) {
+    if (!program || program->type != NODE_PROGRAM) return NULL;
+
+    CompactAST *ast = calloc(1, sizeof(CompactAST));
+    if (!ast) return NULL;
+
+    CompactBuilder b = { .ast = ast };
+
+    // Word 0 is never a node, so NODE_NONE can be 0
+    if (compact_reserve(&b, (void **)&ast->words, &ast->word_capacity, 1, sizeof(uint32_t))) {
+        ast->words[0] = 0;
+        ast->word_count = 1;
+        ast->root = compact_node(&b, program);
+    }
+    free(b.stack);
+
+    if (b.failed) {
+        fprintf(stderr, "Error: Out of memory building compact AST\n");
+        compact_free(ast);
+        return NULL;
+    }
+    return ast;
+}
+
+/*
+ * Free a compact AST
+ */
+void compact_free(CompactAST *ast) {
+    if (!ast) return;
+    if (ast->mapping) {
+        munmap(ast->mapping, ast->mapping_len);
+    } else {
+        free(ast->words);
+        free(ast->lists);
+        free(ast->strings);
+    }
+    free(ast);
+}
+
+/*
+ * Bytes held by the tree's three arrays
+ */
+size_t compact_size(const CompactAST *ast) {
+    return ast->word_count * sizeof(uint32_t) +
+           ast->list_count * sizeof(NodeRef) +
+           ast->string_len;
+}
+
+NodeType compact_kind(const CompactAST *ast, NodeRef node) {
+    return (NodeType)(ast->words[node] & 0xff);
+}
+
+int compact_line(const CompactAST *ast, NodeRef node) {
+    return (int)ast->words[node + 1];
+}
+
+/*
+ * The kind's small value: operator, return variant, bool, positional
+ * index or is_union
+ */
+uint32_t compact_value(const CompactAST *ast, NodeRef node) {
+    return ast->words[node] >> 8;
+}
+
+NodeRef compact_child(const CompactAST *ast, NodeRef node, int i) {
+    return ast->words[node + HEADER_WORDS + i];
+}
+
+/*
+ * Entries of list i, with their number in *count
+ */
+const NodeRef *compact_list(const CompactAST *ast, NodeRef node, int i, uint32_t *count) {
+    const NodeLayout *l = &layouts[compact_kind(ast, node)];
+    const uint32_t *range = ast->words + node + list_offset(l) + 2 * i;
+    *count = range[1];
+    return ast->lists + range[0];
+}
+
+Symbol compact_name(const CompactAST *ast, NodeRef node) {
+    const NodeLayout *l = &layouts[compact_kind(ast, node)];
+    return ast->words[node + name_offset(l)];
+}
+
+/*
+ * String i of a node (NULL if the field was NULL)
+ */
+const char *compact_str(const CompactAST *ast, NodeRef node, int i) {
+    const NodeLayout *l = &layouts[compact_kind(ast, node)];
+    uint32_t offset = ast->words[node + string_offset(l) + i];
+    return offset == STR_NONE ? NULL : ast->strings + offset;
+}
+
+double compact_num(const CompactAST *ast, NodeRef node) {
+    const NodeLayout *l = &layouts[compact_kind(ast, node)];
+    double value;
+    memcpy(&value, ast->words + node + num_offset(l), sizeof(double));
+    return value;
+}
+
+static bool is_start(const uint8_t *starts, NodeRef ref) {
+    return (starts[ref / 8] >> (ref % 8)) & 1;
+}
+
+/*
+ * Check the structure of a tree read from outside and translate its names
+ *
+ * Nodes must tile the pool with known kinds, and every child and list entry
+ * must be the start of a node further on, so walks stay in bounds and end.
+ * String offsets must fall inside the pool. Names are read as indexes
+ * 0..name_count into `names` and replaced by the symbols found there; pass
+ * NULL to keep them as they are. Returns false if the tree is malformed.
+ */
+bool compact_relink(CompactAST *ast, const Symbol *names, uint32_t name_count) {
+    size_t count = ast->word_count;
+    if (count < 1 || ast->root >= count) return false;
+    if (ast->string_len > 0 && ast->strings[ast->string_len - 1] != '\0') return false;
+
+    // Mark where each node starts
+    uint8_t *starts = calloc(count / 8 + 1, 1);
+    if (!starts) return false;
+    bool ok = true;
+    size_t n = 1;
+    while (n < count) {
+        uint32_t kind = ast->words[n] & 0xff;
+        if (kind >= KIND_COUNT || n + node_words(&layouts[kind]) > count) {
+            ok = false;
+            break;
+        }
+        starts[n / 8] |= (uint8_t)(1u << (n % 8));
+        n += node_words(&layouts[kind]);
+    }
+
+    ok = ok && is_start(starts, ast->root) && compact_kind(ast, ast->root) == NODE_PROGRAM;
+    for (n = 1; ok && n < count; n += node_words(&layouts[ast->words[n] & 0xff])) {
+        const NodeLayout *l = &layouts[ast->words[n] & 0xff];
+
+        for (uint32_t i = 0; i < l->children && ok; i++) {
+            NodeRef child = ast->words[n + HEADER_WORDS + i];
+            ok = child == NODE_NONE || (child > n && child < count && is_start(starts, child));
+        }
+
+        for (uint32_t i = 0; i < l->lists && ok; i++) {
+            const uint32_t *range = ast->words + n + list_offset(l) + 2 * i;
+            ok = range[0] <= ast->list_count && range[1] <= ast->list_count - range[0];
+            for (uint32_t k = 0; k < range[1] && ok; k++) {
+                NodeRef entry = ast->lists[range[0] + k];
+                ok = entry > n && entry < count && is_start(starts, entry);
+            }
+        }
+
+        for (uint32_t i = 0; i < l->strings && ok; i++) {
+            uint32_t offset = ast->words[n + string_offset(l) + i];
+            ok = offset == STR_NONE || offset < ast->string_len;
+        }
+
+        if (l->name && ok) {
+            uint32_t *name = &ast->words[n + name_offset(l)];
+            ok = *name <= name_count;
+            // Skip identical symbols so untouched pages of a mapping stay shared
+            if (ok && names && names[*name] != *name) *name = names[*name];
+        }
+    }
+
+    free(starts);
+    return ok;
+}
+
+static ASTNode *expand_node(const CompactAST *ast, Arena *arena, NodeRef n);
+
+static void expand_list(const CompactAST *ast, Arena *arena, NodeRef n, int i, ASTList *list) {
+    uint32_t count;
+    const NodeRef *refs = compact_list(ast, n, i, &count);
+    ast_list_init(list);
+    if (count == 0) return;
+
+    // The length is known, so allocate the list once at its final size
+    if (!ast_list_reserve(arena, list, count)) return;
+    ASTNode **nodes = ast_list_nodes(list);
+    for (uint32_t k = 0; k < count; k++) {
+        nodes[list->count++] = expand_node(ast, arena, refs[k]);
+    }
+}
+
+static char *expand_str(const CompactAST *ast, Arena *arena, NodeRef n, int i) {
+    return arena_strdup(arena, compact_str(ast, n, i));
+}
+
+static ASTNode *expand_node(const CompactAST *ast, Arena *arena, NodeRef n) {
+    if (n == NODE_NONE) return NULL;
+
+    NodeType kind = compact_kind(ast, n);
+    ASTNode *node = ast_create(arena, kind, compact_line(ast, n));
+    if (!node) return NULL;
+
+    uint32_t value = compact_value(ast, n);
+
+    switch (kind) {
+        case NODE_PROGRAM:
+            expand_list(ast, arena, n, 0, &node->data.program.types);
+            expand_list(ast, arena, n, 1, &node->data.program.functions);
+            break;
+
+        case NODE_FUNC_DEF:
+            node->data.func_def.name = compact_name(ast, n);
+            expand_list(ast, arena, n, 0, &node->data.func_def.params);
+            node->data.func_def.return_type = expand_node(ast, arena, compact_child(ast, n, 0));
+            expand_list(ast, arena, n, 1, &node->data.func_def.body);
+            break;
+
+        case NODE_TYPE_DEF:
+            node->data.type_def.name = compact_name(ast, n);
+            node->data.type_def.is_union = value != 0;
+            expand_list(ast, arena, n, 0, &node->data.type_def.fields);
+            node->data.type_def.ok_type = expand_node(ast, arena, compact_child(ast, n, 0));
+            node->data.type_def.err_type = expand_node(ast, arena, compact_child(ast, n, 1));
+            break;
+
+        case NODE_PARAM:
+            node->data.param.name = compact_name(ast, n);
+            node->data.param.param_type = expand_node(ast, arena, compact_child(ast, n, 0));
+            break;
+
+        case NODE_RETURN:
+            node->data.ret.variant = (int)value;
+            node->data.ret.value = expand_node(ast, arena, compact_child(ast, n, 0));
+            break;
+
+        case NODE_IF:
+            node->data.if_stmt.condition = expand_node(ast, arena, compact_child(ast, n, 0));
+            node->data.if_stmt.then_stmt = expand_node(ast, arena, compact_child(ast, n, 1));
+            node->data.if_stmt.else_stmt = expand_node(ast, arena, compact_child(ast, n, 2));
+            break;
+
+        case NODE_LET:
+            node->data.let.name = compact_name(ast, n);
+            node->data.let.value = expand_node(ast, arena, compact_child(ast, n, 0));
+            break;
+
+        case NODE_EXPR_STMT:
+            node->data.expr_stmt.expr = expand_node(ast, arena, compact_child(ast, n, 0));
+            break;
+
+        case NODE_OUT:
+            node->data.out.value = expand_node(ast, arena, compact_child(ast, n, 0));
+            break;
+
+        case NODE_REPEAT:
+            node->data.repeat.count = expand_node(ast, arena, compact_child(ast, n, 0));
+            node->data.repeat.var_name = compact_name(ast, n);
+            expand_list(ast, arena, n, 0, &node->data.repeat.body);
+            break;
+
+        case NODE_WHILE:
+            node->data.while_loop.condition = expand_node(ast, arena, compact_child(ast, n, 0));
+            expand_list(ast, arena, n, 0, &node->data.while_loop.body);
+            break;
+
+        case NODE_INC:
+            node->data.inc.var_name = compact_name(ast, n);
+            node->data.inc.amount = expand_node(ast, arena, compact_child(ast, n, 0));
+            break;
+
+        case NODE_DEC:
+            node->data.dec.var_name = compact_name(ast, n);
+            node->data.dec.amount = expand_node(ast, arena, compact_child(ast, n, 0));
+            break;
+
+        case NODE_BINOP:
+            node->data.binop.op = (OpCode)value;
+            node->data.binop.left = expand_node(ast, arena, compact_child(ast, n, 0));
+            node->data.binop.right = expand_node(ast, arena, compact_child(ast, n, 1));
+            break;
+
+        case NODE_UNARYOP:
+            node->data.unaryop.op = (OpCode)value;
+            node->data.unaryop.operand = expand_node(ast, arena, compact_child(ast, n, 0));
+            break;
+
+        case NODE_CALL:
+            node->data.call.module = expand_str(ast, arena, n, 0);
+            node->data.call.func = expand_str(ast, arena, n, 1);
+            expand_list(ast, arena, n, 0, &node->data.call.args);
+            break;
+
+        case NODE_NUM:
+            node->data.num.value = compact_num(ast, n);
+            break;
+
+        case NODE_STR:
+            node->data.str.value = expand_str(ast, arena, n, 0);
+            break;
+
+        case NODE_BOOL:
+            node->data.boolean.value = value != 0;
+            break;
+
+        case NODE_VAR:
+            node->data.var.name = compact_name(ast, n);
+            break;
+
+        case NODE_POSITIONAL:
+            node->data.positional.index = (int)value;
+            break;
+
+        case NODE_JSON_NEW:
+            break;
+
+        case NODE_JSON_ACCESS:
+        case NODE_JSON_HAS:
+        case NODE_JSON_COUNT:
+            node->data.json_access.object = expand_node(ast, arena, compact_child(ast, n, 0));
+            node->data.json_access.path = expand_str(ast, arena, n, 0);
+            break;
+
+        case NODE_JSON_SET:
+            node->data.json_set.object = expand_node(ast, arena, compact_child(ast, n, 0));
+            node->data.json_set.key = expand_str(ast, arena, n, 0);
+            node->data.json_set.value = expand_node(ast, arena, compact_child(ast, n, 1));
+            break;
+    }
+
+    return node;
+}
+
+/*
+ * Rebuild the pointer tree, e.g. for codegen (NULL if out of memory)
+ *
+ * The program node owns a fresh arena and is released with ast_free.
+ */
+ASTNode *compact_to_ast(const CompactAST *ast) {
+    Arena *arena = arena_create();
+    if (!arena) return NULL;
+
+    ASTNode *program = expand_node(ast, arena, ast->root);
+    if (!program) {
+        arena_free(arena);
+        return NULL;
+    }
+    program->data.program.arena = arena;
+    return program;
+}
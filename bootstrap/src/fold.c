@@ -0,0 +1,355 @@
+/*
+ * NERD Constant Folding - Evaluates what is known before codegen
+ *
+ * Runs between name resolution and type inference. Operators, neg, not,
+ * comparisons and math calls whose operands are literals become literals
+ * (number words are already numbers), and an if whose condition folds to
+ * a literal is replaced by the branch it takes.
+ *
+ * A local stored to exactly once, by a let at the top level of the body,
+ * holds that value at every read: reads come after the let in emission
+ * order, and nothing at the top level runs twice. When the let's value
+ * folds to a literal, the reads become copies of it. The let stays, for
+ * the module calls whose arguments are not folded.
+ *
+ * Results match what codegen would compute at runtime: IEEE doubles,
+ * fmod for frem, ordered comparisons, and nonzero-and-not-NaN is true.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include "nerd.h"
+
+typedef struct {
+    int *stores;                // Stores to each local slot
+    ASTNode **values;           // Literal a local holds at every read, or NULL
+    int local_count;
+} FoldContext;
+
+static bool is_literal(const ASTNode *node) {
+    return node && (node->type == NODE_NUM || node->type == NODE_BOOL);
+}
+
+/*
+ * A literal as the double codegen widens it to
+ */
+static double literal_value(const ASTNode *node) {
+    if (node->type == NODE_BOOL) return node->data.boolean.value ? 1.0 : 0.0;
+    return node->data.num.value;
+}
+
+/*
+ * A literal as a condition (NaN is false, like fcmp one)
+ */
+static bool literal_truth(const ASTNode *node) {
+    if (node->type == NODE_BOOL) return node->data.boolean.value;
+    double value = node->data.num.value;
+    return value < 0 || value > 0;
+}
+
+/*
+ * Turn a node into a literal in place. Nodes only have room for their own
+ * union member, but a var, operator or call is never smaller than a literal.
+ */
+static void make_num(ASTNode *node, double value) {
+    node->type = NODE_NUM;
+    node->data.num.value = value;
+}
+
+static void make_bool(ASTNode *node, bool value) {
+    node->type = NODE_BOOL;
+    node->data.boolean.value = value;
+}
+
+/*
+ * Fold an operator with literal operands
+ */
+static void fold_binop(ASTNode *node) {
+    ASTNode *left = node->data.binop.left;
+    ASTNode *right = node->data.binop.right;
+    double a = literal_value(left);
+    double b = literal_value(right);
+
+    switch (node->data.binop.op) {
+        case OP_PLUS:  make_num(node, a + b); break;
+        case OP_MINUS: make_num(node, a - b); break;
+        case OP_TIMES: make_num(node, a * b); break;
+        case OP_OVER:  make_num(node, a / b); break;
+        case OP_MOD:   make_num(node, fmod(a, b)); break;
+        case OP_EQ:    make_bool(node, a == b); break;
+        case OP_NEQ:   make_bool(node, a < b || a > b); break;
+        case OP_LT:    make_bool(node, a < b); break;
+        case OP_GT:    make_bool(node, a > b); break;
+        case OP_LTE:   make_bool(node, a <= b); break;
+        case OP_GTE:   make_bool(node, a >= b); break;
+        case OP_AND:   make_bool(node, literal_truth(left) && literal_truth(right)); break;
+        case OP_OR:    make_bool(node, literal_truth(left) || literal_truth(right)); break;
+        default:       break;
+    }
+}
+
+/*
+ * Fold a math call whose arguments (the ones codegen reads) are literals
+ */
+static void fold_math(ASTNode *node) {
+    ASTList *args = &node->data.call.args;
+    const char *func = node->data.call.func;
+    if (args->count == 0 || !is_literal(ast_list_nodes(args)[0])) return;
+    double x = literal_value(ast_list_nodes(args)[0]);
+
+    if (strcmp(func, "abs") == 0) {
+        make_num(node, fabs(x));
+    } else if (strcmp(func, "sqrt") == 0) {
+        make_num(node, sqrt(x));
+    } else if (strcmp(func, "floor") == 0) {
+        make_num(node, floor(x));
+    } else if (strcmp(func, "ceil") == 0) {
+        make_num(node, ceil(x));
+    } else if (strcmp(func, "sin") == 0) {
+        make_num(node, sin(x));
+    } else if (strcmp(func, "cos") == 0) {
+        make_num(node, cos(x));
+    } else if (args->count > 1 && is_literal(ast_list_nodes(args)[1])) {
+        double y = literal_value(ast_list_nodes(args)[1]);
+        if (strcmp(func, "min") == 0) {
+            make_num(node, fmin(x, y));
+        } else if (strcmp(func, "max") == 0) {
+            make_num(node, fmax(x, y));
+        } else if (strcmp(func, "pow") == 0) {
+            make_num(node, pow(x, y));
+        }
+    }
+}
+
+/*
+ * Fold an expression in place
+ */
+static void fold_expr(FoldContext *f, ASTNode *node) {
+    if (!node) return;
+
+    switch (node->type) {
+        case NODE_VAR: {
+            int slot = node->data.var.slot;
+            if (node->data.var.bind == BIND_LOCAL && slot >= 0 && slot < f->local_count &&
+                f->values[slot]) {
+                ASTNode *value = f->values[slot];
+                if (value->type == NODE_BOOL) {
+                    make_bool(node, value->data.boolean.value);
+                } else {
+                    make_num(node, value->data.num.value);
+                }
+            }
+            break;
+        }
+
+        case NODE_BINOP:
+            fold_expr(f, node->data.binop.left);
+            fold_expr(f, node->data.binop.right);
+            if (is_literal(node->data.binop.left) && is_literal(node->data.binop.right)) {
+                fold_binop(node);
+            }
+            break;
+
+        case NODE_UNARYOP: {
+            ASTNode *operand = node->data.unaryop.operand;
+            fold_expr(f, operand);
+            if (!is_literal(operand)) break;
+
+            if (node->data.unaryop.op == OP_NEG) {
+                make_num(node, 0.0 - literal_value(operand));
+            } else if (operand->type == NODE_BOOL) {
+                make_bool(node, !operand->data.boolean.value);
+            } else {
+                // not of a number: only zero is false (NaN is neither)
+                make_bool(node, operand->data.num.value == 0);
+            }
+            break;
+        }
+
+        case NODE_CALL: {
+            // Other modules look at their arguments' node kinds
+            const char *module = node->data.call.module;
+            bool math = module && strcmp(module, "math") == 0;
+            if (module && !math) break;
+
+            for (size_t i = 0; i < node->data.call.args.count; i++) {
+                fold_expr(f, ast_list_nodes(&node->data.call.args)[i]);
+            }
+            if (math) fold_math(node);
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+static ASTNode *fold_stmt(FoldContext *f, ASTNode *node, bool top);
+
+/*
+ * Fold a list of statements, dropping the ones that fold away
+ */
+static void fold_body(FoldContext *f, ASTList *body, bool top) {
+    ASTNode **nodes = ast_list_nodes(body);
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < body->count; i++) {
+        ASTNode *stmt = fold_stmt(f, nodes[i], top);
+        if (stmt) nodes[kept++] = stmt;
+    }
+    body->count = kept;
+}
+
+/*
+ * Fold a statement, returning what replaces it (NULL to drop it)
+ */
+static ASTNode *fold_stmt(FoldContext *f, ASTNode *node, bool top) {
+    if (!node) return NULL;
+
+    switch (node->type) {
+        case NODE_LET: {
+            // JSON lets take a literal url and body
+            if (node->data.let.bind != BIND_LOCAL) break;
+            fold_expr(f, node->data.let.value);
+
+            int slot = node->data.let.slot;
+            if (top && slot >= 0 && slot < f->local_count && f->stores[slot] == 1 &&
+                is_literal(node->data.let.value)) {
+                f->values[slot] = node->data.let.value;
+            }
+            break;
+        }
+
+        case NODE_RETURN:
+            fold_expr(f, node->data.ret.value);
+            break;
+
+        case NODE_IF: {
+            fold_expr(f, node->data.if_stmt.condition);
+            if (is_literal(node->data.if_stmt.condition)) {
+                // Only the branch taken is left
+                ASTNode *taken = literal_truth(node->data.if_stmt.condition)
+                    ? node->data.if_stmt.then_stmt : node->data.if_stmt.else_stmt;
+                return fold_stmt(f, taken, false);
+            }
+            node->data.if_stmt.then_stmt = fold_stmt(f, node->data.if_stmt.then_stmt, false);
+            node->data.if_stmt.else_stmt = fold_stmt(f, node->data.if_stmt.else_stmt, false);
+            break;
+        }
+
+        case NODE_EXPR_STMT:
+            fold_expr(f, node->data.expr_stmt.expr);
+            break;
+
+        case NODE_OUT:
+            fold_expr(f, node->data.out.value);
+            break;
+
+        case NODE_REPEAT:
+            fold_expr(f, node->data.repeat.count);
+            fold_body(f, &node->data.repeat.body, false);
+            break;
+
+        case NODE_WHILE:
+            fold_expr(f, node->data.while_loop.condition);
+            fold_body(f, &node->data.while_loop.body, false);
+            break;
+
+        case NODE_INC:
+            fold_expr(f, node->data.inc.amount);
+            break;
+
+        case NODE_DEC:
+            fold_expr(f, node->data.dec.amount);
+            break;
+
+        case NODE_JSON_SET:
+            fold_expr(f, node->data.json_set.value);
+            break;
+
+        default:
+            fold_expr(f, node);
+            break;
+    }
+    return node;
+}
+
+/*
+ * Count the stores to each local: lets, inc/dec and repeat counters
+ */
+static void count_stores(FoldContext *f, ASTNode *node) {
+    if (!node) return;
+
+    int slot = -1;
+    const ASTList *body = NULL;
+    switch (node->type) {
+        case NODE_LET:
+            if (node->data.let.bind == BIND_LOCAL) slot = node->data.let.slot;
+            break;
+        case NODE_INC:
+            slot = node->data.inc.slot;
+            break;
+        case NODE_DEC:
+            slot = node->data.dec.slot;
+            break;
+        case NODE_IF:
+            count_stores(f, node->data.if_stmt.then_stmt);
+            count_stores(f, node->data.if_stmt.else_stmt);
+            break;
+        case NODE_REPEAT:
+            slot = node->data.repeat.slot;
+            body = &node->data.repeat.body;
+            break;
+        case NODE_WHILE:
+            body = &node->data.while_loop.body;
+            break;
+        default:
+            break;
+    }
+
+    if (slot >= 0 && slot < f->local_count) f->stores[slot]++;
+    for (size_t i = 0; body && i < body->count; i++) {
+        count_stores(f, ast_list_nodes(body)[i]);
+    }
+}
+
+/*
+ * Fold the constants of one function (false if out of memory)
+ */
+bool fold_function(ASTNode *func) {
+    FoldContext f = {0};
+    f.local_count = func->data.func_def.local_count;
+    if (f.local_count > 0) {
+        f.stores = calloc((size_t)f.local_count, sizeof(int));
+        f.values = calloc((size_t)f.local_count, sizeof(ASTNode *));
+        if (!f.stores || !f.values) {
+            fprintf(stderr, "Error: Out of memory\n");
+            free(f.stores);
+            free(f.values);
+            return false;
+        }
+    }
+
+    ASTList *body = &func->data.func_def.body;
+    for (size_t i = 0; i < body->count; i++) {
+        count_stores(&f, ast_list_nodes(body)[i]);
+    }
+    fold_body(&f, body, true);
+
+    free(f.stores);
+    free(f.values);
+    return true;
+}
+
+/*
+ * Fold the constants of every function of a program
+ */
+bool fold_program(ASTNode *program) {
+    for (size_t i = 0; i < program->data.program.functions.count; i++) {
+        if (!fold_function(ast_list_nodes(&program->data.program.functions)[i])) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,390 @@
+/*
+ * NERD Incremental Compilation - Rebuilds only the functions that changed
+ *
+ * A function body runs from its 'fn' token to the next 'fn' or 'type', so
+ * each function is identified by a fingerprint of that token range: token
+ * types and text, not offsets, so editing one function or moving it leaves
+ * the others alone. A rebuild lexes the whole source (cheap), then takes
+ * each function's AST and IR from the previous build if its fingerprint is
+ * known, and parses and emits it otherwise. Type definitions and loose
+ * top-level statements (the implicit main) are redone every time.
+ *
+ * Labels and temporaries are already numbered per function. String
+ * literals are global, so fragments are emitted with their references
+ * numbered from @.str0 and renumbered as the module is written. Reused
+ * ASTs keep the line numbers they were parsed with; IR does not use them.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include "nerd.h"
+
+// The functions parsed by one build share an arena, freed with the last of them
+typedef struct {
+    Arena *arena;
+    size_t live;
+} UnitArena;
+
+struct FunctionUnit {
+    uint64_t fingerprint;
+    UnitArena *arena;       // Owns the function's AST
+    ASTNode *func;
+    char *ir;               // Function IR, string references from @.str0
+    size_t ir_len;
+    char **strings;         // Literals the function declares, in order
+    size_t string_count;
+    size_t string_refs;     // How many @.str numbers the IR uses
+};
+
+IncrementalBuild *incremental_create(void) {
+    return calloc(1, sizeof(IncrementalBuild));
+}
+
+static void unit_free(FunctionUnit *unit) {
+    if (!unit) return;
+    if (unit->arena && --unit->arena->live == 0) {
+        arena_free(unit->arena->arena);
+        free(unit->arena);
+    }
+    free(unit->ir);
+    for (size_t i = 0; i < unit->string_count; i++) {
+        free(unit->strings[i]);
+    }
+    free(unit->strings);
+    free(unit);
+}
+
+void incremental_free(IncrementalBuild *build) {
+    if (!build) return;
+    for (size_t i = 0; i < build->unit_count; i++) {
+        unit_free(build->units[i]);
+    }
+    free(build->units);
+    free(build);
+}
+
+/*
+ * Fingerprint of tokens [start, end): FNV-1a over each token's type and text
+ */
+static uint64_t fingerprint(TokenStream *ts, size_t start, size_t end) {
+    uint64_t h = 14695981039346656037ull;
+    for (size_t i = start; i < end; i++) {
+        h = (h ^ ts->types[i]) * 1099511628211ull;
+        const unsigned char *text = (const unsigned char *)ts->source + ts->offsets[i];
+        for (uint32_t k = 0; k < ts->lengths[i]; k++) {
+            h = (h ^ text[k]) * 1099511628211ull;
+        }
+        h = (h ^ 0xff) * 1099511628211ull;     // Token separator
+    }
+    return h;
+}
+
+/*
+ * Write a fragment with its @.str references moved up by base
+ */
+static void write_fragment(IRBuffer *out, const char *ir, size_t len, size_t base) {
+    if (base == 0) {
+        ir_append(out, ir, len);
+        return;
+    }
+
+    const char *p = ir;
+    const char *end = ir + len;
+    while (p < end) {
+        const char *at = memchr(p, '@', (size_t)(end - p));
+        if (!at) break;
+        if ((size_t)(end - at) > 5 && memcmp(at, "@.str", 5) == 0 &&
+            at[5] >= '0' && at[5] <= '9') {
+            const char *digits = at + 5;
+            size_t index = 0;
+            while (digits < end && *digits >= '0' && *digits <= '9') {
+                index = index * 10 + (size_t)(*digits++ - '0');
+            }
+            ir_append(out, p, (size_t)(at - p));
+            ir_emit(out, "@.str%zu", index + base);
+            p = digits;
+        } else {
+            ir_append(out, p, (size_t)(at - p) + 1);
+            p = at + 1;
+        }
+    }
+    ir_append(out, p, (size_t)(end - p));
+}
+
+/*
+ * Parse one function segment [start, end) into a new unit
+ */
+static FunctionUnit *unit_parse(Parser *parser, UnitArena *pool, size_t start, size_t end,
+                                uint64_t fp) {
+    FunctionUnit *unit = calloc(1, sizeof(FunctionUnit));
+    if (!unit) return NULL;
+    unit->fingerprint = fp;
+
+    // Parse into the shared arena so the AST can outlive this build
+    Arena *arena = parser->arena;
+    parser->arena = pool->arena;
+    parser->pos = start;
+
+    ASTList types, functions, stmts;
+    ast_list_init(&types);
+    ast_list_init(&functions);
+    ast_list_init(&stmts);
+    bool has_main = false;
+    bool ok = parser_parse_segment(parser, end, &types, &functions, &stmts, &has_main);
+    parser->arena = arena;
+
+    // A body stops at the next 'fn' or 'type', so this is one function
+    if (!ok || functions.count != 1 || types.count != 0 || stmts.count != 0 ||
+        parser->pos != end) {
+        unit_free(unit);
+        return NULL;
+    }
+    unit->func = ast_list_nodes(&functions)[0];
+    unit->arena = pool;
+    pool->live++;
+    return unit;
+}
+
+/*
+ * Emit a unit's IR into memory
+ */
+static bool unit_emit(CodeGen *cg, FunctionUnit *unit) {
+    IRBuffer ir;
+    ir_init(&ir, NULL);
+    unit->string_refs = codegen_function(cg, unit->func, &ir, &unit->strings, &unit->string_count);
+    if (ir.failed) {
+        ir_free(&ir);
+        return false;
+    }
+    unit->ir = ir_take(&ir, &unit->ir_len);
+    return unit->ir != NULL;
+}
+
+/*
+ * Index of the previous build's units by fingerprint (slot = index + 1)
+ */
+static size_t *index_units(IncrementalBuild *build, size_t *mask) {
+    size_t slots = 16;
+    while (slots < build->unit_count * 2) slots *= 2;
+    size_t *table = calloc(slots, sizeof(size_t));
+    if (!table) return NULL;
+    *mask = slots - 1;
+    for (size_t i = 0; i < build->unit_count; i++) {
+        size_t s = (size_t)build->units[i]->fingerprint & *mask;
+        while (table[s]) s = (s + 1) & *mask;
+        table[s] = i + 1;
+    }
+    return table;
+}
+
+/*
+ * Compile a source to LLVM IR, reusing what the last build can
+ *
+ * On failure (a lex or parse error, already reported) the previous build
+ * is kept, so the next attempt can still reuse it.
+ */
+bool incremental_compile(IncrementalBuild *build, const char *source, size_t len,
+                         const char *output_path) {
+    Lexer *lexer = lexer_create(source, len);
+    if (!lexer || !lexer_tokenize(lexer)) {
+        lexer_free(lexer);
+        return false;
+    }
+    TokenStream *ts = &lexer->tokens;
+    size_t eof = ts->count - 1;
+
+    Parser *parser = parser_create(ts);
+    size_t mask = 0;
+    size_t *table = index_units(build, &mask);
+    bool *taken = calloc(build->unit_count + 1, sizeof(bool));
+    FunctionUnit **units = NULL;
+    size_t unit_count = 0;
+    size_t unit_capacity = 0;
+    bool *fresh = NULL;
+    UnitArena *pool = NULL;
+    FunctionUnit main_unit = {0};     // The implicit main, rebuilt every time
+    Resolver *resolver = NULL;
+    CodeGen *cg = NULL;
+    FILE *file = NULL;
+    IRBuffer out;
+    ir_init(&out, NULL);
+    bool ok = false;
+
+    if (!parser || !table || !taken) goto done;
+
+    // Everything outside functions goes into the parser's own arena
+    ASTList types, functions, stmts;
+    ast_list_init(&types);
+    ast_list_init(&functions);
+    ast_list_init(&stmts);
+    bool has_main = false;
+    Symbol main_sym = intern_cstr("main");
+    size_t reused = 0;
+
+    // Walk the segments: each starts at an 'fn' or 'type' token, except
+    // for the loose statements before the first one
+    size_t start = 0;
+    while (start < eof) {
+        size_t end = start;
+        if (ts->types[end] == TOK_FN || ts->types[end] == TOK_TYPE) end++;
+        while (end < eof && ts->types[end] != TOK_FN && ts->types[end] != TOK_TYPE) end++;
+
+        if (ts->types[start] != TOK_FN) {
+            parser->pos = start;
+            if (!parser_parse_segment(parser, end, &types, &functions, &stmts, &has_main) ||
+                parser->pos != end) {
+                goto done;
+            }
+            start = end;
+            continue;
+        }
+
+        if (unit_count == unit_capacity) {
+            unit_capacity = unit_capacity ? unit_capacity * 2 : 64;
+            FunctionUnit **grown = realloc(units, sizeof(FunctionUnit*) * unit_capacity);
+            bool *grown_fresh = realloc(fresh, sizeof(bool) * unit_capacity);
+            if (grown) units = grown;
+            if (grown_fresh) fresh = grown_fresh;
+            if (!grown || !grown_fresh) goto done;
+        }
+
+        uint64_t fp = fingerprint(ts, start, end);
+        FunctionUnit *unit = NULL;
+        for (size_t s = (size_t)fp & mask; table[s]; s = (s + 1) & mask) {
+            size_t i = table[s] - 1;
+            if (!taken[i] && build->units[i]->fingerprint == fp) {
+                taken[i] = true;
+                unit = build->units[i];
+                break;
+            }
+        }
+
+        fresh[unit_count] = unit == NULL;
+        if (unit) {
+            reused++;
+        } else {
+            if (!pool) {
+                pool = calloc(1, sizeof(UnitArena));
+                if (!pool) goto done;
+                pool->live = 1;       // This build's reference, dropped at the end
+                pool->arena = arena_create();
+                if (!pool->arena) goto done;
+            }
+            unit = unit_parse(parser, pool, start, end, fp);
+            if (!unit) goto done;
+        }
+        units[unit_count++] = unit;
+        if (unit->func->data.func_def.name == main_sym) has_main = true;
+        start = end;
+    }
+
+    // Loose statements become the implicit main, as in parser_parse
+    ASTNode *implicit_main = NULL;
+    if (stmts.count > 0 && has_main) {
+        fprintf(stderr, "Error: Cannot mix top-level statements with explicit main\n");
+        goto done;
+    } else if (stmts.count > 0) {
+        implicit_main = ast_create(parser->arena, NODE_FUNC_DEF, 1);
+        if (!implicit_main) goto done;
+        implicit_main->data.func_def.name = main_sym;
+        ast_list_init(&implicit_main->data.func_def.params);
+        implicit_main->data.func_def.return_type = NULL;
+        implicit_main->data.func_def.body = stmts;
+    }
+
+    // Resolve, fold, type and emit the new functions; names are all interned
+    // by now. Reused functions keep the slots and types they were given.
+    resolver = resolver_create();
+    cg = codegen_create(NULL);
+    if (!resolver || !cg) goto done;
+    bool resolved = true;
+    for (size_t i = 0; i < unit_count; i++) {
+        if (fresh[i] && !(resolve_function(resolver, units[i]->func) &&
+                          fold_function(units[i]->func) &&
+                          infer_function(units[i]->func))) {
+            resolved = false;
+        }
+    }
+    if (implicit_main && !(resolve_function(resolver, implicit_main) &&
+                           fold_function(implicit_main) &&
+                           infer_function(implicit_main))) {
+        resolved = false;
+    }
+    if (!resolved) goto done;
+
+    for (size_t i = 0; i < unit_count; i++) {
+        if (fresh[i] && !unit_emit(cg, units[i])) goto done;
+    }
+    main_unit.func = implicit_main;
+    if (implicit_main && !unit_emit(cg, &main_unit)) goto done;
+
+    file = fopen(output_path, "w");
+    if (!file) {
+        fprintf(stderr, "Error: Failed to open output file\n");
+        goto done;
+    }
+
+    // Same layout as codegen_llvm: literals in function order, then code
+    ir_init(&out, file);
+    codegen_prelude(&out);
+    size_t index = 0;
+    for (size_t i = 0; i <= unit_count; i++) {
+        FunctionUnit *unit = i < unit_count ? units[i] : &main_unit;
+        for (size_t k = 0; k < unit->string_count; k++) {
+            codegen_string_decl(&out, index++, unit->strings[k]);
+        }
+    }
+    if (index > 0) ir_puts(&out, "\n");
+
+    size_t base = 0;
+    for (size_t i = 0; i <= unit_count; i++) {
+        FunctionUnit *unit = i < unit_count ? units[i] : &main_unit;
+        if (!unit->func) continue;
+        write_fragment(&out, unit->ir, unit->ir_len, base);
+        base += unit->string_refs;
+    }
+    ok = ir_flush(&out);
+    if (fclose(file) != 0) ok = false;
+    file = NULL;
+
+    if (ok) {
+        // Keep this build's units; drop the old ones nobody took
+        for (size_t i = 0; i < build->unit_count; i++) {
+            if (!taken[i]) unit_free(build->units[i]);
+        }
+        free(build->units);
+        build->units = units;
+        build->unit_count = unit_count;
+        build->reused = reused;
+        build->rebuilt = unit_count - reused;
+        units = NULL;
+        unit_count = 0;
+    }
+
+done:
+    // On failure, free only what this build created
+    for (size_t i = 0; i < unit_count; i++) {
+        if (fresh[i]) unit_free(units[i]);
+    }
+    if (pool && --pool->live == 0) {
+        arena_free(pool->arena);
+        free(pool);
+    }
+    if (file) fclose(file);
+    ir_free(&out);
+    free(main_unit.ir);
+    for (size_t k = 0; k < main_unit.string_count; k++) {
+        free(main_unit.strings[k]);
+    }
+    free(main_unit.strings);
+    free(units);
+    free(fresh);
+    free(taken);
+    free(table);
+    codegen_free(cg);
+    resolver_free(resolver);
+    parser_free(parser);
+    lexer_free(lexer);
+    return ok;
+}
@@ -0,0 +1,192 @@
+/*
+ * NERD String Interning - Maps identifier text to dense symbol IDs
+ *
+ * Every distinct identifier is stored once and numbered from 1 in the order
+ * it is first seen, so later phases can compare names as integers or use a
+ * symbol directly as an array index. The table is global and lives for the
+ * whole compiler run.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "nerd.h"
+
+#define INTERN_POOL_BLOCK 65536
+
+/*
+ * Interning table
+ */
+typedef struct InternPool InternPool;
+struct InternPool {
+    InternPool *next;
+    size_t used;
+    size_t capacity;
+    char data[];
+};
+
+static struct {
+    // Indexed by symbol; entry 0 is SYM_NONE
+    const char **names;
+    uint32_t *lengths;
+    uint32_t *hashes;
+    uint32_t count;
+    uint32_t capacity;
+
+    // Open-addressed hash slots holding symbols (0 = empty)
+    Symbol *slots;
+    uint32_t slot_mask;
+
+    // Name storage
+    InternPool *pool;
+} table;
+
+/*
+ * FNV-1a hash of a name
+ */
+static uint32_t intern_hash(const char *s, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/*
+ * Copy a name into the pool and NUL-terminate it
+ */
+static const char *intern_store(const char *s, size_t len) {
+    InternPool *pool = table.pool;
+    if (!pool || pool->used + len + 1 > pool->capacity) {
+        size_t capacity = len + 1 > INTERN_POOL_BLOCK ? len + 1 : INTERN_POOL_BLOCK;
+        pool = malloc(sizeof(InternPool) + capacity);
+        if (!pool) return NULL;
+        pool->next = table.pool;
+        pool->used = 0;
+        pool->capacity = capacity;
+        table.pool = pool;
+    }
+
+    char *name = pool->data + pool->used;
+    memcpy(name, s, len);
+    name[len] = '\0';
+    pool->used += len + 1;
+    return name;
+}
+
+/*
+ * Grow the hash slots and rehash (load factor kept under 1/2)
+ */
+static bool intern_grow_slots(void) {
+    uint32_t slot_count = table.slots ? (table.slot_mask + 1) * 2 : 256;
+    Symbol *slots = calloc(slot_count, sizeof(Symbol));
+    if (!slots) return false;
+
+    uint32_t mask = slot_count - 1;
+    for (Symbol sym = 1; sym < table.count; sym++) {
+        uint32_t i = table.hashes[sym] & mask;
+        while (slots[i]) i = (i + 1) & mask;
+        slots[i] = sym;
+    }
+
+    free(table.slots);
+    table.slots = slots;
+    table.slot_mask = mask;
+    return true;
+}
+
+/*
+ * Grow the per-symbol arrays
+ */
+static bool intern_grow_entries(void) {
+    uint32_t capacity = table.capacity ? table.capacity * 2 : 256;
+    const char **names = realloc(table.names, sizeof(char*) * capacity);
+    if (!names) return false;
+    table.names = names;
+    uint32_t *lengths = realloc(table.lengths, sizeof(uint32_t) * capacity);
+    if (!lengths) return false;
+    table.lengths = lengths;
+    uint32_t *hashes = realloc(table.hashes, sizeof(uint32_t) * capacity);
+    if (!hashes) return false;
+    table.hashes = hashes;
+    table.capacity = capacity;
+
+    if (table.count == 0) {
+        table.names[0] = "";
+        table.lengths[0] = 0;
+        table.hashes[0] = 0;
+        table.count = 1;
+    }
+    return true;
+}
+
+/*
+ * Intern a name, returning its symbol (SYM_NONE if out of memory)
+ */
+Symbol intern(const char *s, size_t len) {
+    if (!table.slots && !intern_grow_slots()) return SYM_NONE;
+
+    uint32_t h = intern_hash(s, len);
+    uint32_t i = h & table.slot_mask;
+    for (Symbol sym; (sym = table.slots[i]) != SYM_NONE; i = (i + 1) & table.slot_mask) {
+        if (table.hashes[sym] == h && table.lengths[sym] == len &&
+            memcmp(table.names[sym], s, len) == 0) {
+            return sym;
+        }
+    }
+
+    if (table.count >= table.capacity && !intern_grow_entries()) return SYM_NONE;
+
+    const char *name = intern_store(s, len);
+    if (!name) return SYM_NONE;
+
+    Symbol sym = table.count++;
+    table.names[sym] = name;
+    table.lengths[sym] = (uint32_t)len;
+    table.hashes[sym] = h;
+    table.slots[i] = sym;
+
+    if (table.count * 2 > table.slot_mask + 1) {
+        intern_grow_slots();
+    }
+    return sym;
+}
+
+/*
+ * Intern a NUL-terminated name
+ */
+Symbol intern_cstr(const char *s) {
+    return intern(s, strlen(s));
+}
+
+/*
+ * Text of a symbol ("" for SYM_NONE)
+ */
+const char *symbol_name(Symbol sym) {
+    if (sym == SYM_NONE || sym >= table.count) return "";
+    return table.names[sym];
+}
+
+/*
+ * One past the largest symbol handed out so far
+ */
+uint32_t symbol_count(void) {
+    return table.count ? table.count : 1;
+}
+
+/*
+ * Release the table
+ */
+void intern_free(void) {
+    InternPool *pool = table.pool;
+    while (pool) {
+        InternPool *next = pool->next;
+        free(pool);
+        pool = next;
+    }
+    free(table.names);
+    free(table.lengths);
+    free(table.hashes);
+    free(table.slots);
+    memset(&table, 0, sizeof(table));
+}
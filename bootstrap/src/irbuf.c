@@ -0,0 +1,155 @@
+/*
+ * NERD IR Buffer - Growable output for generated LLVM IR
+ *
+ * Codegen emits millions of short instructions for a big program. Going
+ * through fprintf costs a format parse, locale handling and a stdio lock
+ * per instruction; here the text is appended with memcpy and integers
+ * are formatted by hand. ir_emit understands the few conversions codegen
+ * uses (%d, %zu, %s, %c and %%) and nothing else.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include "nerd.h"
+
+#define IR_INITIAL_CAPACITY (64 * 1024)
+#define IR_FLUSH_SIZE (1024 * 1024)         // Write to the sink past this
+
+/*
+ * Start an empty buffer (allocated on first use)
+ */
+void ir_init(IRBuffer *buf, FILE *sink) {
+    buf->data = NULL;
+    buf->len = 0;
+    buf->capacity = 0;
+    buf->sink = sink;
+    buf->failed = false;
+}
+
+/*
+ * Write the buffered text to the sink, if there is one
+ */
+bool ir_flush(IRBuffer *buf) {
+    if (!buf->sink || buf->len == 0) return !buf->failed;
+    if (!buf->failed && fwrite(buf->data, 1, buf->len, buf->sink) != buf->len) {
+        buf->failed = true;
+    }
+    buf->len = 0;
+    buf->data[0] = '\0';
+    return !buf->failed;
+}
+
+/*
+ * Make room for n more bytes plus the terminator
+ */
+static bool ir_reserve(IRBuffer *buf, size_t n) {
+    if (buf->failed) return false;
+    if (buf->len + n < buf->capacity) return true;
+
+    if (buf->sink && buf->len >= IR_FLUSH_SIZE) {
+        if (!ir_flush(buf)) return false;
+        if (n < buf->capacity) return true;
+    }
+
+    size_t capacity = buf->capacity ? buf->capacity : IR_INITIAL_CAPACITY;
+    while (capacity <= buf->len + n) capacity *= 2;
+    char *grown = realloc(buf->data, capacity);
+    if (!grown) {
+        fprintf(stderr, "Error: Out of memory\n");
+        buf->failed = true;
+        return false;
+    }
+    buf->data = grown;
+    buf->capacity = capacity;
+    return true;
+}
+
+void ir_append(IRBuffer *buf, const char *s, size_t len) {
+    if (!ir_reserve(buf, len)) return;
+    memcpy(buf->data + buf->len, s, len);
+    buf->len += len;
+    buf->data[buf->len] = '\0';
+}
+
+void ir_puts(IRBuffer *buf, const char *s) {
+    ir_append(buf, s, strlen(s));
+}
+
+/*
+ * Append an unsigned integer in decimal
+ */
+static void ir_put_unsigned(IRBuffer *buf, unsigned long long value, bool negative) {
+    char digits[24];
+    char *p = digits + sizeof(digits);
+    do {
+        *--p = (char)('0' + value % 10);
+        value /= 10;
+    } while (value);
+    if (negative) *--p = '-';
+    ir_append(buf, p, (size_t)(digits + sizeof(digits) - p));
+}
+
+/*
+ * Append formatted text: %d, %zu, %s, %c and %% only
+ */
+void ir_emit(IRBuffer *buf, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+
+    const char *run = fmt;
+    for (const char *p = fmt; *p; p++) {
+        if (*p != '%') continue;
+
+        ir_append(buf, run, (size_t)(p - run));
+        p++;
+        switch (*p) {
+            case 'd': {
+                int value = va_arg(args, int);
+                ir_put_unsigned(buf, value < 0 ? 0ull - (unsigned long long)value
+                                               : (unsigned long long)value, value < 0);
+                break;
+            }
+            case 'z':
+                if (p[1] == 'u') p++;
+                ir_put_unsigned(buf, va_arg(args, size_t), false);
+                break;
+            case 's':
+                ir_puts(buf, va_arg(args, const char *));
+                break;
+            case 'c': {
+                char c = (char)va_arg(args, int);
+                ir_append(buf, &c, 1);
+                break;
+            }
+            case '%':
+                ir_append(buf, "%", 1);
+                break;
+            default:
+                fprintf(stderr, "Error: Unsupported IR format '%%%c'\n", *p);
+                buf->failed = true;
+                va_end(args);
+                return;
+        }
+        run = p + 1;
+    }
+    ir_append(buf, run, strlen(run));
+
+    va_end(args);
+}
+
+/*
+ * Take the buffered text (the caller frees it) and leave the buffer empty
+ */
+char *ir_take(IRBuffer *buf, size_t *len) {
+    char *data = buf->data;
+    *len = buf->len;
+    if (!data) data = calloc(1, 1);
+    ir_init(buf, buf->sink);
+    return data;
+}
+
+void ir_free(IRBuffer *buf) {
+    free(buf->data);
+    ir_init(buf, buf->sink);
+}
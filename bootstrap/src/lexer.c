@@ -2,12 +2,23 @@
  * NERD Lexer - Tokenizes English-word syntax
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include <stdio.h>
+#include <stdarg.h>
+#include <pthread.h>
+#include <unistd.h>
 #include "nerd.h"
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 /*
  * Keyword table - maps English words to token types
  */
@@ -114,64 +125,193 @@ static const Keyword keywords[] = {
     {NULL, TOK_EOF}
 };
 
+/*
+ * Keyword index - buckets keyed by (length, first letter)
+ *
+ * Built once from keywords[] so the table stays the single source of truth.
+ * Each bucket chains the handful of keywords sharing a length and initial
+ * letter (at most four today), so a lookup is one table load plus a
+ * memcmp or two instead of a scan over the whole table.
+ */
+#define KEYWORD_MAX_LEN 9      // "resources"
+
+static uint8_t keyword_bucket[KEYWORD_MAX_LEN + 1][26];  // 1-based index, 0 = empty
+static uint8_t keyword_next[sizeof(keywords) / sizeof(keywords[0])];
+static bool keyword_index_ready = false;
+
+static void keyword_index_init(void) {
+    if (keyword_index_ready) return;
+
+    // Insert in reverse so each chain keeps table order
+    size_t n = sizeof(keywords) / sizeof(keywords[0]) - 1;
+    for (size_t i = n; i-- > 0; ) {
+        size_t len = strlen(keywords[i].word);
+        uint8_t first = (uint8_t)(keywords[i].word[0] - 'a');
+        keyword_next[i] = keyword_bucket[len][first];
+        keyword_bucket[len][first] = (uint8_t)(i + 1);
+    }
+    keyword_index_ready = true;
+}
+
+/*
+ * Grow the token arrays to hold at least capacity tokens
+ */
+static bool token_stream_reserve(TokenStream *ts, size_t capacity) {
+    if (capacity <= ts->capacity) return true;
+
+    uint8_t *types = realloc(ts->types, capacity);
+    if (!types) return false;
+    ts->types = types;
+    uint32_t *offsets = realloc(ts->offsets, sizeof(uint32_t) * capacity);
+    if (!offsets) return false;
+    ts->offsets = offsets;
+    uint32_t *lengths = realloc(ts->lengths, sizeof(uint32_t) * capacity);
+    if (!lengths) return false;
+    ts->lengths = lengths;
+    Symbol *syms = realloc(ts->syms, sizeof(Symbol) * capacity);
+    if (!syms) return false;
+    ts->syms = syms;
+
+    ts->capacity = capacity;
+    return true;
+}
+
+/*
+ * Build the line start table (one memchr pass over the source)
+ */
+static bool token_stream_index_lines(TokenStream *ts) {
+    size_t capacity = 64;
+    uint32_t *starts = malloc(sizeof(uint32_t) * capacity);
+    if (!starts) return false;
+
+    size_t count = 0;
+    starts[count++] = 0;
+    const char *p = ts->source;
+    const char *end = ts->source + ts->source_len;
+    while (p < end && (p = memchr(p, '\n', (size_t)(end - p))) != NULL) {
+        p++;
+        if (count >= capacity) {
+            capacity *= 2;
+            uint32_t *grown = realloc(starts, sizeof(uint32_t) * capacity);
+            if (!grown) {
+                free(starts);
+                return false;
+            }
+            starts = grown;
+        }
+        starts[count++] = (uint32_t)(p - ts->source);
+    }
+
+    ts->line_starts = starts;
+    ts->line_count = count;
+    return true;
+}
+
+/*
+ * Find the 1-based line and column of a source offset
+ */
+void token_stream_locate(TokenStream *ts, size_t offset, int *line, int *column) {
+    if (!ts->line_starts && !token_stream_index_lines(ts)) {
+        if (line) *line = 0;
+        if (column) *column = 0;
+        return;
+    }
+
+    // Last line starting at or before offset
+    size_t lo = 0, hi = ts->line_count;
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (ts->line_starts[mid] <= offset) lo = mid;
+        else hi = mid;
+    }
+
+    if (line) *line = (int)lo + 1;
+    if (column) *column = (int)(offset - ts->line_starts[lo]) + 1;
+}
+
 /*
  * Create a new lexer
  */
 Lexer *lexer_create(const char *source, size_t len) {
+    // Token offsets are 32-bit
+    if (len > UINT32_MAX) {
+        fprintf(stderr, "Error: Source file too large (%zu bytes)\n", len);
+        return NULL;
+    }
+
     Lexer *lexer = malloc(sizeof(Lexer));
     if (!lexer) return NULL;
 
+    keyword_index_init();
+
     lexer->source = source;
     lexer->source_len = len;
     lexer->pos = 0;
-    lexer->line = 1;
-    lexer->column = 1;
-
-    lexer->token_capacity = 256;
-    lexer->token_count = 0;
-    lexer->tokens = malloc(sizeof(Token) * lexer->token_capacity);
-    if (!lexer->tokens) {
-        free(lexer);
-        return NULL;
-    }
+    lexer->threads = 0;
+    lexer->chunk = false;
+
+    // Token arrays are sized by lexer_tokenize; lexer_next_token needs one slot
+    memset(&lexer->tokens, 0, sizeof(lexer->tokens));
+    lexer->tokens.source = source;
+    lexer->tokens.source_len = len;
 
     return lexer;
 }
 
 /*
- * Free lexer and all tokens
+ * Free lexer and all tokens (token text lives in the source buffer)
  */
 void lexer_free(Lexer *lexer) {
     if (!lexer) return;
 
-    for (size_t i = 0; i < lexer->token_count; i++) {
-        free(lexer->tokens[i].value);
-    }
-    free(lexer->tokens);
+    free(lexer->tokens.types);
+    free(lexer->tokens.offsets);
+    free(lexer->tokens.lengths);
+    free(lexer->tokens.syms);
+    free(lexer->tokens.line_starts);
     free(lexer);
 }
 
 /*
- * Add a token to the list
+ * Add a token to the stream
  */
-static bool lexer_add_token(Lexer *lexer, TokenType type, const char *value, size_t len) {
-    if (lexer->token_count >= lexer->token_capacity) {
-        lexer->token_capacity *= 2;
-        Token *new_tokens = realloc(lexer->tokens, sizeof(Token) * lexer->token_capacity);
-        if (!new_tokens) return false;
-        lexer->tokens = new_tokens;
+static bool lexer_add_token(Lexer *lexer, TokenType type, size_t start, size_t len) {
+    TokenStream *ts = &lexer->tokens;
+    if (ts->count >= ts->capacity &&
+        !token_stream_reserve(ts, ts->capacity ? ts->capacity * 2 : 64)) {
+        return false;
     }
 
-    Token *tok = &lexer->tokens[lexer->token_count++];
-    tok->type = type;
-    tok->value = nerd_strndup(value, len);
-    tok->value_len = len;
-    tok->line = lexer->line;
-    tok->column = lexer->column - (int)len;
+    size_t i = ts->count++;
+    ts->types[i] = (uint8_t)type;
+    ts->offsets[i] = (uint32_t)start;
+    ts->lengths[i] = (uint32_t)len;
+    ts->syms[i] = SYM_NONE;
 
     return true;
 }
 
+/*
+ * Line number of a source offset, for error messages
+ */
+static int lexer_line(Lexer *lexer, size_t offset) {
+    int line;
+    token_stream_locate(&lexer->tokens, offset, &line, NULL);
+    return line;
+}
+
+/*
+ * Report a lexing error (chunk lexers stay quiet; a failed parallel run is
+ * re-lexed serially so the first error in the file is the one reported)
+ */
+static void lexer_error(Lexer *lexer, const char *fmt, ...) {
+    if (lexer->chunk) return;
+    va_list args;
+    va_start(args, fmt);
+    vfprintf(stderr, fmt, args);
+    va_end(args);
+}
+
 /*
  * Current character
  */
@@ -194,7 +334,6 @@ static char lexer_peek(Lexer *lexer) {
 static void lexer_advance(Lexer *lexer) {
     if (lexer->pos < lexer->source_len) {
         lexer->pos++;
-        lexer->column++;
     }
 }
 
@@ -213,14 +352,133 @@ static bool is_alnum(char c) {
     return is_alpha(c) || is_digit(c);
 }
 
+/*
+ * Run scanners - return the first position in [pos, end) that ends the run
+ *
+ * These cover the long runs the lexer sees: blanks, identifier characters,
+ * string bodies and comment bodies. The vector paths test 32 (AVX2) or 16
+ * (SSE2) bytes per step and only load whole blocks that lie inside the
+ * buffer, so a mapped source without a trailing NUL is safe; the scalar
+ * loop finishes the tail and is the whole implementation elsewhere.
+ */
+#if defined(__AVX2__)
+#define SCAN_BLOCK 32
+typedef __m256i scan_vec;
+#define scan_load(p)        _mm256_loadu_si256((const __m256i *)(p))
+#define scan_splat(c)       _mm256_set1_epi8((char)(c))
+#define scan_eq(a, b)       _mm256_cmpeq_epi8((a), (b))
+#define scan_gt(a, b)       _mm256_cmpgt_epi8((a), (b))
+#define scan_or(a, b)       _mm256_or_si256((a), (b))
+#define scan_add(a, b)      _mm256_add_epi8((a), (b))
+#define scan_mask(v)        ((uint32_t)_mm256_movemask_epi8(v))
+#define scan_all            0xFFFFFFFFu
+#elif defined(__SSE2__)
+#define SCAN_BLOCK 16
+typedef __m128i scan_vec;
+#define scan_load(p)        _mm_loadu_si128((const __m128i *)(p))
+#define scan_splat(c)       _mm_set1_epi8((char)(c))
+#define scan_eq(a, b)       _mm_cmpeq_epi8((a), (b))
+#define scan_gt(a, b)       _mm_cmpgt_epi8((a), (b))
+#define scan_or(a, b)       _mm_or_si128((a), (b))
+#define scan_add(a, b)      _mm_add_epi8((a), (b))
+#define scan_mask(v)        ((uint32_t)_mm_movemask_epi8(v))
+#define scan_all            0xFFFFu
+#endif
+
+/*
+ * Skip spaces, tabs and carriage returns
+ */
+static size_t scan_blanks(const char *src, size_t pos, size_t end) {
+#ifdef SCAN_BLOCK
+    const scan_vec space = scan_splat(' ');
+    const scan_vec tab = scan_splat('\t');
+    const scan_vec cr = scan_splat('\r');
+    while (pos + SCAN_BLOCK <= end) {
+        scan_vec v = scan_load(src + pos);
+        uint32_t blank = scan_mask(scan_or(scan_or(scan_eq(v, space), scan_eq(v, tab)),
+                                           scan_eq(v, cr)));
+        if (blank != scan_all) return pos + (size_t)__builtin_ctz(~blank);
+        pos += SCAN_BLOCK;
+    }
+#endif
+    while (pos < end && (src[pos] == ' ' || src[pos] == '\t' || src[pos] == '\r')) pos++;
+    return pos;
+}
+
+/*
+ * Skip identifier characters [A-Za-z0-9_]
+ */
+static size_t scan_ident(const char *src, size_t pos, size_t end) {
+#ifdef SCAN_BLOCK
+    // Signed compares only: bias each range so it starts at -128, then one
+    // compare tests "below -128 + width". OR-ing 0x20 folds upper case.
+    const scan_vec fold = scan_splat(0x20);
+    const scan_vec alpha_bias = scan_splat(128 - 'a');
+    const scan_vec alpha_limit = scan_splat(-128 + 26);
+    const scan_vec digit_bias = scan_splat(128 - '0');
+    const scan_vec digit_limit = scan_splat(-128 + 10);
+    const scan_vec underscore = scan_splat('_');
+    while (pos + SCAN_BLOCK <= end) {
+        scan_vec v = scan_load(src + pos);
+        scan_vec alpha = scan_gt(alpha_limit, scan_add(scan_or(v, fold), alpha_bias));
+        scan_vec digit = scan_gt(digit_limit, scan_add(v, digit_bias));
+        uint32_t ident = scan_mask(scan_or(scan_or(alpha, digit), scan_eq(v, underscore)));
+        if (ident != scan_all) return pos + (size_t)__builtin_ctz(~ident);
+        pos += SCAN_BLOCK;
+    }
+#endif
+    while (pos < end && is_alnum(src[pos])) pos++;
+    return pos;
+}
+
+/*
+ * Find the next byte that matters inside a string literal: '"', '\\',
+ * '\n' or NUL
+ */
+static size_t scan_string_body(const char *src, size_t pos, size_t end) {
+#ifdef SCAN_BLOCK
+    const scan_vec quote = scan_splat('"');
+    const scan_vec backslash = scan_splat('\\');
+    const scan_vec newline = scan_splat('\n');
+    const scan_vec nul = scan_splat(0);
+    while (pos + SCAN_BLOCK <= end) {
+        scan_vec v = scan_load(src + pos);
+        uint32_t hit = scan_mask(scan_or(scan_or(scan_eq(v, quote), scan_eq(v, backslash)),
+                                         scan_or(scan_eq(v, newline), scan_eq(v, nul))));
+        if (hit) return pos + (size_t)__builtin_ctz(hit);
+        pos += SCAN_BLOCK;
+    }
+#endif
+    while (pos < end) {
+        char c = src[pos];
+        if (c == '"' || c == '\\' || c == '\n' || c == '\0') break;
+        pos++;
+    }
+    return pos;
+}
+
+/*
+ * Find the end of a comment (the newline is left for the main loop)
+ */
+static size_t scan_line_end(const char *src, size_t pos, size_t end) {
+    // libc memchr is already vectorized for a single-byte search
+    const char *nl = memchr(src + pos, '\n', end - pos);
+    return nl ? (size_t)(nl - src) : end;
+}
+
 /*
  * Look up a word in the keyword table
  */
 static TokenType lookup_keyword(const char *word, size_t len) {
-    for (int i = 0; keywords[i].word != NULL; i++) {
-        if (strlen(keywords[i].word) == len &&
-            strncmp(keywords[i].word, word, len) == 0) {
-            return keywords[i].type;
+    if (len > KEYWORD_MAX_LEN) return TOK_IDENT;
+    unsigned first = (unsigned char)word[0] - 'a';
+    if (first >= 26) return TOK_IDENT;
+
+    for (uint8_t i = keyword_bucket[len][first]; i != 0; i = keyword_next[i - 1]) {
+        // Same bucket means same length and first letter; compare the rest
+        const Keyword *kw = &keywords[i - 1];
+        if (memcmp(kw->word + 1, word + 1, len - 1) == 0) {
+            return kw->type;
         }
     }
     return TOK_IDENT;
@@ -231,16 +489,20 @@ static TokenType lookup_keyword(const char *word, size_t len) {
  */
 static bool lexer_scan_word(Lexer *lexer) {
     size_t start = lexer->pos;
-
-    while (is_alnum(lexer_current(lexer))) {
-        lexer_advance(lexer);
-    }
+    lexer->pos = scan_ident(lexer->source, start + 1, lexer->source_len);
 
     size_t len = lexer->pos - start;
-    const char *word = lexer->source + start;
-
-    TokenType type = lookup_keyword(word, len);
-    return lexer_add_token(lexer, type, word, len);
+    TokenType type = lookup_keyword(lexer->source + start, len);
+    if (!lexer_add_token(lexer, type, start, len)) return false;
+
+    // Identifiers get their symbol here so later phases never compare text.
+    // The intern table is not thread-safe, so chunks intern after the join.
+    if (type == TOK_IDENT && !lexer->chunk) {
+        Symbol sym = intern(lexer->source + start, len);
+        if (sym == SYM_NONE) return false;
+        lexer->tokens.syms[lexer->tokens.count - 1] = sym;
+    }
+    return true;
 }
 
 /*
@@ -262,7 +524,7 @@ static bool lexer_scan_number(Lexer *lexer) {
     }
 
     size_t len = lexer->pos - start;
-    return lexer_add_token(lexer, TOK_NUMBER, lexer->source + start, len);
+    return lexer_add_token(lexer, TOK_NUMBER, start, len);
 }
 
 /*
@@ -272,55 +534,55 @@ static bool lexer_scan_string(Lexer *lexer) {
     lexer_advance(lexer);  // Skip opening "
     size_t start = lexer->pos;
 
-    while (lexer_current(lexer) != '"' && lexer_current(lexer) != '\0') {
-        if (lexer_current(lexer) == '\n') {
-            fprintf(stderr, "Error: Unterminated string at line %d\n", lexer->line);
+    for (;;) {
+        lexer->pos = scan_string_body(lexer->source, lexer->pos, lexer->source_len);
+        char c = lexer_current(lexer);
+        if (c == '"' || c == '\0') break;
+        if (c == '\n') {
+            lexer_error(lexer, "Error: Unterminated string at line %d\n", lexer_line(lexer, lexer->pos));
             return false;
         }
-        if (lexer_current(lexer) == '\\' && lexer_peek(lexer) == '"') {
-            lexer_advance(lexer);  // Skip escape
+        // Backslash: an escaped quote does not end the string
+        if (lexer_peek(lexer) == '"') {
+            lexer_advance(lexer);
         }
         lexer_advance(lexer);
     }
 
     if (lexer_current(lexer) == '\0') {
-        fprintf(stderr, "Error: Unterminated string at line %d\n", lexer->line);
+        lexer_error(lexer, "Error: Unterminated string at line %d\n", lexer_line(lexer, lexer->pos));
         return false;
     }
 
     size_t len = lexer->pos - start;
-    bool ok = lexer_add_token(lexer, TOK_STRING, lexer->source + start, len);
+    bool ok = lexer_add_token(lexer, TOK_STRING, start, len);
     lexer_advance(lexer);  // Skip closing "
     return ok;
 }
 
 /*
- * Tokenize the source
+ * Scan tokens from pos until source_len, or until the stream holds limit
  */
-bool lexer_tokenize(Lexer *lexer) {
-    while (lexer->pos < lexer->source_len) {
+static bool lexer_scan_until(Lexer *lexer, size_t limit) {
+    while (lexer->pos < lexer->source_len && lexer->tokens.count < limit) {
         char c = lexer_current(lexer);
 
         // Skip whitespace (except newlines)
         if (c == ' ' || c == '\t' || c == '\r') {
-            lexer_advance(lexer);
+            lexer->pos = scan_blanks(lexer->source, lexer->pos + 1, lexer->source_len);
             continue;
         }
 
         // Newlines
         if (c == '\n') {
-            lexer_add_token(lexer, TOK_NEWLINE, "\\n", 2);
+            lexer_add_token(lexer, TOK_NEWLINE, lexer->pos, 1);
             lexer_advance(lexer);
-            lexer->line++;
-            lexer->column = 1;
             continue;
         }
 
         // Comments: -- or #
         if ((c == '-' && lexer_peek(lexer) == '-') || c == '#') {
-            while (lexer_current(lexer) != '\n' && lexer_current(lexer) != '\0') {
-                lexer_advance(lexer);
-            }
+            lexer->pos = scan_line_end(lexer->source, lexer->pos, lexer->source_len);
             continue;
         }
 
@@ -344,39 +606,320 @@ bool lexer_tokenize(Lexer *lexer) {
 
         // Single-character tokens for JSON operations
         if (c == '{') {
-            lexer_add_token(lexer, TOK_LBRACE, "{", 1);
+            lexer_add_token(lexer, TOK_LBRACE, lexer->pos, 1);
             lexer_advance(lexer);
             continue;
         }
         if (c == '}') {
-            lexer_add_token(lexer, TOK_RBRACE, "}", 1);
+            lexer_add_token(lexer, TOK_RBRACE, lexer->pos, 1);
             lexer_advance(lexer);
             continue;
         }
         if (c == '.') {
-            lexer_add_token(lexer, TOK_DOT, ".", 1);
+            lexer_add_token(lexer, TOK_DOT, lexer->pos, 1);
             lexer_advance(lexer);
             continue;
         }
         if (c == '?') {
-            lexer_add_token(lexer, TOK_QUESTION, "?", 1);
+            lexer_add_token(lexer, TOK_QUESTION, lexer->pos, 1);
             lexer_advance(lexer);
             continue;
         }
         if (c == '=') {
-            lexer_add_token(lexer, TOK_ASSIGN, "=", 1);
+            lexer_add_token(lexer, TOK_ASSIGN, lexer->pos, 1);
             lexer_advance(lexer);
             continue;
         }
 
         // Unknown character
-        fprintf(stderr, "Error: Unexpected character '%c' at line %d, column %d\n",
-                c, lexer->line, lexer->column);
+        if (!lexer->chunk) {
+            int line, column;
+            token_stream_locate(&lexer->tokens, lexer->pos, &line, &column);
+            lexer_error(lexer, "Error: Unexpected character '%c' at line %d, column %d\n",
+                        c, line, column);
+        }
         return false;
     }
 
+    return true;
+}
+
+static bool lexer_scan(Lexer *lexer) {
+    return lexer_scan_until(lexer, SIZE_MAX);
+}
+
+/*
+ * Parallel lexing
+ *
+ * No token spans a newline (strings stop at one, comments end at one), so
+ * the source splits cleanly just after a '\n'. Each chunk is lexed by its
+ * own Lexer that reads the shared buffer with source_len set to the chunk
+ * end, so token offsets come out global and the streams are concatenated
+ * as-is. Lines need no fix-up: they are derived from offsets on demand.
+ */
+#define LEXER_CHUNK_MIN (1u << 20)     // Smallest input share worth a thread
+#define LEXER_MAX_THREADS 64
+
+typedef struct {
+    Lexer lexer;
+    pthread_t thread;
+    bool spawned;
+    bool ok;
+} LexChunk;
+
+static void *lexer_chunk_worker(void *arg) {
+    LexChunk *chunk = arg;
+    chunk->ok = lexer_scan(&chunk->lexer);
+    return NULL;
+}
+
+/*
+ * Number of threads to lex with (1 means serial)
+ */
+static int lexer_thread_count(Lexer *lexer) {
+    int threads = lexer->threads;
+    if (threads <= 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        size_t by_size = (lexer->source_len - lexer->pos) / LEXER_CHUNK_MIN;
+        threads = cores < 1 ? 1 : (int)cores;
+        if ((size_t)threads > by_size) threads = (int)by_size;
+    }
+    if (threads > LEXER_MAX_THREADS) threads = LEXER_MAX_THREADS;
+    return threads < 1 ? 1 : threads;
+}
+
+static bool lexer_scan_parallel(Lexer *lexer, int threads) {
+    LexChunk *chunks = calloc((size_t)threads, sizeof(LexChunk));
+    if (!chunks) return lexer_scan(lexer);
+
+    // Split into roughly equal shares, each ending just after a newline
+    int count = 0;
+    size_t start = lexer->pos;
+    while (start < lexer->source_len && count < threads) {
+        size_t end = lexer->source_len;
+        if (count < threads - 1) {
+            size_t target = start + (lexer->source_len - start) / (size_t)(threads - count);
+            const char *nl = memchr(lexer->source + target, '\n', lexer->source_len - target);
+            if (nl) end = (size_t)(nl - lexer->source) + 1;
+        }
+
+        Lexer *chunk = &chunks[count].lexer;
+        chunk->source = lexer->source;
+        chunk->source_len = end;
+        chunk->pos = start;
+        chunk->chunk = true;
+        chunk->tokens.source = lexer->source;
+        chunk->tokens.source_len = lexer->source_len;
+        count++;
+        if (!token_stream_reserve(&chunk->tokens, (end - start) / 4 + 64)) goto fail;
+        start = end;
+    }
+
+    // The calling thread takes the first chunk
+    for (int i = 1; i < count; i++) {
+        chunks[i].spawned = pthread_create(&chunks[i].thread, NULL,
+                                           lexer_chunk_worker, &chunks[i]) == 0;
+    }
+    lexer_chunk_worker(&chunks[0]);
+    for (int i = 1; i < count; i++) {
+        if (chunks[i].spawned) pthread_join(chunks[i].thread, NULL);
+        else lexer_chunk_worker(&chunks[i]);
+    }
+
+    size_t total = lexer->tokens.count;
+    for (int i = 0; i < count; i++) {
+        if (!chunks[i].ok) goto fail;
+        total += chunks[i].lexer.tokens.count;
+    }
+    if (!token_stream_reserve(&lexer->tokens, total + 1)) goto fail;
+
+    // Stitch the chunk streams together
+    TokenStream *ts = &lexer->tokens;
+    for (int i = 0; i < count; i++) {
+        TokenStream *part = &chunks[i].lexer.tokens;
+        memcpy(ts->types + ts->count, part->types, part->count);
+        memcpy(ts->offsets + ts->count, part->offsets, sizeof(uint32_t) * part->count);
+        memcpy(ts->lengths + ts->count, part->lengths, sizeof(uint32_t) * part->count);
+        memcpy(ts->syms + ts->count, part->syms, sizeof(Symbol) * part->count);
+        ts->count += part->count;
+        free(part->types);
+        free(part->offsets);
+        free(part->lengths);
+        free(part->syms);
+        free(part->line_starts);
+    }
+    free(chunks);
+    lexer->pos = lexer->source_len;
+
+    // Intern in source order so symbol IDs match a serial run
+    for (size_t i = 0; i < ts->count; i++) {
+        if (ts->types[i] != TOK_IDENT) continue;
+        ts->syms[i] = intern(lexer->source + ts->offsets[i], ts->lengths[i]);
+        if (ts->syms[i] == SYM_NONE) return false;
+    }
+    return true;
+
+fail:
+    for (int i = 0; i < count; i++) {
+        TokenStream *part = &chunks[i].lexer.tokens;
+        free(part->types);
+        free(part->offsets);
+        free(part->lengths);
+        free(part->syms);
+        free(part->line_starts);
+    }
+    free(chunks);
+    // Lex again on this thread so the error is reported as usual
+    return lexer_scan(lexer);
+}
+
+/*
+ * Tokenize the source
+ */
+bool lexer_tokenize(Lexer *lexer) {
+    // Size for about one token per four bytes, so typical sources never
+    // reallocate; the stream still grows if a file is denser than that
+    if (!token_stream_reserve(&lexer->tokens, (lexer->source_len - lexer->pos) / 4 + 64)) {
+        return false;
+    }
+
+    int threads = lexer_thread_count(lexer);
+    bool ok = threads > 1 ? lexer_scan_parallel(lexer, threads) : lexer_scan(lexer);
+    if (!ok) return false;
+
     // Add EOF token
-    lexer_add_token(lexer, TOK_EOF, "", 0);
+    lexer_add_token(lexer, TOK_EOF, lexer->pos, 0);
+    return true;
+}
+
+/*
+ * Pull the next token (streaming mode)
+ *
+ * The token stream is reused as a one-token scratch buffer, so memory stays
+ * constant however long the source is. Returns TOK_EOF at the end, and keeps
+ * returning it; false means a lexing error has been reported.
+ */
+bool lexer_next_token(Lexer *lexer, Token *tok) {
+    TokenStream *ts = &lexer->tokens;
+    ts->count = 0;
+    if (!lexer_scan_until(lexer, 1)) return false;
+    if (ts->count == 0 && !lexer_add_token(lexer, TOK_EOF, lexer->pos, 0)) return false;
+
+    tok->type = (TokenType)ts->types[0];
+    tok->offset = ts->offsets[0];
+    tok->length = ts->lengths[0];
+    tok->sym = ts->syms[0];
+    return true;
+}
+
+/*
+ * First token whose offset is at or after offset
+ */
+static size_t token_stream_lower_bound(TokenStream *ts, size_t offset) {
+    size_t lo = 0, hi = ts->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (ts->offsets[mid] < offset) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+/*
+ * Relex after an edit
+ *
+ * The bytes [start, old_end) of the previously tokenized source were
+ * replaced, giving source[start, new_end) of the new buffer. No token spans
+ * a newline, so only the whole lines around the edit are lexed again; tokens
+ * before them are kept as they are and tokens after them are kept with
+ * their offsets shifted. The lexer must hold a batch-tokenized stream; on
+ * a lexing error it is left untouched, still describing the old source.
+ */
+bool lexer_relex(Lexer *lexer, const char *source, size_t len,
+                 size_t start, size_t old_end, size_t new_end) {
+    if (len > UINT32_MAX) {
+        fprintf(stderr, "Error: Source file too large (%zu bytes)\n", len);
+        return false;
+    }
+    TokenStream *ts = &lexer->tokens;
+    size_t old_len = lexer->source_len;
+    if (start > old_end || old_end > old_len || start > new_end || new_end > len ||
+        len - new_end != old_len - old_end || ts->count == 0) {
+        fprintf(stderr, "Error: Invalid edit range\n");
+        return false;
+    }
+
+    // Lines touched by the edit, found in the new buffer: everything before
+    // start and after new_end is unchanged text
+    size_t line_begin = start;
+    while (line_begin > 0 && source[line_begin - 1] != '\n') line_begin--;
+    const char *nl = memchr(source + new_end, '\n', len - new_end);
+    size_t relex_end = nl ? (size_t)(nl - source) + 1 : len;
+    size_t old_relex_end = relex_end - new_end + old_end;
+
+    // Lex just those lines
+    Lexer part = {0};
+    part.source = source;
+    part.source_len = relex_end;
+    part.pos = line_begin;
+    part.tokens.source = source;
+    part.tokens.source_len = len;
+    bool ok = lexer_scan(&part);
+    free(part.tokens.line_starts);
+    if (!ok) {
+        free(part.tokens.types);
+        free(part.tokens.offsets);
+        free(part.tokens.lengths);
+        free(part.tokens.syms);
+        return false;
+    }
+
+    // Old tokens [first, last) are replaced; the EOF token is always kept
+    size_t first = token_stream_lower_bound(ts, line_begin);
+    size_t last = token_stream_lower_bound(ts, old_relex_end);
+    if (last == ts->count) last--;
+    size_t added = part.tokens.count;
+    size_t tail = ts->count - last;
+    if (!token_stream_reserve(ts, first + added + tail)) {
+        ok = false;
+    } else {
+        // Move the tail into place, then shift its offsets by the edit delta
+        size_t to = first + added;
+        if (to != last) {
+            memmove(ts->types + to, ts->types + last, tail);
+            memmove(ts->offsets + to, ts->offsets + last, sizeof(uint32_t) * tail);
+            memmove(ts->lengths + to, ts->lengths + last, sizeof(uint32_t) * tail);
+            memmove(ts->syms + to, ts->syms + last, sizeof(Symbol) * tail);
+        }
+        if (len != old_len) {
+            uint32_t delta = (uint32_t)len - (uint32_t)old_len;    // wraps when shrinking
+            for (size_t i = to; i < to + tail; i++) ts->offsets[i] += delta;
+        }
+
+        if (added > 0) {
+            memcpy(ts->types + first, part.tokens.types, added);
+            memcpy(ts->offsets + first, part.tokens.offsets, sizeof(uint32_t) * added);
+            memcpy(ts->lengths + first, part.tokens.lengths, sizeof(uint32_t) * added);
+            memcpy(ts->syms + first, part.tokens.syms, sizeof(Symbol) * added);
+        }
+        ts->count = to + tail;
+    }
+    free(part.tokens.types);
+    free(part.tokens.offsets);
+    free(part.tokens.lengths);
+    free(part.tokens.syms);
+    if (!ok) return false;
+
+    lexer->source = source;
+    lexer->source_len = len;
+    lexer->pos = len;
+    ts->source = source;
+    ts->source_len = len;
+
+    // Line starts moved; rebuild them on the next lookup
+    free(ts->line_starts);
+    ts->line_starts = NULL;
+    ts->line_count = 0;
     return true;
 }
 
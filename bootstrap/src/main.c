@@ -5,50 +5,23 @@
  *   nerd compile <file.nerd> [-o output]    Compile to LLVM IR / native
  *   nerd run <file.nerd> [args...]          Compile and run
  *   nerd parse <file.nerd>                  Parse and dump AST
+ *   nerd watch <file.nerd> [-o output]      Recompile on every change
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <time.h>
 #include <unistd.h>
+#include <sys/stat.h>
 #ifdef __APPLE__
 #include <mach-o/dyld.h>
+#define st_mtim st_mtimespec
 #endif
 #include "nerd.h"
 
-/*
- * Read entire file into memory
- */
-static char *read_file(const char *path, size_t *len) {
-    FILE *f = fopen(path, "rb");
-    if (!f) {
-        fprintf(stderr, "Error: Cannot open file '%s'\n", path);
-        return NULL;
-    }
-
-    fseek(f, 0, SEEK_END);
-    *len = ftell(f);
-    fseek(f, 0, SEEK_SET);
-
-    char *buf = malloc(*len + 1);
-    if (!buf) {
-        fclose(f);
-        return NULL;
-    }
-
-    size_t read = fread(buf, 1, *len, f);
-    if (read != *len) {
-        fprintf(stderr, "Error: Failed to read file '%s'\n", path);
-        free(buf);
-        fclose(f);
-        return NULL;
-    }
-    buf[*len] = '\0';
-    fclose(f);
-
-    return buf;
-}
-
 /*
  * Print token for debugging
  */
@@ -147,143 +120,209 @@ static const char *token_name(TokenType type) {
 /*
  * Print AST node for debugging
  */
-static void print_ast(ASTNode *node, int indent) {
-    if (!node) return;
-
+static void print_indent(int indent) {
     for (int i = 0; i < indent; i++) printf("  ");
+}
+
+static void print_ast(const CompactAST *ast, NodeRef node, int indent) {
+    if (node == NODE_NONE) return;
+
+    const NodeRef *list;
+    uint32_t count;
 
-    switch (node->type) {
+    print_indent(indent);
+
+    switch (compact_kind(ast, node)) {
         case NODE_PROGRAM:
             printf("Program\n");
-            for (size_t i = 0; i < node->data.program.types.count; i++) {
-                print_ast(node->data.program.types.nodes[i], indent + 1);
+            list = compact_list(ast, node, 0, &count);
+            for (uint32_t i = 0; i < count; i++) {
+                print_ast(ast, list[i], indent + 1);
             }
-            for (size_t i = 0; i < node->data.program.functions.count; i++) {
-                print_ast(node->data.program.functions.nodes[i], indent + 1);
+            list = compact_list(ast, node, 1, &count);
+            for (uint32_t i = 0; i < count; i++) {
+                print_ast(ast, list[i], indent + 1);
             }
             break;
 
         case NODE_FUNC_DEF:
-            printf("Function: %s (", node->data.func_def.name);
-            for (size_t i = 0; i < node->data.func_def.params.count; i++) {
+            printf("Function: %s (", symbol_name(compact_name(ast, node)));
+            list = compact_list(ast, node, 0, &count);
+            for (uint32_t i = 0; i < count; i++) {
                 if (i > 0) printf(", ");
-                printf("%s", node->data.func_def.params.nodes[i]->data.param.name);
+                printf("%s", symbol_name(compact_name(ast, list[i])));
             }
             printf(")\n");
-            for (size_t i = 0; i < node->data.func_def.body.count; i++) {
-                print_ast(node->data.func_def.body.nodes[i], indent + 1);
+            list = compact_list(ast, node, 1, &count);
+            for (uint32_t i = 0; i < count; i++) {
+                print_ast(ast, list[i], indent + 1);
             }
             break;
 
         case NODE_TYPE_DEF:
-            printf("Type: %s (%s)\n", node->data.type_def.name,
-                   node->data.type_def.is_union ? "union" : "struct");
+            printf("Type: %s (%s)\n", symbol_name(compact_name(ast, node)),
+                   compact_value(ast, node) ? "union" : "struct");
             break;
 
         case NODE_RETURN:
             printf("Return");
-            if (node->data.ret.variant == 1) printf(" ok");
-            else if (node->data.ret.variant == 2) printf(" err");
+            if (compact_value(ast, node) == 1) printf(" ok");
+            else if (compact_value(ast, node) == 2) printf(" err");
             printf("\n");
-            print_ast(node->data.ret.value, indent + 1);
+            print_ast(ast, compact_child(ast, node, 0), indent + 1);
             break;
 
         case NODE_IF:
             printf("If\n");
-            for (int i = 0; i < indent + 1; i++) printf("  ");
+            print_indent(indent + 1);
             printf("Condition:\n");
-            print_ast(node->data.if_stmt.condition, indent + 2);
-            for (int i = 0; i < indent + 1; i++) printf("  ");
+            print_ast(ast, compact_child(ast, node, 0), indent + 2);
+            print_indent(indent + 1);
             printf("Then:\n");
-            print_ast(node->data.if_stmt.then_stmt, indent + 2);
+            print_ast(ast, compact_child(ast, node, 1), indent + 2);
             break;
 
         case NODE_LET:
-            printf("Let: %s\n", node->data.let.name);
-            print_ast(node->data.let.value, indent + 1);
+            printf("Let: %s\n", symbol_name(compact_name(ast, node)));
+            print_ast(ast, compact_child(ast, node, 0), indent + 1);
             break;
 
         case NODE_EXPR_STMT:
             printf("ExprStmt\n");
-            print_ast(node->data.expr_stmt.expr, indent + 1);
+            print_ast(ast, compact_child(ast, node, 0), indent + 1);
             break;
 
         case NODE_OUT:
             printf("Out\n");
-            print_ast(node->data.out.value, indent + 1);
+            print_ast(ast, compact_child(ast, node, 0), indent + 1);
             break;
 
-        case NODE_REPEAT:
-            printf("Repeat %s\n", node->data.repeat.var_name ? node->data.repeat.var_name : "(no var)");
-            for (int i = 0; i < indent + 1; i++) printf("  ");
+        case NODE_REPEAT: {
+            Symbol var = compact_name(ast, node);
+            printf("Repeat %s\n", var ? symbol_name(var) : "(no var)");
+            print_indent(indent + 1);
             printf("Count:\n");
-            print_ast(node->data.repeat.count, indent + 2);
-            for (int i = 0; i < indent + 1; i++) printf("  ");
+            print_ast(ast, compact_child(ast, node, 0), indent + 2);
+            print_indent(indent + 1);
             printf("Body:\n");
-            for (size_t i = 0; i < node->data.repeat.body.count; i++) {
-                print_ast(node->data.repeat.body.nodes[i], indent + 2);
+            list = compact_list(ast, node, 0, &count);
+            for (uint32_t i = 0; i < count; i++) {
+                print_ast(ast, list[i], indent + 2);
             }
             break;
+        }
 
         case NODE_WHILE:
             printf("While\n");
-            for (int i = 0; i < indent + 1; i++) printf("  ");
+            print_indent(indent + 1);
             printf("Condition:\n");
-            print_ast(node->data.while_loop.condition, indent + 2);
-            for (int i = 0; i < indent + 1; i++) printf("  ");
+            print_ast(ast, compact_child(ast, node, 0), indent + 2);
+            print_indent(indent + 1);
             printf("Body:\n");
-            for (size_t i = 0; i < node->data.while_loop.body.count; i++) {
-                print_ast(node->data.while_loop.body.nodes[i], indent + 2);
+            list = compact_list(ast, node, 0, &count);
+            for (uint32_t i = 0; i < count; i++) {
+                print_ast(ast, list[i], indent + 2);
             }
             break;
 
         case NODE_BINOP:
-            printf("BinOp: %s\n", node->data.binop.op);
-            print_ast(node->data.binop.left, indent + 1);
-            print_ast(node->data.binop.right, indent + 1);
+            printf("BinOp: %s\n", op_name((OpCode)compact_value(ast, node)));
+            print_ast(ast, compact_child(ast, node, 0), indent + 1);
+            print_ast(ast, compact_child(ast, node, 1), indent + 1);
             break;
 
         case NODE_UNARYOP:
-            printf("UnaryOp: %s\n", node->data.unaryop.op);
-            print_ast(node->data.unaryop.operand, indent + 1);
+            printf("UnaryOp: %s\n", op_name((OpCode)compact_value(ast, node)));
+            print_ast(ast, compact_child(ast, node, 0), indent + 1);
             break;
 
-        case NODE_CALL:
-            printf("Call: %s.%s\n",
-                   node->data.call.module ? node->data.call.module : "",
-                   node->data.call.func);
-            for (size_t i = 0; i < node->data.call.args.count; i++) {
-                print_ast(node->data.call.args.nodes[i], indent + 1);
+        case NODE_CALL: {
+            const char *module = compact_str(ast, node, 0);
+            printf("Call: %s.%s\n", module ? module : "", compact_str(ast, node, 1));
+            list = compact_list(ast, node, 0, &count);
+            for (uint32_t i = 0; i < count; i++) {
+                print_ast(ast, list[i], indent + 1);
             }
             break;
+        }
 
         case NODE_NUM:
-            printf("Num: %g\n", node->data.num.value);
+            printf("Num: %g\n", compact_num(ast, node));
             break;
 
         case NODE_STR:
-            printf("Str: \"%s\"\n", node->data.str.value);
+            printf("Str: \"%s\"\n", compact_str(ast, node, 0));
             break;
 
         case NODE_BOOL:
-            printf("Bool: %s\n", node->data.boolean.value ? "true" : "false");
+            printf("Bool: %s\n", compact_value(ast, node) ? "true" : "false");
             break;
 
         case NODE_VAR:
-            printf("Var: %s\n", node->data.var.name);
+            printf("Var: %s\n", symbol_name(compact_name(ast, node)));
             break;
 
         case NODE_POSITIONAL:
-            printf("Positional: %d\n", node->data.positional.index);
+            printf("Positional: %d\n", (int)compact_value(ast, node));
             break;
 
         default:
-            printf("Unknown node type %d\n", node->type);
+            printf("Unknown node type %d\n", compact_kind(ast, node));
             break;
     }
 }
 
-#define NERD_VERSION "3.0.0"
+/*
+ * Lex and parse a source
+ *
+ * Small sources are lexed and parsed in one pass (the parser pulls tokens
+ * as it needs them); large ones are lexed first and parsed on several
+ * threads. *modules gets the MODULE_BIT set of library modules called.
+ */
+static ASTNode *parse_source(const char *source, size_t source_len, uint32_t *modules) {
+    Lexer *lexer = lexer_create(source, source_len);
+    if (!lexer) return NULL;
+
+    Parser *parser = parser_create_auto(lexer);
+    if (!parser) {
+        lexer_free(lexer);
+        return NULL;
+    }
+
+    ASTNode *ast = parser_parse(parser);
+    *modules = parser->modules;
+
+    // The tree owns its own arena and copies of every string it keeps
+    parser_free(parser);
+    lexer_free(lexer);
+    return ast;
+}
+
+/*
+ * Tree for a source: from the AST cache if the source is unchanged since
+ * it was last compiled, else parsed and then cached
+ */
+static ASTNode *load_program(const char *source, size_t source_len, bool use_cache,
+                             uint32_t *modules) {
+    if (use_cache) {
+        CompactAST *cached = ast_cache_load(source, source_len, modules);
+        if (cached) {
+            ASTNode *ast = compact_to_ast(cached);
+            compact_free(cached);
+            if (ast) return ast;
+        }
+    }
+
+    ASTNode *ast = parse_source(source, source_len, modules);
+    if (ast && use_cache) {
+        CompactAST *compact = compact_from_ast(ast);
+        if (compact) {
+            ast_cache_store(source, source_len, compact, *modules);
+            compact_free(compact);
+        }
+    }
+    return ast;
+}
 
 /*
  * Print version
@@ -303,9 +342,16 @@ static void print_usage(void) {
     printf("  nerd compile <file.nerd> [-o output.ll]   Compile to LLVM IR\n");
     printf("  nerd parse <file.nerd>                    Parse and dump AST\n");
     printf("  nerd tokens <file.nerd>                   Show tokens\n");
+    printf("  nerd watch <file.nerd> [-o output.ll]     Recompile on every change\n");
     printf("  nerd --version                            Show version\n");
     printf("  nerd --help                               Show this help\n");
     printf("\n");
+    printf("Use - as the file name to read source from stdin.\n");
+    printf("compile and run reuse the parsed tree of an unchanged source from\n");
+    printf("$NERD_CACHE_DIR (default ~/.cache/nerd); pass --no-cache to skip it.\n");
+    printf("watch keeps the last build in memory and only reparses and regenerates\n");
+    printf("the functions that changed.\n");
+    printf("\n");
     printf("Examples:\n");
     printf("  nerd run math.nerd\n");
     printf("  nerd compile math.nerd -o math.ll\n");
@@ -317,11 +363,14 @@ static void print_usage(void) {
 static int cmd_compile(int argc, char **argv) {
     const char *input_file = NULL;
     const char *output_file = NULL;
+    bool use_cache = true;
 
     for (int i = 0; i < argc; i++) {
         if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
             output_file = argv[++i];
-        } else if (argv[i][0] != '-') {
+        } else if (strcmp(argv[i], "--no-cache") == 0) {
+            use_cache = false;
+        } else if (argv[i][0] != '-' || argv[i][1] == '\0') {
             input_file = argv[i];
         }
     }
@@ -334,38 +383,32 @@ static int cmd_compile(int argc, char **argv) {
     // Default output file
     char default_output[256];
     if (!output_file) {
-        snprintf(default_output, sizeof(default_output), "%s", input_file);
+        snprintf(default_output, sizeof(default_output), "%s",
+                 strcmp(input_file, "-") == 0 ? "out" : input_file);
         char *dot = strrchr(default_output, '.');
         if (dot) *dot = '\0';
         strcat(default_output, ".ll");
         output_file = default_output;
     }
 
-    // Read source
-    size_t source_len;
-    char *source = read_file(input_file, &source_len);
-    if (!source) return 1;
-
-    // Lex
-    Lexer *lexer = lexer_create(source, source_len);
-    if (!lexer || !lexer_tokenize(lexer)) {
-        free(source);
-        return 1;
-    }
+    // Load source (mmap'd when possible)
+    SourceFile src;
+    if (!source_open(&src, input_file)) return 1;
+    const char *source = src.data;
+    size_t source_len = src.len;
 
-    // Parse
-    Parser *parser = parser_create(lexer->tokens, lexer->token_count);
-    if (!parser) {
-        lexer_free(lexer);
-        free(source);
+    // Parse, or reuse the tree from the last run on this source
+    uint32_t modules = 0;
+    ASTNode *ast = load_program(source, source_len, use_cache, &modules);
+    if (!ast) {
+        source_close(&src);
         return 1;
     }
 
-    ASTNode *ast = parser_parse(parser);
-    if (!ast) {
-        parser_free(parser);
-        lexer_free(lexer);
-        free(source);
+    // Bind variable names to slots, fold constants, then infer types
+    if (!resolve_program(ast) || !fold_program(ast) || !infer_program(ast)) {
+        ast_free(ast);
+        source_close(&src);
         return 1;
     }
 
@@ -378,9 +421,7 @@ static int cmd_compile(int argc, char **argv) {
     if (!codegen_llvm(&ctx, output_file)) {
         fprintf(stderr, "Error: %s\n", ctx.error_msg);
         ast_free(ast);
-        parser_free(parser);
-        lexer_free(lexer);
-        free(source);
+        source_close(&src);
         return 1;
     }
 
@@ -388,9 +429,7 @@ static int cmd_compile(int argc, char **argv) {
 
     // Cleanup
     ast_free(ast);
-    parser_free(parser);
-    lexer_free(lexer);
-    free(source);
+    source_close(&src);
 
     return 0;
 }
@@ -402,7 +441,7 @@ static int cmd_parse(int argc, char **argv) {
     const char *input_file = NULL;
 
     for (int i = 0; i < argc; i++) {
-        if (argv[i][0] != '-') {
+        if (argv[i][0] != '-' || argv[i][1] == '\0') {
             input_file = argv[i];
             break;
         }
@@ -413,43 +452,35 @@ static int cmd_parse(int argc, char **argv) {
         return 1;
     }
 
-    // Read source
-    size_t source_len;
-    char *source = read_file(input_file, &source_len);
-    if (!source) return 1;
-
-    // Lex
-    Lexer *lexer = lexer_create(source, source_len);
-    if (!lexer || !lexer_tokenize(lexer)) {
-        free(source);
-        return 1;
-    }
+    // Load source (mmap'd when possible)
+    SourceFile src;
+    if (!source_open(&src, input_file)) return 1;
+    const char *source = src.data;
+    size_t source_len = src.len;
 
     // Parse
-    Parser *parser = parser_create(lexer->tokens, lexer->token_count);
-    if (!parser) {
-        lexer_free(lexer);
-        free(source);
+    uint32_t modules = 0;
+    ASTNode *ast = parse_source(source, source_len, &modules);
+    if (!ast) {
+        source_close(&src);
         return 1;
     }
 
-    ASTNode *ast = parser_parse(parser);
-    if (!ast) {
-        parser_free(parser);
-        lexer_free(lexer);
-        free(source);
+    // Flatten the tree; the pointer form is not needed for printing
+    CompactAST *compact = compact_from_ast(ast);
+    ast_free(ast);
+    if (!compact) {
+        source_close(&src);
         return 1;
     }
 
     // Print AST
     printf("=== AST ===\n");
-    print_ast(ast, 0);
+    print_ast(compact, compact->root, 0);
 
     // Cleanup
-    ast_free(ast);
-    parser_free(parser);
-    lexer_free(lexer);
-    free(source);
+    compact_free(compact);
+    source_close(&src);
 
     return 0;
 }
@@ -459,9 +490,12 @@ static int cmd_parse(int argc, char **argv) {
  */
 static int cmd_run(int argc, char **argv) {
     const char *input_file = NULL;
+    bool use_cache = true;
 
     for (int i = 0; i < argc; i++) {
-        if (argv[i][0] != '-') {
+        if (strcmp(argv[i], "--no-cache") == 0) {
+            use_cache = false;
+        } else if (argv[i][0] != '-' || argv[i][1] == '\0') {
             input_file = argv[i];
             break;
         }
@@ -472,45 +506,33 @@ static int cmd_run(int argc, char **argv) {
         return 1;
     }
 
-    // Read source
-    size_t source_len;
-    char *source = read_file(input_file, &source_len);
-    if (!source) return 1;
+    // Load source (mmap'd when possible)
+    SourceFile src;
+    if (!source_open(&src, input_file)) return 1;
+    const char *source = src.data;
+    size_t source_len = src.len;
 
-    // Lex
-    Lexer *lexer = lexer_create(source, source_len);
-    if (!lexer || !lexer_tokenize(lexer)) {
-        free(source);
+    // Parse, or reuse the tree from the last run on this source
+    uint32_t modules = 0;
+    ASTNode *ast = load_program(source, source_len, use_cache, &modules);
+    if (!ast) {
+        source_close(&src);
         return 1;
     }
 
-    // Check which modules are used
-    bool needs_http = false, needs_mcp = false, needs_llm = false;
-    for (size_t i = 0; i < lexer->token_count; i++) {
-        if (lexer->tokens[i].type == TOK_HTTP) needs_http = true;
-        if (lexer->tokens[i].type == TOK_MCP) needs_mcp = true;
-        if (lexer->tokens[i].type == TOK_LLM) needs_llm = true;
-    }
-
-    // Parse
-    Parser *parser = parser_create(lexer->tokens, lexer->token_count);
-    if (!parser) {
-        lexer_free(lexer);
-        free(source);
+    // Bind variable names to slots, fold constants, then infer types
+    if (!resolve_program(ast) || !fold_program(ast) || !infer_program(ast)) {
+        ast_free(ast);
+        source_close(&src);
         return 1;
     }
 
-    ASTNode *ast = parser_parse(parser);
-    if (!ast) {
-        parser_free(parser);
-        lexer_free(lexer);
-        free(source);
-        return 1;
-    }
+    // Check which modules are used
+    bool needs_http = (modules & MODULE_BIT(TOK_HTTP)) != 0;
+    bool needs_mcp = (modules & MODULE_BIT(TOK_MCP)) != 0;
+    bool needs_llm = (modules & MODULE_BIT(TOK_LLM)) != 0;
 
-    // Generate code to temp file
-    const char *tmp_ll = "/tmp/nerd_out.ll";
-    const char *tmp_main = "/tmp/nerd_main.ll";
+    // Generate code into memory; it is written out once, with the entry point
     const char *tmp_combined = "/tmp/nerd_combined.ll";
     const char *tmp_bin = "/tmp/nerd_run";
 
@@ -519,12 +541,13 @@ static int cmd_run(int argc, char **argv) {
     ctx.source = source;
     ctx.ast = ast;
 
-    if (!codegen_llvm(&ctx, tmp_ll)) {
+    IRBuffer ir;
+    ir_init(&ir, NULL);
+    if (!codegen_module(&ctx, &ir)) {
         fprintf(stderr, "Error: %s\n", ctx.error_msg);
+        ir_free(&ir);
         ast_free(ast);
-        parser_free(parser);
-        lexer_free(lexer);
-        free(source);
+        source_close(&src);
         return 1;
     }
 
@@ -532,8 +555,8 @@ static int cmd_run(int argc, char **argv) {
     ASTNode *program = ast;
     bool has_main = false;
     for (size_t i = 0; i < program->data.program.functions.count; i++) {
-        ASTNode *func = program->data.program.functions.nodes[i];
-        if (strcmp(func->data.func_def.name, "main") == 0) {
+        ASTNode *func = ast_list_nodes(&program->data.program.functions)[i];
+        if (strcmp(symbol_name(func->data.func_def.name), "main") == 0) {
             has_main = true;
             break;
         }
@@ -544,80 +567,75 @@ static int cmd_run(int argc, char **argv) {
     if (has_main) {
         // Program has main - create i32 wrapper that calls nerd's double main
         // Rename the NERD main to nerd_main, then create i32 main wrapper
-        snprintf(cmd, sizeof(cmd), 
-            "sed 's/define double @main/define double @nerd_main/g' %s > %s",
-            tmp_ll, tmp_combined);
-        if (system(cmd) != 0) {
-            fprintf(stderr, "Error: Failed to process file\n");
-            ast_free(ast); parser_free(parser); lexer_free(lexer); free(source);
-            return 1;
+        static const char nerd_def[] = "define double @main(";
+        char *def = strstr(ir.data, nerd_def);
+        if (def) {
+            IRBuffer renamed;
+            ir_init(&renamed, NULL);
+            ir_append(&renamed, ir.data, (size_t)(def - ir.data));
+            ir_puts(&renamed, "define double @nerd_main(");
+            ir_puts(&renamed, def + strlen(nerd_def));
+            ir_free(&ir);
+            ir = renamed;
         }
-        
+
         // Append i32 main wrapper
-        FILE *f = fopen(tmp_combined, "a");
-        if (f) {
-            fprintf(f, "\n; Entry point wrapper\n");
-            fprintf(f, "define i32 @main() {\n");
-            fprintf(f, "entry:\n");
-            fprintf(f, "  call double @nerd_main()\n");
-            fprintf(f, "  ret i32 0\n");
-            fprintf(f, "}\n");
-            fclose(f);
-        }
+        ir_puts(&ir, "\n; Entry point wrapper\n");
+        ir_puts(&ir, "define i32 @main() {\n");
+        ir_puts(&ir, "entry:\n");
+        ir_puts(&ir, "  call double @nerd_main()\n");
+        ir_puts(&ir, "  ret i32 0\n");
+        ir_puts(&ir, "}\n");
     } else {
         // No main - generate test wrapper (old behavior for library-style code)
-        FILE *main_file = fopen(tmp_main, "w");
-        if (!main_file) {
-            fprintf(stderr, "Error: Cannot create temp file\n");
-            ast_free(ast); parser_free(parser); lexer_free(lexer); free(source);
-            return 1;
-        }
-
-        fprintf(main_file, "; Auto-generated main for nerd run\n\n");
-        fprintf(main_file, "@.fmt = private constant [11 x i8] c\"%%s = %%.0f\\0A\\00\"\n");
-        fprintf(main_file, "declare i32 @printf(i8*, ...)\n\n");
+        ir_puts(&ir, "; Auto-generated main for nerd run\n\n");
+        ir_puts(&ir, "@.fmt = private constant [11 x i8] c\"%s = %.0f\\0A\\00\"\n");
+        ir_puts(&ir, "declare i32 @printf(i8*, ...)\n\n");
 
         size_t func_count = program->data.program.functions.count;
         for (size_t i = 0; i < func_count; i++) {
-            ASTNode *func = program->data.program.functions.nodes[i];
-            const char *name = func->data.func_def.name;
-            fprintf(main_file, "@.name%zu = private constant [%zu x i8] c\"%s\\00\"\n", 
+            ASTNode *func = ast_list_nodes(&program->data.program.functions)[i];
+            const char *name = symbol_name(func->data.func_def.name);
+            ir_emit(&ir, "@.name%zu = private constant [%zu x i8] c\"%s\\00\"\n", 
                     i, strlen(name) + 1, name);
         }
 
-        fprintf(main_file, "\ndefine i32 @main() {\n");
-        fprintf(main_file, "entry:\n");
+        ir_puts(&ir, "\ndefine i32 @main() {\n");
+        ir_puts(&ir, "entry:\n");
 
         for (size_t i = 0; i < func_count; i++) {
-            ASTNode *func = program->data.program.functions.nodes[i];
-            const char *name = func->data.func_def.name;
+            ASTNode *func = ast_list_nodes(&program->data.program.functions)[i];
+            const char *name = symbol_name(func->data.func_def.name);
             size_t param_count = func->data.func_def.params.count;
             
-            fprintf(main_file, "  %%r%zu = call double @%s(", i, name);
+            ir_emit(&ir, "  %%r%zu = call double @%s(", i, name);
             for (size_t j = 0; j < param_count; j++) {
-                if (j > 0) fprintf(main_file, ", ");
-                if (j == 0) fprintf(main_file, "double 5.0");
-                else if (j == 1) fprintf(main_file, "double 3.0");
-                else fprintf(main_file, "double 1.0");
+                if (j > 0) ir_puts(&ir, ", ");
+                if (j == 0) ir_puts(&ir, "double 5.0");
+                else if (j == 1) ir_puts(&ir, "double 3.0");
+                else ir_puts(&ir, "double 1.0");
             }
-            fprintf(main_file, ")\n");
+            ir_puts(&ir, ")\n");
             
-            fprintf(main_file, "  %%fmt%zu = getelementptr [11 x i8], [11 x i8]* @.fmt, i32 0, i32 0\n", i);
-            fprintf(main_file, "  %%nm%zu = getelementptr [%zu x i8], [%zu x i8]* @.name%zu, i32 0, i32 0\n", 
+            ir_emit(&ir, "  %%fmt%zu = getelementptr [11 x i8], [11 x i8]* @.fmt, i32 0, i32 0\n", i);
+            ir_emit(&ir, "  %%nm%zu = getelementptr [%zu x i8], [%zu x i8]* @.name%zu, i32 0, i32 0\n", 
                     i, strlen(name) + 1, strlen(name) + 1, i);
-            fprintf(main_file, "  call i32 (i8*, ...) @printf(i8* %%fmt%zu, i8* %%nm%zu, double %%r%zu)\n", i, i, i);
+            ir_emit(&ir, "  call i32 (i8*, ...) @printf(i8* %%fmt%zu, i8* %%nm%zu, double %%r%zu)\n", i, i, i);
         }
 
-        fprintf(main_file, "  ret i32 0\n");
-        fprintf(main_file, "}\n");
-        fclose(main_file);
+        ir_puts(&ir, "  ret i32 0\n");
+        ir_puts(&ir, "}\n");
+    }
 
-        snprintf(cmd, sizeof(cmd), "cat %s %s > %s", tmp_ll, tmp_main, tmp_combined);
-        if (system(cmd) != 0) {
-            fprintf(stderr, "Error: Failed to combine files\n");
-            ast_free(ast); parser_free(parser); lexer_free(lexer); free(source);
-            return 1;
-        }
+    FILE *combined = fopen(tmp_combined, "w");
+    bool written = combined && !ir.failed &&
+                   fwrite(ir.data, 1, ir.len, combined) == ir.len;
+    if (combined && fclose(combined) != 0) written = false;
+    ir_free(&ir);
+    if (!written) {
+        fprintf(stderr, "Error: Cannot create temp file\n");
+        ast_free(ast); source_close(&src);
+        return 1;
     }
 
     // Build clang command with required libraries
@@ -681,9 +699,7 @@ static int cmd_run(int argc, char **argv) {
     if (system(cmd) != 0) {
         fprintf(stderr, "Error: clang compilation failed. Check %s\n", tmp_combined);
         ast_free(ast);
-        parser_free(parser);
-        lexer_free(lexer);
-        free(source);
+        source_close(&src);
         return 1;
     }
 
@@ -691,15 +707,11 @@ static int cmd_run(int argc, char **argv) {
     int result = system(tmp_bin);
 
     // Cleanup
-    remove(tmp_ll);
-    remove(tmp_main);
     remove(tmp_combined);
     remove(tmp_bin);
 
     ast_free(ast);
-    parser_free(parser);
-    lexer_free(lexer);
-    free(source);
+    source_close(&src);
 
     return result;
 }
@@ -711,7 +723,7 @@ static int cmd_tokens(int argc, char **argv) {
     const char *input_file = NULL;
 
     for (int i = 0; i < argc; i++) {
-        if (argv[i][0] != '-') {
+        if (argv[i][0] != '-' || argv[i][1] == '\0') {
             input_file = argv[i];
             break;
         }
@@ -722,34 +734,115 @@ static int cmd_tokens(int argc, char **argv) {
         return 1;
     }
 
-    // Read source
-    size_t source_len;
-    char *source = read_file(input_file, &source_len);
-    if (!source) return 1;
+    // Load source (mmap'd when possible)
+    SourceFile src;
+    if (!source_open(&src, input_file)) return 1;
+    const char *source = src.data;
+    size_t source_len = src.len;
 
     // Lex
     Lexer *lexer = lexer_create(source, source_len);
     if (!lexer || !lexer_tokenize(lexer)) {
-        free(source);
+        source_close(&src);
         return 1;
     }
 
     // Print tokens
     printf("=== Tokens ===\n");
-    for (size_t i = 0; i < lexer->token_count; i++) {
-        Token *tok = &lexer->tokens[i];
-        if (tok->type == TOK_NEWLINE) continue;
-        printf("%s(%s) ", token_name(tok->type), tok->value);
+    TokenStream *ts = &lexer->tokens;
+    for (size_t i = 0; i < ts->count; i++) {
+        if (ts->types[i] == TOK_NEWLINE) continue;
+        printf("%s(%.*s) ", token_name(ts->types[i]), (int)ts->lengths[i], source + ts->offsets[i]);
     }
     printf("\n");
 
     // Cleanup
     lexer_free(lexer);
-    free(source);
+    source_close(&src);
 
     return 0;
 }
 
+/*
+ * Watch command (recompile whenever the file changes)
+ */
+static int cmd_watch(int argc, char **argv) {
+    const char *input_file = NULL;
+    const char *output_file = NULL;
+
+    for (int i = 0; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output_file = argv[++i];
+        } else if (argv[i][0] != '-') {
+            input_file = argv[i];
+        }
+    }
+
+    if (!input_file) {
+        fprintf(stderr, "Error: No input file specified\n");
+        return 1;
+    }
+
+    // Default output file
+    char default_output[256];
+    if (!output_file) {
+        snprintf(default_output, sizeof(default_output), "%s", input_file);
+        char *dot = strrchr(default_output, '.');
+        if (dot) *dot = '\0';
+        strcat(default_output, ".ll");
+        output_file = default_output;
+    }
+
+    IncrementalBuild *build = incremental_create();
+    if (!build) return 1;
+
+    printf("Watching %s (Ctrl-C to stop)\n", input_file);
+    fflush(stdout);
+
+    // Poll the file. A change is built once mtime and size hold still for
+    // one poll, so a half-written save doesn't evict the functions it lacks.
+    struct timespec seen_mtime = {0, 0};
+    off_t seen_size = -1;
+    bool pending = false;
+    const struct timespec interval = {0, 250 * 1000000L};
+    for (;;) {
+        struct stat st;
+        if (stat(input_file, &st) != 0) {
+            nanosleep(&interval, NULL);
+            continue;
+        }
+        if (st.st_mtim.tv_sec != seen_mtime.tv_sec ||
+            st.st_mtim.tv_nsec != seen_mtime.tv_nsec || st.st_size != seen_size) {
+            seen_mtime = st.st_mtim;
+            seen_size = st.st_size;
+            pending = true;
+        } else if (pending) {
+            pending = false;
+
+            SourceFile src;
+            if (source_open(&src, input_file)) {
+                struct timespec t0, t1;
+                clock_gettime(CLOCK_MONOTONIC, &t0);
+                bool ok = incremental_compile(build, src.data, src.len, output_file);
+                clock_gettime(CLOCK_MONOTONIC, &t1);
+                source_close(&src);
+
+                double ms = (double)(t1.tv_sec - t0.tv_sec) * 1000.0 +
+                            (double)(t1.tv_nsec - t0.tv_nsec) / 1e6;
+                if (ok) {
+                    printf("Compiled %s -> %s (%zu of %zu functions rebuilt, %.1f ms)\n",
+                           input_file, output_file, build->rebuilt,
+                           build->rebuilt + build->reused, ms);
+                } else {
+                    printf("Build failed; waiting for changes\n");
+                }
+                fflush(stdout);
+            }
+        }
+        nanosleep(&interval, NULL);
+    }
+}
+
 /*
  * Main entry point
  */
@@ -769,6 +862,8 @@ int main(int argc, char **argv) {
         return cmd_parse(argc - 2, argv + 2);
     } else if (strcmp(cmd, "tokens") == 0) {
         return cmd_tokens(argc - 2, argv + 2);
+    } else if (strcmp(cmd, "watch") == 0) {
+        return cmd_watch(argc - 2, argv + 2);
     } else if (strcmp(cmd, "--help") == 0 || strcmp(cmd, "-h") == 0) {
         print_usage();
         return 0;
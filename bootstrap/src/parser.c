@@ -2,16 +2,61 @@
  * NERD Parser - Builds AST from tokens
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdarg.h>
+#include <pthread.h>
+#include <unistd.h>
 #include "nerd.h"
 
 /*
- * AST Node creation
+ * Bytes each node kind needs: the header plus its own union member
+ */
+#define NODE_SIZE(member) (offsetof(ASTNode, data) + sizeof(((ASTNode *)0)->data.member))
+
+static const size_t node_sizes[] = {
+    [NODE_PROGRAM]     = NODE_SIZE(program),
+    [NODE_FUNC_DEF]    = NODE_SIZE(func_def),
+    [NODE_TYPE_DEF]    = NODE_SIZE(type_def),
+    [NODE_PARAM]       = NODE_SIZE(param),
+    [NODE_RETURN]      = NODE_SIZE(ret),
+    [NODE_IF]          = NODE_SIZE(if_stmt),
+    [NODE_LET]         = NODE_SIZE(let),
+    [NODE_EXPR_STMT]   = NODE_SIZE(expr_stmt),
+    [NODE_OUT]         = NODE_SIZE(out),
+    [NODE_REPEAT]      = NODE_SIZE(repeat),
+    [NODE_WHILE]       = NODE_SIZE(while_loop),
+    [NODE_INC]         = NODE_SIZE(inc),
+    [NODE_DEC]         = NODE_SIZE(dec),
+    [NODE_BINOP]       = NODE_SIZE(binop),
+    [NODE_UNARYOP]     = NODE_SIZE(unaryop),
+    [NODE_CALL]        = NODE_SIZE(call),
+    [NODE_NUM]         = NODE_SIZE(num),
+    [NODE_STR]         = NODE_SIZE(str),
+    [NODE_BOOL]        = NODE_SIZE(boolean),
+    [NODE_VAR]         = NODE_SIZE(var),
+    [NODE_POSITIONAL]  = NODE_SIZE(positional),
+    [NODE_JSON_NEW]    = offsetof(ASTNode, data),
+    [NODE_JSON_ACCESS] = NODE_SIZE(json_access),
+    [NODE_JSON_HAS]    = NODE_SIZE(json_has),
+    [NODE_JSON_COUNT]  = NODE_SIZE(json_count),
+    [NODE_JSON_SET]    = NODE_SIZE(json_set),
+};
+
+/*
+ * AST Node creation (nodes live in the compilation's arena)
+ *
+ * Only the node's own union member is allocated, so a call or function
+ * node with inline lists doesn't make every literal as big. Nodes must
+ * never be copied by value.
  */
-ASTNode *ast_create(NodeType type, int line) {
-    ASTNode *node = calloc(1, sizeof(ASTNode));
+ASTNode *ast_create(Arena *arena, NodeType type, int line) {
+    size_t size = (size_t)type < sizeof(node_sizes) / sizeof(node_sizes[0]) && node_sizes[type]
+                  ? node_sizes[type] : sizeof(ASTNode);
+    ASTNode *node = arena_alloc(arena, size);
     if (node) {
         node->type = type;
         node->line = line;
@@ -20,143 +65,84 @@ ASTNode *ast_create(NodeType type, int line) {
 }
 
 /*
- * Free AST node recursively
+ * Free an AST
+ *
+ * Everything in a tree is arena memory, so freeing a program releases its
+ * arena in one go. Any other node is reclaimed with the arena, which makes
+ * this a no-op for subtrees dropped on parse errors.
  */
 void ast_free(ASTNode *node) {
-    if (!node) return;
-
-    switch (node->type) {
-        case NODE_PROGRAM:
-            ast_list_free(&node->data.program.types);
-            ast_list_free(&node->data.program.functions);
-            break;
-        case NODE_FUNC_DEF:
-            free(node->data.func_def.name);
-            ast_list_free(&node->data.func_def.params);
-            ast_free(node->data.func_def.return_type);
-            ast_list_free(&node->data.func_def.body);
-            break;
-        case NODE_TYPE_DEF:
-            free(node->data.type_def.name);
-            ast_list_free(&node->data.type_def.fields);
-            ast_free(node->data.type_def.ok_type);
-            ast_free(node->data.type_def.err_type);
-            break;
-        case NODE_PARAM:
-            free(node->data.param.name);
-            ast_free(node->data.param.param_type);
-            break;
-        case NODE_RETURN:
-            ast_free(node->data.ret.value);
-            break;
-        case NODE_IF:
-            ast_free(node->data.if_stmt.condition);
-            ast_free(node->data.if_stmt.then_stmt);
-            ast_free(node->data.if_stmt.else_stmt);
-            break;
-        case NODE_OUT:
-            ast_free(node->data.out.value);
-            break;
-        case NODE_REPEAT:
-            ast_free(node->data.repeat.count);
-            free(node->data.repeat.var_name);
-            ast_list_free(&node->data.repeat.body);
-            break;
-        case NODE_WHILE:
-            ast_free(node->data.while_loop.condition);
-            ast_list_free(&node->data.while_loop.body);
-            break;
-        case NODE_INC:
-            free(node->data.inc.var_name);
-            ast_free(node->data.inc.amount);
-            break;
-        case NODE_DEC:
-            free(node->data.dec.var_name);
-            ast_free(node->data.dec.amount);
-            break;
-        case NODE_LET:
-            free(node->data.let.name);
-            ast_free(node->data.let.value);
-            break;
-        case NODE_EXPR_STMT:
-            ast_free(node->data.expr_stmt.expr);
-            break;
-        case NODE_BINOP:
-            free(node->data.binop.op);
-            ast_free(node->data.binop.left);
-            ast_free(node->data.binop.right);
-            break;
-        case NODE_UNARYOP:
-            free(node->data.unaryop.op);
-            ast_free(node->data.unaryop.operand);
-            break;
-        case NODE_CALL:
-            free(node->data.call.module);
-            free(node->data.call.func);
-            ast_list_free(&node->data.call.args);
-            break;
-        case NODE_STR:
-            free(node->data.str.value);
-            break;
-        case NODE_VAR:
-            free(node->data.var.name);
-            break;
-        case NODE_JSON_NEW:
-            // No additional data to free
-            break;
-        case NODE_JSON_ACCESS:
-            ast_free(node->data.json_access.object);
-            free(node->data.json_access.path);
-            break;
-        case NODE_JSON_HAS:
-            ast_free(node->data.json_has.object);
-            free(node->data.json_has.path);
-            break;
-        case NODE_JSON_COUNT:
-            ast_free(node->data.json_count.object);
-            free(node->data.json_count.path);
-            break;
-        case NODE_JSON_SET:
-            ast_free(node->data.json_set.object);
-            free(node->data.json_set.key);
-            ast_free(node->data.json_set.value);
-            break;
-        default:
-            break;
-    }
+    if (!node || node->type != NODE_PROGRAM) return;
+    arena_free(node->data.program.arena);
+}
 
-    free(node);
+/*
+ * Operator names, as written in source
+ */
+const char *op_name(OpCode op) {
+    static const char *names[] = {
+        [OP_PLUS] = "plus", [OP_MINUS] = "minus", [OP_TIMES] = "times",
+        [OP_OVER] = "over", [OP_MOD] = "mod", [OP_EQ] = "eq", [OP_NEQ] = "neq",
+        [OP_LT] = "lt", [OP_GT] = "gt", [OP_LTE] = "lte", [OP_GTE] = "gte",
+        [OP_AND] = "and", [OP_OR] = "or", [OP_NOT] = "not", [OP_NEG] = "neg",
+    };
+    if ((unsigned)op >= sizeof(names) / sizeof(names[0])) return "?";
+    return names[op];
 }
 
 /*
  * AST List operations
  */
 void ast_list_init(ASTList *list) {
-    list->nodes = NULL;
     list->count = 0;
     list->capacity = 0;
 }
 
-void ast_list_push(ASTList *list, ASTNode *node) {
+/*
+ * Make room for capacity nodes, spilling to the arena once past the
+ * inline slots (false if out of memory)
+ */
+bool ast_list_reserve(Arena *arena, ASTList *list, size_t capacity) {
+    if (capacity <= AST_LIST_INLINE || capacity <= list->capacity) return true;
+    if (capacity > UINT32_MAX) return false;
+
+    ASTNode **nodes;
+    if (list->capacity == 0) {
+        // The inline slots share storage with the spill pointer, so copy
+        // them out before it is set
+        nodes = arena_alloc(arena, sizeof(ASTNode*) * capacity);
+        if (!nodes) return false;
+        memcpy(nodes, list->inline_nodes, sizeof(ASTNode*) * list->count);
+    } else {
+        nodes = arena_grow(arena, list->spill,
+                           sizeof(ASTNode*) * list->capacity,
+                           sizeof(ASTNode*) * capacity);
+        if (!nodes) return false;
+    }
+    list->spill = nodes;
+    list->capacity = (uint32_t)capacity;
+    return true;
+}
+
+void ast_list_push(Arena *arena, ASTList *list, ASTNode *node) {
+    if (list->capacity == 0 && list->count < AST_LIST_INLINE) {
+        list->inline_nodes[list->count++] = node;
+        return;
+    }
     if (list->count >= list->capacity) {
-        size_t new_capacity = list->capacity == 0 ? 8 : list->capacity * 2;
-        ASTNode **new_nodes = realloc(list->nodes, sizeof(ASTNode*) * new_capacity);
-        if (!new_nodes) {
+        size_t new_capacity = list->capacity == 0 ? AST_LIST_INLINE * 4 : (size_t)list->capacity * 2;
+        if (!ast_list_reserve(arena, list, new_capacity)) {
             fprintf(stderr, "Error: Out of memory\n");
             return;
         }
-        list->nodes = new_nodes;
-        list->capacity = new_capacity;
     }
-    list->nodes[list->count++] = node;
+    list->spill[list->count++] = node;
 }
 
+/*
+ * List storage belongs to the arena; nothing to free
+ */
 void ast_list_free(ASTList *list) {
-    for (size_t i = 0; i < list->count; i++) {
-        ast_free(list->nodes[i]);
-    }
-    free(list->nodes);
-    list->nodes = NULL;
     list->count = 0;
     list->capacity = 0;
 }
@@ -164,39 +150,146 @@ void ast_list_free(ASTList *list) {
 /*
  * Parser creation
  */
-Parser *parser_create(Token *tokens, size_t count) {
-    Parser *parser = malloc(sizeof(Parser));
+Parser *parser_create(TokenStream *tokens) {
+    Parser *parser = calloc(1, sizeof(Parser));
     if (!parser) return NULL;
 
+    parser->source = tokens->source;
     parser->tokens = tokens;
-    parser->token_count = count;
+    parser->types = tokens->types;
     parser->pos = 0;
+    parser->arena = arena_create();
+    if (!parser->arena) {
+        free(parser);
+        return NULL;
+    }
 
     return parser;
 }
 
+/*
+ * Create a parser that pulls tokens from the lexer as it goes
+ */
+Parser *parser_create_stream(Lexer *lexer) {
+    Parser *parser = calloc(1, sizeof(Parser));
+    if (!parser) return NULL;
+
+    parser->source = lexer->source;
+    parser->tokens = &lexer->tokens;
+    parser->pos = 0;
+    parser->lexer = lexer;
+    parser->ring_line = 1;
+    parser->arena = arena_create();
+    if (!parser->arena) {
+        free(parser);
+        return NULL;
+    }
+
+    return parser;
+}
+
+/*
+ * Create a parser for a fresh lexer
+ *
+ * Large sources on a multi-core machine are lexed up front so lexing and
+ * parsing can both split across threads; otherwise tokens are streamed and
+ * their memory stays constant. Returns NULL if lexing fails.
+ */
+#define PARSER_BATCH_MIN (4u << 20)     // Source bytes worth lexing up front
+
+Parser *parser_create_auto(Lexer *lexer) {
+    if (lexer->source_len - lexer->pos >= PARSER_BATCH_MIN &&
+        sysconf(_SC_NPROCESSORS_ONLN) > 1) {
+        if (!lexer_tokenize(lexer)) return NULL;
+        return parser_create(&lexer->tokens);
+    }
+    return parser_create_stream(lexer);
+}
+
 void parser_free(Parser *parser) {
+    if (!parser) return;
+    arena_free(parser->arena);
     free(parser);
 }
 
 /*
- * Parser helpers
+ * Parser helpers - tokens are referred to by index into the stream
  */
-static Token *parser_current(Parser *parser) {
-    return &parser->tokens[parser->pos];
+#define NO_TOKEN ((size_t)-1)
+
+/*
+ * Ring slot of a streamed token, pulling from the lexer up to it
+ *
+ * Only the last PARSER_RING tokens stay available, so callers copy what
+ * they need out of a token before parsing anything long after it.
+ */
+static const RingToken *parser_ring(Parser *parser, size_t tok) {
+    while (parser->ring_end <= tok) {
+        RingToken *slot = &parser->ring[parser->ring_end & (PARSER_RING - 1)];
+        if (!parser->lex_failed && !lexer_next_token(parser->lexer, &slot->tok)) {
+            parser->lex_failed = true;
+        }
+        if (parser->lex_failed) {
+            // The lexer has reported the error; end the token stream here
+            slot->tok.type = TOK_EOF;
+            slot->tok.offset = (uint32_t)parser->lexer->pos;
+            slot->tok.length = 0;
+            slot->tok.sym = SYM_NONE;
+        }
+        slot->line = parser->ring_line;
+        if (slot->tok.type == TOK_NEWLINE) parser->ring_line++;
+        parser->ring_end++;
+    }
+    return &parser->ring[tok & (PARSER_RING - 1)];
+}
+
+static TokenType token_type(Parser *parser, size_t tok) {
+    if (parser->lexer) return parser_ring(parser, tok)->tok.type;
+    return (TokenType)parser->types[tok];
+}
+
+static size_t parser_current(Parser *parser) {
+    return parser->pos;
+}
+
+static TokenType parser_type(Parser *parser) {
+    return token_type(parser, parser->pos);
 }
 
 static bool parser_check(Parser *parser, TokenType type) {
-    return parser_current(parser)->type == type;
+    return token_type(parser, parser->pos) == type;
 }
 
 static bool parser_at_end(Parser *parser) {
-    return parser_current(parser)->type == TOK_EOF;
+    return token_type(parser, parser->pos) == TOK_EOF;
 }
 
-static Token *parser_advance(Parser *parser) {
+static size_t parser_advance(Parser *parser) {
     if (!parser_at_end(parser)) parser->pos++;
-    return &parser->tokens[parser->pos - 1];
+    return parser->pos - 1;
+}
+
+static int token_line(Parser *parser, size_t tok) {
+    if (parser->lexer) return parser_ring(parser, tok)->line;
+    int line;
+    token_stream_locate(parser->tokens, parser->tokens->offsets[tok], &line, NULL);
+    return line;
+}
+
+static int parser_line(Parser *parser) {
+    return token_line(parser, parser->pos);
+}
+
+/*
+ * Report a parse error (suppressed once the streaming lexer has failed,
+ * since the parser then only sees the stream cut short, and in workers)
+ */
+static void parser_error(Parser *parser, const char *fmt, ...) {
+    if (parser->lex_failed || parser->quiet) return;
+    va_list args;
+    va_start(args, fmt);
+    vfprintf(stderr, fmt, args);
+    va_end(args);
 }
 
 static bool parser_match(Parser *parser, TokenType type) {
@@ -207,13 +300,64 @@ static bool parser_match(Parser *parser, TokenType type) {
     return false;
 }
 
-static Token *parser_expect(Parser *parser, TokenType type, const char *msg) {
+static size_t parser_expect(Parser *parser, TokenType type, const char *msg) {
     if (parser_check(parser, type)) {
         return parser_advance(parser);
     }
-    fprintf(stderr, "Error at line %d: %s (got %d)\n",
-            parser_current(parser)->line, msg, parser_current(parser)->type);
-    return NULL;
+    parser_error(parser, "Error at line %d: %s (got %d)\n",
+                 parser_line(parser), msg, parser_type(parser));
+    return NO_TOKEN;
+}
+
+/*
+ * Token accessors - token text is a slice of the source buffer
+ */
+static Symbol token_sym(Parser *parser, size_t tok) {
+    if (parser->lexer) return parser_ring(parser, tok)->tok.sym;
+    return parser->tokens->syms[tok];
+}
+
+static const char *token_text(Parser *parser, size_t tok, size_t *len) {
+    if (parser->lexer) {
+        const Token *t = &parser_ring(parser, tok)->tok;
+        *len = t->length;
+        return parser->source + t->offset;
+    }
+    *len = parser->tokens->lengths[tok];
+    return parser->source + parser->tokens->offsets[tok];
+}
+
+static char *token_strdup(Parser *parser, size_t tok) {
+    size_t len;
+    const char *text = token_text(parser, tok, &len);
+    return arena_strndup(parser->arena, text, len);
+}
+
+static bool token_is(Parser *parser, size_t tok, const char *word) {
+    size_t len;
+    const char *text = token_text(parser, tok, &len);
+    return len == strlen(word) && memcmp(text, word, len) == 0;
+}
+
+static double token_number(Parser *parser, size_t tok) {
+    // Copy out so strtod stops at the token boundary, not the next byte;
+    // literals too long for the stack buffer get a heap copy
+    char buf[64];
+    size_t tok_len;
+    const char *text = token_text(parser, tok, &tok_len);
+    if (tok_len >= sizeof(buf)) {
+        char *copy = nerd_strndup(text, tok_len);
+        if (!copy) {
+            fprintf(stderr, "Error: Out of memory\n");
+            return 0;
+        }
+        double value = atof(copy);
+        free(copy);
+        return value;
+    }
+    memcpy(buf, text, tok_len);
+    buf[tok_len] = '\0';
+    return atof(buf);
 }
 
 static void parser_skip_newlines(Parser *parser) {
@@ -224,11 +368,33 @@ static bool parser_at_end_of_line(Parser *parser) {
     return parser_check(parser, TOK_NEWLINE) || parser_check(parser, TOK_EOF);
 }
 
+/*
+ * Opcode for a binary operator token
+ */
+static OpCode binop_from_token(TokenType type) {
+    switch (type) {
+        case TOK_PLUS:  return OP_PLUS;
+        case TOK_MINUS: return OP_MINUS;
+        case TOK_TIMES: return OP_TIMES;
+        case TOK_OVER:  return OP_OVER;
+        case TOK_MOD:   return OP_MOD;
+        case TOK_EQ:    return OP_EQ;
+        case TOK_NEQ:   return OP_NEQ;
+        case TOK_LT:    return OP_LT;
+        case TOK_GT:    return OP_GT;
+        case TOK_LTE:   return OP_LTE;
+        case TOK_GTE:   return OP_GTE;
+        case TOK_AND:   return OP_AND;
+        case TOK_OR:    return OP_OR;
+        default:        return OP_OR;   // Callers only pass operator tokens
+    }
+}
+
 /*
  * Check if current token is a type token
  */
 static bool is_type_token(Parser *parser) {
-    TokenType t = parser_current(parser)->type;
+    TokenType t = parser_type(parser);
     return t == TOK_NUM || t == TOK_INT || t == TOK_STR ||
            t == TOK_BOOL || t == TOK_VOID || t == TOK_LIST;
 }
@@ -237,7 +403,7 @@ static bool is_type_token(Parser *parser) {
  * Check if current token is a module token
  */
 static bool is_module_token(Parser *parser) {
-    TokenType t = parser_current(parser)->type;
+    TokenType t = parser_type(parser);
     return t == TOK_MATH || t == TOK_STR || t == TOK_LIST ||
            t == TOK_TIME || t == TOK_HTTP || t == TOK_JSON || t == TOK_ERR ||
            t == TOK_MCP || t == TOK_LLM;
@@ -247,7 +413,7 @@ static bool is_module_token(Parser *parser) {
  * Check if current token ends an expression
  */
 static bool is_end_of_expr(Parser *parser) {
-    TokenType t = parser_current(parser)->type;
+    TokenType t = parser_type(parser);
     return parser_at_end_of_line(parser) ||
            t == TOK_PLUS || t == TOK_MINUS || t == TOK_TIMES ||
            t == TOK_OVER || t == TOK_MOD || t == TOK_EQ ||
@@ -264,7 +430,7 @@ static bool is_end_of_expr(Parser *parser) {
  * Check if token is a number word
  */
 static bool is_number_word(Parser *parser) {
-    TokenType t = parser_current(parser)->type;
+    TokenType t = parser_type(parser);
     return t >= TOK_ZERO && t <= TOK_TEN;
 }
 
@@ -292,7 +458,7 @@ static double number_word_value(TokenType type) {
  * Check if token is a positional reference
  */
 static bool is_positional(Parser *parser) {
-    TokenType t = parser_current(parser)->type;
+    TokenType t = parser_type(parser);
     return t == TOK_FIRST || t == TOK_SECOND ||
            t == TOK_THIRD || t == TOK_FOURTH;
 }
@@ -323,51 +489,51 @@ static ASTNode *parse_postfix(Parser *parser);
  * Parse primary expression
  */
 static ASTNode *parse_primary(Parser *parser) {
-    int line = parser_current(parser)->line;
+    int line = parser_line(parser);
 
     // Number literal
     if (parser_check(parser, TOK_NUMBER)) {
-        Token *tok = parser_advance(parser);
-        ASTNode *node = ast_create(NODE_NUM, line);
-        node->data.num.value = atof(tok->value);
+        size_t tok = parser_advance(parser);
+        ASTNode *node = ast_create(parser->arena, NODE_NUM, line);
+        node->data.num.value = token_number(parser, tok);
         return node;
     }
 
     // String literal
     if (parser_check(parser, TOK_STRING)) {
-        Token *tok = parser_advance(parser);
-        ASTNode *node = ast_create(NODE_STR, line);
-        node->data.str.value = nerd_strdup(tok->value);
+        size_t tok = parser_advance(parser);
+        ASTNode *node = ast_create(parser->arena, NODE_STR, line);
+        node->data.str.value = token_strdup(parser, tok);
         return node;
     }
 
     // Number words
     if (is_number_word(parser)) {
-        Token *tok = parser_advance(parser);
-        ASTNode *node = ast_create(NODE_NUM, line);
-        node->data.num.value = number_word_value(tok->type);
+        size_t tok = parser_advance(parser);
+        ASTNode *node = ast_create(parser->arena, NODE_NUM, line);
+        node->data.num.value = number_word_value(token_type(parser, tok));
         return node;
     }
 
     // Positional references
     if (is_positional(parser)) {
-        Token *tok = parser_advance(parser);
-        ASTNode *node = ast_create(NODE_POSITIONAL, line);
-        node->data.positional.index = positional_index(tok->type);
+        size_t tok = parser_advance(parser);
+        ASTNode *node = ast_create(parser->arena, NODE_POSITIONAL, line);
+        node->data.positional.index = positional_index(token_type(parser, tok));
         return node;
     }
 
     // Boolean literals
     if (parser_check(parser, TOK_IDENT)) {
-        if (strcmp(parser_current(parser)->value, "true") == 0) {
+        if (token_is(parser, parser_current(parser), "true")) {
             parser_advance(parser);
-            ASTNode *node = ast_create(NODE_BOOL, line);
+            ASTNode *node = ast_create(parser->arena, NODE_BOOL, line);
             node->data.boolean.value = true;
             return node;
         }
-        if (strcmp(parser_current(parser)->value, "false") == 0) {
+        if (token_is(parser, parser_current(parser), "false")) {
             parser_advance(parser);
-            ASTNode *node = ast_create(NODE_BOOL, line);
+            ASTNode *node = ast_create(parser->arena, NODE_BOOL, line);
             node->data.boolean.value = false;
             return node;
         }
@@ -375,13 +541,13 @@ static ASTNode *parse_primary(Parser *parser) {
 
     // Variable
     if (parser_check(parser, TOK_IDENT)) {
-        Token *tok = parser_advance(parser);
-        ASTNode *node = ast_create(NODE_VAR, line);
-        node->data.var.name = nerd_strdup(tok->value);
+        size_t tok = parser_advance(parser);
+        ASTNode *node = ast_create(parser->arena, NODE_VAR, line);
+        node->data.var.name = token_sym(parser, tok);
         return node;
     }
 
-    fprintf(stderr, "Error at line %d: Unexpected token in expression\n", line);
+    parser_error(parser, "Error at line %d: Unexpected token in expression\n", line);
     return NULL;
 }
 
@@ -392,7 +558,7 @@ static ASTNode *parse_postfix(Parser *parser) {
     ASTNode *left = parse_primary(parser);
     if (!left) return NULL;
 
-    int line = parser_current(parser)->line;
+    int line = parser_line(parser);
 
     // Handle chained postfix operations
     while (parser_check(parser, TOK_DOT) || parser_check(parser, TOK_QUESTION)) {
@@ -403,18 +569,18 @@ static ASTNode *parse_postfix(Parser *parser) {
                 // Check for .count suffix
                 if (parser_match(parser, TOK_COUNT)) {
                     // obj.count (count of root array) or after json_access.count
-                    ASTNode *count_node = ast_create(NODE_JSON_COUNT, line);
+                    ASTNode *count_node = ast_create(parser->arena, NODE_JSON_COUNT, line);
                     count_node->data.json_count.object = left;
                     count_node->data.json_count.path = NULL;  // Root level count
                     left = count_node;
                     continue;
                 }
-                fprintf(stderr, "Error at line %d: Expected string path after '.'\n", line);
+                parser_error(parser, "Error at line %d: Expected string path after '.'\n", line);
                 ast_free(left);
                 return NULL;
             }
 
-            Token *path_tok = parser_advance(parser);
+            size_t path_tok = parser_advance(parser);
             
             // Check if followed by .count
             if (parser_check(parser, TOK_DOT)) {
@@ -423,9 +589,9 @@ static ASTNode *parse_postfix(Parser *parser) {
                 parser_advance(parser);  // consume .
                 if (parser_match(parser, TOK_COUNT)) {
                     // obj."path".count
-                    ASTNode *count_node = ast_create(NODE_JSON_COUNT, line);
+                    ASTNode *count_node = ast_create(parser->arena, NODE_JSON_COUNT, line);
                     count_node->data.json_count.object = left;
-                    count_node->data.json_count.path = nerd_strdup(path_tok->value);
+                    count_node->data.json_count.path = token_strdup(parser, path_tok);
                     left = count_node;
                     continue;
                 } else {
@@ -435,23 +601,23 @@ static ASTNode *parse_postfix(Parser *parser) {
             }
 
             // Regular JSON access
-            ASTNode *access_node = ast_create(NODE_JSON_ACCESS, line);
+            ASTNode *access_node = ast_create(parser->arena, NODE_JSON_ACCESS, line);
             access_node->data.json_access.object = left;
-            access_node->data.json_access.path = nerd_strdup(path_tok->value);
+            access_node->data.json_access.path = token_strdup(parser, path_tok);
             left = access_node;
         }
         // JSON has: obj?"key"
         else if (parser_match(parser, TOK_QUESTION)) {
             if (!parser_check(parser, TOK_STRING)) {
-                fprintf(stderr, "Error at line %d: Expected string key after '?'\n", line);
+                parser_error(parser, "Error at line %d: Expected string key after '?'\n", line);
                 ast_free(left);
                 return NULL;
             }
 
-            Token *key_tok = parser_advance(parser);
-            ASTNode *has_node = ast_create(NODE_JSON_HAS, line);
+            size_t key_tok = parser_advance(parser);
+            ASTNode *has_node = ast_create(parser->arena, NODE_JSON_HAS, line);
             has_node->data.json_has.object = left;
-            has_node->data.json_has.path = nerd_strdup(key_tok->value);
+            has_node->data.json_has.path = token_strdup(parser, key_tok);
             left = has_node;
         }
     }
@@ -463,16 +629,16 @@ static ASTNode *parse_postfix(Parser *parser) {
  * Parse function call (module call or user-defined function call)
  */
 static ASTNode *parse_call(Parser *parser) {
-    int line = parser_current(parser)->line;
+    int line = parser_line(parser);
 
     // User-defined function call: call funcname arg1 arg2 ...
     if (parser_match(parser, TOK_CALL)) {
-        Token *func_tok = parser_expect(parser, TOK_IDENT, "Expected function name after call");
-        if (!func_tok) return NULL;
+        size_t func_tok = parser_expect(parser, TOK_IDENT, "Expected function name after call");
+        if (func_tok == NO_TOKEN) return NULL;
 
-        ASTNode *node = ast_create(NODE_CALL, line);
+        ASTNode *node = ast_create(parser->arena, NODE_CALL, line);
         node->data.call.module = NULL;  // No module = user-defined function
-        node->data.call.func = nerd_strdup(func_tok->value);
+        node->data.call.func = token_strdup(parser, func_tok);
         ast_list_init(&node->data.call.args);
 
         // Parse arguments until end of expression context
@@ -482,7 +648,7 @@ static ASTNode *parse_call(Parser *parser) {
                 ast_free(node);
                 return NULL;
             }
-            ast_list_push(&node->data.call.args, arg);
+            ast_list_push(parser->arena, &node->data.call.args, arg);
         }
 
         return node;
@@ -490,26 +656,31 @@ static ASTNode *parse_call(Parser *parser) {
 
     // Module call: math abs x, http get url, etc.
     if (is_module_token(parser)) {
-        Token *mod_tok = parser_advance(parser);
+        size_t mod_tok = parser_advance(parser);
+        TokenType mod_type = token_type(parser, mod_tok);
+        if (mod_type >= TOK_MATH && mod_type <= TOK_LLM) {
+            parser->modules |= MODULE_BIT(mod_type);
+        }
         
         // HTTP module: accept method tokens (GET, POST, PUT, DELETE, PATCH) or identifiers
         const char *func_name = NULL;
-        if (strcmp(mod_tok->value, "http") == 0) {
-            TokenType t = parser_current(parser)->type;
+        size_t func_tok = NO_TOKEN;
+        if (mod_type == TOK_HTTP) {
+            TokenType t = parser_type(parser);
             if (t == TOK_GET) { func_name = "get"; parser_advance(parser); }
             else if (t == TOK_POST) { func_name = "post"; parser_advance(parser); }
             else if (t == TOK_PUT) { func_name = "put"; parser_advance(parser); }
             else if (t == TOK_DELETE) { func_name = "delete"; parser_advance(parser); }
             else if (t == TOK_PATCH) { func_name = "patch"; parser_advance(parser); }
-            else if (t == TOK_IDENT) { func_name = parser_advance(parser)->value; }
+            else if (t == TOK_IDENT) { func_tok = parser_advance(parser); }
             else {
-                fprintf(stderr, "Error at line %d: Expected HTTP method (get, post, put, delete, patch)\n", line);
+                parser_error(parser, "Error at line %d: Expected HTTP method (get, post, put, delete, patch)\n", line);
                 return NULL;
             }
         }
         // MCP module: accept MCP command tokens or identifiers
-        else if (strcmp(mod_tok->value, "mcp") == 0) {
-            TokenType t = parser_current(parser)->type;
+        else if (mod_type == TOK_MCP) {
+            TokenType t = parser_type(parser);
             if (t == TOK_TOOLS) { func_name = "tools"; parser_advance(parser); }
             else if (t == TOK_USE) { func_name = "use"; parser_advance(parser); }
             else if (t == TOK_RESOURCES) { func_name = "resources"; parser_advance(parser); }
@@ -518,32 +689,31 @@ static ASTNode *parse_call(Parser *parser) {
             else if (t == TOK_PROMPT) { func_name = "prompt"; parser_advance(parser); }
             else if (t == TOK_INIT) { func_name = "init"; parser_advance(parser); }
             else if (t == TOK_LOG) { func_name = "log"; parser_advance(parser); }
-            else if (t == TOK_IDENT) { func_name = parser_advance(parser)->value; }
+            else if (t == TOK_IDENT) { func_tok = parser_advance(parser); }
             else {
-                fprintf(stderr, "Error at line %d: Expected MCP command (tools, use, resources, read, prompts, prompt, init, log)\n", line);
+                parser_error(parser, "Error at line %d: Expected MCP command (tools, use, resources, read, prompts, prompt, init, log)\n", line);
                 return NULL;
             }
         } else {
-        Token *func_tok = parser_expect(parser, TOK_IDENT, "Expected function name after module");
-        if (!func_tok) return NULL;
-            func_name = func_tok->value;
+            func_tok = parser_expect(parser, TOK_IDENT, "Expected function name after module");
+            if (func_tok == NO_TOKEN) return NULL;
         }
 
-        ASTNode *node = ast_create(NODE_CALL, line);
-        node->data.call.module = nerd_strdup(mod_tok->value);
-        node->data.call.func = nerd_strdup(func_name);
+        ASTNode *node = ast_create(parser->arena, NODE_CALL, line);
+        node->data.call.module = token_strdup(parser, mod_tok);
+        node->data.call.func = func_tok != NO_TOKEN ? token_strdup(parser, func_tok) : arena_strdup(parser->arena, func_name);
         ast_list_init(&node->data.call.args);
 
         // Parse arguments until end of expression context or 'with'/'auth' modifier
         while (!is_end_of_expr(parser) && 
-               parser_current(parser)->type != TOK_WITH &&
-               parser_current(parser)->type != TOK_AUTH) {
+               parser_type(parser) != TOK_WITH &&
+               parser_type(parser) != TOK_AUTH) {
             ASTNode *arg = parse_unary(parser);  // Allow unary ops (neg, not)
             if (!arg) {
                 ast_free(node);
                 return NULL;
             }
-            ast_list_push(&node->data.call.args, arg);
+            ast_list_push(parser->arena, &node->data.call.args, arg);
         }
 
         // Parse 'with' headers: http get "url" with "Header" "Value" with "H2" "V2"
@@ -554,7 +724,7 @@ static ASTNode *parse_call(Parser *parser) {
                 ast_free(node);
                 return NULL;
             }
-            ast_list_push(&node->data.call.args, header_name);
+            ast_list_push(parser->arena, &node->data.call.args, header_name);
             
             // Expect header value (string or expression)
             ASTNode *header_value = parse_unary(parser);
@@ -562,7 +732,7 @@ static ASTNode *parse_call(Parser *parser) {
                 ast_free(node);
                 return NULL;
             }
-            ast_list_push(&node->data.call.args, header_value);
+            ast_list_push(parser->arena, &node->data.call.args, header_value);
             
             // Mark that we have headers (use special marker)
             // We'll handle this in codegen by looking for string pairs after URL/body
@@ -578,10 +748,10 @@ static ASTNode *parse_call(Parser *parser) {
                     return NULL;
                 }
                 // Add special marker args for bearer auth
-                ASTNode *marker = ast_create(NODE_STR, line);
-                marker->data.str.value = nerd_strdup("__auth_bearer__");
-                ast_list_push(&node->data.call.args, marker);
-                ast_list_push(&node->data.call.args, token_arg);
+                ASTNode *marker = ast_create(parser->arena, NODE_STR, line);
+                marker->data.str.value = arena_strdup(parser->arena, "__auth_bearer__");
+                ast_list_push(parser->arena, &node->data.call.args, marker);
+                ast_list_push(parser->arena, &node->data.call.args, token_arg);
             } else if (parser_match(parser, TOK_BASIC)) {
                 // auth basic "user" "pass"
                 ASTNode *user_arg = parse_unary(parser);
@@ -591,13 +761,13 @@ static ASTNode *parse_call(Parser *parser) {
                     return NULL;
                 }
                 // Add special marker args for basic auth
-                ASTNode *marker = ast_create(NODE_STR, line);
-                marker->data.str.value = nerd_strdup("__auth_basic__");
-                ast_list_push(&node->data.call.args, marker);
-                ast_list_push(&node->data.call.args, user_arg);
-                ast_list_push(&node->data.call.args, pass_arg);
+                ASTNode *marker = ast_create(parser->arena, NODE_STR, line);
+                marker->data.str.value = arena_strdup(parser->arena, "__auth_basic__");
+                ast_list_push(parser->arena, &node->data.call.args, marker);
+                ast_list_push(parser->arena, &node->data.call.args, user_arg);
+                ast_list_push(parser->arena, &node->data.call.args, pass_arg);
             } else {
-                fprintf(stderr, "Error at line %d: Expected 'bearer' or 'basic' after 'auth'\n", line);
+                parser_error(parser, "Error at line %d: Expected 'bearer' or 'basic' after 'auth'\n", line);
                 ast_free(node);
                 return NULL;
             }
@@ -611,188 +781,123 @@ static ASTNode *parse_call(Parser *parser) {
 
 /*
  * Parse unary expression
+ *
+ * Prefix operators are chained iteratively: each new node is hung off the
+ * operand slot of the one before, and the operand fills the last slot.
  */
 static ASTNode *parse_unary(Parser *parser) {
-    int line = parser_current(parser)->line;
-
-    if (parser_match(parser, TOK_NOT)) {
-        ASTNode *operand = parse_unary(parser);
-        if (!operand) return NULL;
-
-        ASTNode *node = ast_create(NODE_UNARYOP, line);
-        node->data.unaryop.op = nerd_strdup("not");
-        node->data.unaryop.operand = operand;
-        return node;
-    }
-
-    // neg x -> negate x
-    if (parser_match(parser, TOK_NEG)) {
-        ASTNode *operand = parse_unary(parser);
-        if (!operand) return NULL;
-
-        ASTNode *node = ast_create(NODE_UNARYOP, line);
-        node->data.unaryop.op = nerd_strdup("neg");
-        node->data.unaryop.operand = operand;
-        return node;
-    }
-
-    return parse_call(parser);
-}
-
-/*
- * Parse multiplicative expression
- */
-static ASTNode *parse_multiplicative(Parser *parser) {
-    ASTNode *left = parse_unary(parser);
-    if (!left) return NULL;
-
-    while (parser_check(parser, TOK_TIMES) ||
-           parser_check(parser, TOK_OVER) ||
-           parser_check(parser, TOK_MOD)) {
-        int line = parser_current(parser)->line;
-        Token *op_tok = parser_advance(parser);
-
-        ASTNode *right = parse_unary(parser);
-        if (!right) {
-            ast_free(left);
-            return NULL;
-        }
-
-        ASTNode *node = ast_create(NODE_BINOP, line);
-        node->data.binop.op = nerd_strdup(op_tok->value);
-        node->data.binop.left = left;
-        node->data.binop.right = right;
-        left = node;
-    }
-
-    return left;
-}
-
-/*
- * Parse additive expression
- */
-static ASTNode *parse_additive(Parser *parser) {
-    ASTNode *left = parse_multiplicative(parser);
-    if (!left) return NULL;
-
-    while (parser_check(parser, TOK_PLUS) || parser_check(parser, TOK_MINUS)) {
-        int line = parser_current(parser)->line;
-        Token *op_tok = parser_advance(parser);
-
-        ASTNode *right = parse_multiplicative(parser);
-        if (!right) {
-            ast_free(left);
-            return NULL;
-        }
-
-        ASTNode *node = ast_create(NODE_BINOP, line);
-        node->data.binop.op = nerd_strdup(op_tok->value);
-        node->data.binop.left = left;
-        node->data.binop.right = right;
-        left = node;
+    ASTNode *root = NULL;
+    ASTNode **slot = &root;
+
+    // not x, neg x -> negate x
+    while (parser_check(parser, TOK_NOT) || parser_check(parser, TOK_NEG)) {
+        int line = parser_line(parser);
+        ASTNode *node = ast_create(parser->arena, NODE_UNARYOP, line);
+        node->data.unaryop.op = parser_type(parser) == TOK_NOT ? OP_NOT : OP_NEG;
+        parser_advance(parser);
+        *slot = node;
+        slot = &node->data.unaryop.operand;
     }
 
-    return left;
+    ASTNode *operand = parse_call(parser);
+    if (!operand) return NULL;
+    *slot = operand;
+    return root;
 }
 
 /*
- * Parse comparison expression
+ * Binding power of binary operators (0 = not a binary operator)
  */
-static ASTNode *parse_comparison(Parser *parser) {
-    ASTNode *left = parse_additive(parser);
-    if (!left) return NULL;
-
-    while (parser_check(parser, TOK_EQ) || parser_check(parser, TOK_NEQ) ||
-           parser_check(parser, TOK_LT) || parser_check(parser, TOK_GT) ||
-           parser_check(parser, TOK_LTE) || parser_check(parser, TOK_GTE)) {
-        int line = parser_current(parser)->line;
-        Token *op_tok = parser_advance(parser);
-
-        ASTNode *right = parse_additive(parser);
-        if (!right) {
-            ast_free(left);
-            return NULL;
-        }
-
-        ASTNode *node = ast_create(NODE_BINOP, line);
-        node->data.binop.op = nerd_strdup(op_tok->value);
-        node->data.binop.left = left;
-        node->data.binop.right = right;
-        left = node;
-    }
-
-    return left;
-}
+enum {
+    PREC_NONE,
+    PREC_OR,
+    PREC_AND,
+    PREC_COMPARISON,
+    PREC_ADDITIVE,
+    PREC_MULTIPLICATIVE,
+    PREC_LEVELS = PREC_MULTIPLICATIVE
+};
+
+static const unsigned char binop_precedence[TOK_EOF + 1] = {
+    [TOK_OR]    = PREC_OR,
+    [TOK_AND]   = PREC_AND,
+    [TOK_EQ]    = PREC_COMPARISON,
+    [TOK_NEQ]   = PREC_COMPARISON,
+    [TOK_LT]    = PREC_COMPARISON,
+    [TOK_GT]    = PREC_COMPARISON,
+    [TOK_LTE]   = PREC_COMPARISON,
+    [TOK_GTE]   = PREC_COMPARISON,
+    [TOK_PLUS]  = PREC_ADDITIVE,
+    [TOK_MINUS] = PREC_ADDITIVE,
+    [TOK_TIMES] = PREC_MULTIPLICATIVE,
+    [TOK_OVER]  = PREC_MULTIPLICATIVE,
+    [TOK_MOD]   = PREC_MULTIPLICATIVE,
+};
 
 /*
- * Parse and expression
+ * Parse binary operators binding at least as tightly as min_prec
+ *
+ * Precedence climbing with an explicit stack. All operators are left
+ * associative, so an operator is only pushed once everything pending at
+ * its level or above has been folded; the pending precedences strictly
+ * rise, and the stack never holds more than one entry per level however
+ * long the expression is.
  */
-static ASTNode *parse_and(Parser *parser) {
-    ASTNode *left = parse_comparison(parser);
-    if (!left) return NULL;
-
-    while (parser_match(parser, TOK_AND)) {
-        int line = parser_current(parser)->line;
-
-        ASTNode *right = parse_comparison(parser);
-        if (!right) {
-            ast_free(left);
-            return NULL;
+static ASTNode *parse_binary(Parser *parser, int min_prec) {
+    struct {
+        ASTNode *left;
+        OpCode op;
+        int prec;
+        int line;
+    } stack[PREC_LEVELS];
+    int depth = 0;
+
+    ASTNode *right = parse_unary(parser);
+    if (!right) return NULL;
+
+    for (;;) {
+        int prec = binop_precedence[parser_type(parser)];
+        if (prec < min_prec) prec = PREC_NONE;
+
+        // Fold pending operators that bind at least as tightly as this one
+        while (depth > 0 && stack[depth - 1].prec >= prec) {
+            depth--;
+            ASTNode *node = ast_create(parser->arena, NODE_BINOP, stack[depth].line);
+            node->data.binop.op = stack[depth].op;
+            node->data.binop.left = stack[depth].left;
+            node->data.binop.right = right;
+            right = node;
         }
+        if (prec == PREC_NONE) return right;
 
-        ASTNode *node = ast_create(NODE_BINOP, line);
-        node->data.binop.op = nerd_strdup("and");
-        node->data.binop.left = left;
-        node->data.binop.right = right;
-        left = node;
-    }
-
-    return left;
-}
-
-/*
- * Parse or expression
- */
-static ASTNode *parse_or(Parser *parser) {
-    ASTNode *left = parse_and(parser);
-    if (!left) return NULL;
-
-    while (parser_check(parser, TOK_OR) && !parser_at_end_of_line(parser)) {
-        int line = parser_current(parser)->line;
+        stack[depth].left = right;
+        stack[depth].op = binop_from_token(parser_type(parser));
+        stack[depth].prec = prec;
+        stack[depth].line = parser_line(parser);
+        depth++;
         parser_advance(parser);
 
-        ASTNode *right = parse_and(parser);
-        if (!right) {
-            ast_free(left);
-            return NULL;
-        }
-
-        ASTNode *node = ast_create(NODE_BINOP, line);
-        node->data.binop.op = nerd_strdup("or");
-        node->data.binop.left = left;
-        node->data.binop.right = right;
-        left = node;
+        right = parse_unary(parser);
+        if (!right) return NULL;
     }
-
-    return left;
 }
 
 /*
  * Parse expression
  */
 static ASTNode *parse_expr(Parser *parser) {
-    return parse_or(parser);
+    return parse_binary(parser, PREC_OR);
 }
 
 /*
  * Parse inline statement (used after 'if condition')
  */
 static ASTNode *parse_inline_stmt(Parser *parser) {
-    int line = parser_current(parser)->line;
+    int line = parser_line(parser);
 
     // Return statement
     if (parser_match(parser, TOK_RET)) {
-        ASTNode *node = ast_create(NODE_RETURN, line);
+        ASTNode *node = ast_create(parser->arena, NODE_RETURN, line);
         node->data.ret.variant = 0;
 
         if (parser_match(parser, TOK_OK)) {
@@ -812,7 +917,7 @@ static ASTNode *parse_inline_stmt(Parser *parser) {
 
     // Out statement
     if (parser_match(parser, TOK_OUT)) {
-        ASTNode *node = ast_create(NODE_OUT, line);
+        ASTNode *node = ast_create(parser->arena, NODE_OUT, line);
         node->data.out.value = parse_expr(parser);
         if (!node->data.out.value) {
             ast_free(node);
@@ -823,11 +928,11 @@ static ASTNode *parse_inline_stmt(Parser *parser) {
 
     // Let binding
     if (parser_match(parser, TOK_LET)) {
-        Token *name_tok = parser_expect(parser, TOK_IDENT, "Expected variable name");
-        if (!name_tok) return NULL;
+        size_t name_tok = parser_expect(parser, TOK_IDENT, "Expected variable name");
+        if (name_tok == NO_TOKEN) return NULL;
 
-        ASTNode *node = ast_create(NODE_LET, line);
-        node->data.let.name = nerd_strdup(name_tok->value);
+        ASTNode *node = ast_create(parser->arena, NODE_LET, line);
+        node->data.let.name = token_sym(parser, name_tok);
         node->data.let.value = parse_expr(parser);
         if (!node->data.let.value) {
             ast_free(node);
@@ -841,7 +946,7 @@ static ASTNode *parse_inline_stmt(Parser *parser) {
     ASTNode *expr = parse_expr(parser);
     if (!expr) return NULL;
 
-    ASTNode *node = ast_create(NODE_EXPR_STMT, line);
+    ASTNode *node = ast_create(parser->arena, NODE_EXPR_STMT, line);
     node->data.expr_stmt.expr = expr;
     return node;
 }
@@ -850,11 +955,11 @@ static ASTNode *parse_inline_stmt(Parser *parser) {
  * Parse statement
  */
 static ASTNode *parse_stmt(Parser *parser) {
-    int line = parser_current(parser)->line;
+    int line = parser_line(parser);
 
     // Return statement
     if (parser_match(parser, TOK_RET)) {
-        ASTNode *node = ast_create(NODE_RETURN, line);
+        ASTNode *node = ast_create(parser->arena, NODE_RETURN, line);
         node->data.ret.variant = 0;
 
         if (parser_match(parser, TOK_OK)) {
@@ -875,7 +980,7 @@ static ASTNode *parse_stmt(Parser *parser) {
 
     // Out statement
     if (parser_match(parser, TOK_OUT)) {
-        ASTNode *node = ast_create(NODE_OUT, line);
+        ASTNode *node = ast_create(parser->arena, NODE_OUT, line);
         node->data.out.value = parse_expr(parser);
         if (!node->data.out.value) {
             ast_free(node);
@@ -887,11 +992,11 @@ static ASTNode *parse_stmt(Parser *parser) {
 
     // Inc statement: inc var [amount]
     if (parser_match(parser, TOK_INC)) {
-        Token *var_tok = parser_expect(parser, TOK_IDENT, "Expected variable name after 'inc'");
-        if (!var_tok) return NULL;
+        size_t var_tok = parser_expect(parser, TOK_IDENT, "Expected variable name after 'inc'");
+        if (var_tok == NO_TOKEN) return NULL;
 
-        ASTNode *node = ast_create(NODE_INC, line);
-        node->data.inc.var_name = nerd_strdup(var_tok->value);
+        ASTNode *node = ast_create(parser->arena, NODE_INC, line);
+        node->data.inc.var_name = token_sym(parser, var_tok);
         node->data.inc.amount = NULL;
 
         // Optional amount
@@ -905,11 +1010,11 @@ static ASTNode *parse_stmt(Parser *parser) {
 
     // Dec statement: dec var [amount]
     if (parser_match(parser, TOK_DEC)) {
-        Token *var_tok = parser_expect(parser, TOK_IDENT, "Expected variable name after 'dec'");
-        if (!var_tok) return NULL;
+        size_t var_tok = parser_expect(parser, TOK_IDENT, "Expected variable name after 'dec'");
+        if (var_tok == NO_TOKEN) return NULL;
 
-        ASTNode *node = ast_create(NODE_DEC, line);
-        node->data.dec.var_name = nerd_strdup(var_tok->value);
+        ASTNode *node = ast_create(parser->arena, NODE_DEC, line);
+        node->data.dec.var_name = token_sym(parser, var_tok);
         node->data.dec.amount = NULL;
 
         // Optional amount
@@ -923,10 +1028,10 @@ static ASTNode *parse_stmt(Parser *parser) {
 
     // If statement
     if (parser_match(parser, TOK_IF)) {
-        ASTNode *condition = parse_comparison(parser);
+        ASTNode *condition = parse_binary(parser, PREC_COMPARISON);
         if (!condition) return NULL;
 
-        ASTNode *node = ast_create(NODE_IF, line);
+        ASTNode *node = ast_create(parser->arena, NODE_IF, line);
         node->data.if_stmt.condition = condition;
         node->data.if_stmt.then_stmt = NULL;
         node->data.if_stmt.else_stmt = NULL;
@@ -938,7 +1043,7 @@ static ASTNode *parse_stmt(Parser *parser) {
             parser_skip_newlines(parser);
 
             // Create a block node to hold multiple statements (reuse program node)
-            ASTNode *then_block = ast_create(NODE_PROGRAM, line);
+            ASTNode *then_block = ast_create(parser->arena, NODE_PROGRAM, line);
             ast_list_init(&then_block->data.program.functions);  // Reuse as statement list
 
             // Parse then statements until else or done
@@ -952,21 +1057,21 @@ static ASTNode *parse_stmt(Parser *parser) {
                     ast_free(then_block);
             return NULL;
         }
-                ast_list_push(&then_block->data.program.functions, stmt);
+                ast_list_push(parser->arena, &then_block->data.program.functions, stmt);
                 parser_skip_newlines(parser);
             }
 
             // For single statement, unwrap the block
             if (then_block->data.program.functions.count == 1) {
-                node->data.if_stmt.then_stmt = then_block->data.program.functions.nodes[0];
-                then_block->data.program.functions.nodes[0] = NULL;
+                node->data.if_stmt.then_stmt = ast_list_nodes(&then_block->data.program.functions)[0];
+                ast_list_nodes(&then_block->data.program.functions)[0] = NULL;
                 then_block->data.program.functions.count = 0;
                 ast_free(then_block);
             } else {
                 // Multiple statements - wrap in expression statement for now
                 // TODO: proper block support
                 if (then_block->data.program.functions.count > 0) {
-                    node->data.if_stmt.then_stmt = then_block->data.program.functions.nodes[0];
+                    node->data.if_stmt.then_stmt = ast_list_nodes(&then_block->data.program.functions)[0];
                 }
                 ast_free(then_block);
             }
@@ -981,7 +1086,7 @@ static ASTNode *parse_stmt(Parser *parser) {
                     node->data.if_stmt.else_stmt = parse_stmt(parser);
                 } else {
                     // Parse else statements until done
-                    ASTNode *else_block = ast_create(NODE_PROGRAM, line);
+                    ASTNode *else_block = ast_create(parser->arena, NODE_PROGRAM, line);
                     ast_list_init(&else_block->data.program.functions);
 
                     while (!parser_at_end(parser) && !parser_check(parser, TOK_DONE)) {
@@ -992,17 +1097,17 @@ static ASTNode *parse_stmt(Parser *parser) {
                             ast_free(else_block);
                             return NULL;
                         }
-                        ast_list_push(&else_block->data.program.functions, stmt);
+                        ast_list_push(parser->arena, &else_block->data.program.functions, stmt);
                         parser_skip_newlines(parser);
                     }
 
                     if (else_block->data.program.functions.count == 1) {
-                        node->data.if_stmt.else_stmt = else_block->data.program.functions.nodes[0];
-                        else_block->data.program.functions.nodes[0] = NULL;
+                        node->data.if_stmt.else_stmt = ast_list_nodes(&else_block->data.program.functions)[0];
+                        ast_list_nodes(&else_block->data.program.functions)[0] = NULL;
                         else_block->data.program.functions.count = 0;
                         ast_free(else_block);
                     } else if (else_block->data.program.functions.count > 0) {
-                        node->data.if_stmt.else_stmt = else_block->data.program.functions.nodes[0];
+                        node->data.if_stmt.else_stmt = ast_list_nodes(&else_block->data.program.functions)[0];
                         ast_free(else_block);
                     } else {
                         ast_free(else_block);
@@ -1041,21 +1146,21 @@ static ASTNode *parse_stmt(Parser *parser) {
 
     // Let binding
     if (parser_match(parser, TOK_LET)) {
-        Token *name_tok = parser_expect(parser, TOK_IDENT, "Expected variable name");
-        if (!name_tok) return NULL;
+        size_t name_tok = parser_expect(parser, TOK_IDENT, "Expected variable name");
+        if (name_tok == NO_TOKEN) return NULL;
 
-        ASTNode *node = ast_create(NODE_LET, line);
-        node->data.let.name = nerd_strdup(name_tok->value);
+        ASTNode *node = ast_create(parser->arena, NODE_LET, line);
+        node->data.let.name = token_sym(parser, name_tok);
 
         // Check for {} (empty JSON object)
         if (parser_check(parser, TOK_LBRACE)) {
             parser_advance(parser);  // consume {
-            if (!parser_expect(parser, TOK_RBRACE, "Expected '}' after '{'")) {
+            if (parser_expect(parser, TOK_RBRACE, "Expected '}' after '{'") == NO_TOKEN) {
                 ast_free(node);
                 return NULL;
             }
             // Create a JSON_NEW node
-            ASTNode *json_new = ast_create(NODE_JSON_NEW, line);
+            ASTNode *json_new = ast_create(parser->arena, NODE_JSON_NEW, line);
             node->data.let.value = json_new;
         } else {
         node->data.let.value = parse_expr(parser);
@@ -1076,24 +1181,24 @@ static ASTNode *parse_stmt(Parser *parser) {
         if (!count) return NULL;
 
         // Expect 'times' keyword
-        if (!parser_expect(parser, TOK_TIMES, "Expected 'times' after repeat count")) {
+        if (parser_expect(parser, TOK_TIMES, "Expected 'times' after repeat count") == NO_TOKEN) {
             ast_free(count);
             return NULL;
         }
 
-        ASTNode *node = ast_create(NODE_REPEAT, line);
+        ASTNode *node = ast_create(parser->arena, NODE_REPEAT, line);
         node->data.repeat.count = count;
-        node->data.repeat.var_name = NULL;
+        node->data.repeat.var_name = SYM_NONE;
         ast_list_init(&node->data.repeat.body);
 
         // Optional 'as <var>'
         if (parser_match(parser, TOK_AS)) {
-            Token *var_tok = parser_expect(parser, TOK_IDENT, "Expected variable name after 'as'");
-            if (!var_tok) {
+            size_t var_tok = parser_expect(parser, TOK_IDENT, "Expected variable name after 'as'");
+            if (var_tok == NO_TOKEN) {
                 ast_free(node);
                 return NULL;
             }
-            node->data.repeat.var_name = nerd_strdup(var_tok->value);
+            node->data.repeat.var_name = token_sym(parser, var_tok);
         }
 
         parser_match(parser, TOK_NEWLINE);
@@ -1108,11 +1213,11 @@ static ASTNode *parse_stmt(Parser *parser) {
                 ast_free(node);
                 return NULL;
             }
-            ast_list_push(&node->data.repeat.body, stmt);
+            ast_list_push(parser->arena, &node->data.repeat.body, stmt);
             parser_skip_newlines(parser);
         }
 
-        if (!parser_expect(parser, TOK_DONE, "Expected 'done' to end repeat block")) {
+        if (parser_expect(parser, TOK_DONE, "Expected 'done' to end repeat block") == NO_TOKEN) {
             ast_free(node);
             return NULL;
         }
@@ -1123,10 +1228,10 @@ static ASTNode *parse_stmt(Parser *parser) {
 
     // While loop: while <cond> ... done
     if (parser_match(parser, TOK_WHILE)) {
-        ASTNode *condition = parse_comparison(parser);
+        ASTNode *condition = parse_binary(parser, PREC_COMPARISON);
         if (!condition) return NULL;
 
-        ASTNode *node = ast_create(NODE_WHILE, line);
+        ASTNode *node = ast_create(parser->arena, NODE_WHILE, line);
         node->data.while_loop.condition = condition;
         ast_list_init(&node->data.while_loop.body);
 
@@ -1142,11 +1247,11 @@ static ASTNode *parse_stmt(Parser *parser) {
                 ast_free(node);
                 return NULL;
             }
-            ast_list_push(&node->data.while_loop.body, stmt);
+            ast_list_push(parser->arena, &node->data.while_loop.body, stmt);
             parser_skip_newlines(parser);
         }
 
-        if (!parser_expect(parser, TOK_DONE, "Expected 'done' to end while block")) {
+        if (parser_expect(parser, TOK_DONE, "Expected 'done' to end while block") == NO_TOKEN) {
             ast_free(node);
             return NULL;
         }
@@ -1160,28 +1265,28 @@ static ASTNode *parse_stmt(Parser *parser) {
     if (parser_check(parser, TOK_IDENT)) {
         // Peek ahead to see if it's a JSON set
         size_t saved_pos = parser->pos;
-        Token *var_tok = parser_advance(parser);
+        size_t var_tok = parser_advance(parser);
         
         if (parser_check(parser, TOK_DOT)) {
             parser_advance(parser);  // consume .
             if (parser_check(parser, TOK_STRING)) {
-                Token *key_tok = parser_advance(parser);
+                size_t key_tok = parser_advance(parser);
                 if (parser_check(parser, TOK_ASSIGN)) {
                     parser_advance(parser);  // consume =
                     
-                    // This is a JSON set statement
-                    ASTNode *value = parse_expr(parser);
-                    if (!value) {
-                        return NULL;
-                    }
+                    // This is a JSON set statement (names are taken before
+                    // the value is parsed past them)
+                    ASTNode *var_node = ast_create(parser->arena, NODE_VAR, line);
+                    var_node->data.var.name = token_sym(parser, var_tok);
                     
-                    ASTNode *var_node = ast_create(NODE_VAR, line);
-                    var_node->data.var.name = nerd_strdup(var_tok->value);
-                    
-                    ASTNode *node = ast_create(NODE_JSON_SET, line);
+                    ASTNode *node = ast_create(parser->arena, NODE_JSON_SET, line);
                     node->data.json_set.object = var_node;
-                    node->data.json_set.key = nerd_strdup(key_tok->value);
-                    node->data.json_set.value = value;
+                    node->data.json_set.key = token_strdup(parser, key_tok);
+                    node->data.json_set.value = parse_expr(parser);
+                    if (!node->data.json_set.value) {
+                        ast_free(node);
+                        return NULL;
+                    }
                     
                     parser_match(parser, TOK_NEWLINE);
                     return node;
@@ -1197,7 +1302,7 @@ static ASTNode *parse_stmt(Parser *parser) {
     ASTNode *expr = parse_expr(parser);
     if (!expr) return NULL;
 
-    ASTNode *node = ast_create(NODE_EXPR_STMT, line);
+    ASTNode *node = ast_create(parser->arena, NODE_EXPR_STMT, line);
     node->data.expr_stmt.expr = expr;
     parser_match(parser, TOK_NEWLINE);
     return node;
@@ -1207,25 +1312,25 @@ static ASTNode *parse_stmt(Parser *parser) {
  * Parse function definition
  */
 static ASTNode *parse_func_def(Parser *parser) {
-    int line = parser_current(parser)->line;
+    int line = parser_line(parser);
     parser_expect(parser, TOK_FN, "Expected 'fn'");
 
-    Token *name_tok = parser_expect(parser, TOK_IDENT, "Expected function name");
-    if (!name_tok) return NULL;
+    size_t name_tok = parser_expect(parser, TOK_IDENT, "Expected function name");
+    if (name_tok == NO_TOKEN) return NULL;
 
-    ASTNode *node = ast_create(NODE_FUNC_DEF, line);
-    node->data.func_def.name = nerd_strdup(name_tok->value);
+    ASTNode *node = ast_create(parser->arena, NODE_FUNC_DEF, line);
+    node->data.func_def.name = token_sym(parser, name_tok);
     ast_list_init(&node->data.func_def.params);
     ast_list_init(&node->data.func_def.body);
     node->data.func_def.return_type = NULL;
 
     // Parse parameters
     while (!parser_at_end_of_line(parser) && parser_check(parser, TOK_IDENT)) {
-        Token *param_tok = parser_advance(parser);
-        ASTNode *param = ast_create(NODE_PARAM, param_tok->line);
-        param->data.param.name = nerd_strdup(param_tok->value);
+        size_t param_tok = parser_advance(parser);
+        ASTNode *param = ast_create(parser->arena, NODE_PARAM, token_line(parser, param_tok));
+        param->data.param.name = token_sym(parser, param_tok);
         param->data.param.param_type = NULL;
-        ast_list_push(&node->data.func_def.params, param);
+        ast_list_push(parser->arena, &node->data.func_def.params, param);
     }
 
     parser_match(parser, TOK_NEWLINE);
@@ -1242,7 +1347,7 @@ static ASTNode *parse_func_def(Parser *parser) {
             ast_free(node);
             return NULL;
         }
-        ast_list_push(&node->data.func_def.body, stmt);
+        ast_list_push(parser->arena, &node->data.func_def.body, stmt);
         parser_skip_newlines(parser);
     }
 
@@ -1253,14 +1358,14 @@ static ASTNode *parse_func_def(Parser *parser) {
  * Parse type definition
  */
 static ASTNode *parse_type_def(Parser *parser) {
-    int line = parser_current(parser)->line;
+    int line = parser_line(parser);
     parser_expect(parser, TOK_TYPE, "Expected 'type'");
 
-    Token *name_tok = parser_expect(parser, TOK_IDENT, "Expected type name");
-    if (!name_tok) return NULL;
+    size_t name_tok = parser_expect(parser, TOK_IDENT, "Expected type name");
+    if (name_tok == NO_TOKEN) return NULL;
 
-    ASTNode *node = ast_create(NODE_TYPE_DEF, line);
-    node->data.type_def.name = nerd_strdup(name_tok->value);
+    ASTNode *node = ast_create(parser->arena, NODE_TYPE_DEF, line);
+    node->data.type_def.name = token_sym(parser, name_tok);
     node->data.type_def.is_union = false;
     ast_list_init(&node->data.type_def.fields);
     node->data.type_def.ok_type = NULL;
@@ -1295,70 +1400,232 @@ static ASTNode *parse_type_def(Parser *parser) {
 }
 
 /*
- * Parse program (supports implicit main)
+ * Parse top-level items up to token `end`, sorting them into type
+ * definitions, functions and loose statements (false on a parse error)
  */
-ASTNode *parser_parse(Parser *parser) {
-    ASTNode *program = ast_create(NODE_PROGRAM, 1);
-    ast_list_init(&program->data.program.types);
-    ast_list_init(&program->data.program.functions);
-
-    // Collect top-level statements for implicit main
-    ASTList top_level_stmts;
-    ast_list_init(&top_level_stmts);
-    bool has_explicit_main = false;
-
+static bool parse_items(Parser *parser, size_t end, Symbol main_sym, ASTList *types,
+                        ASTList *functions, ASTList *stmts, bool *has_main) {
     parser_skip_newlines(parser);
 
-    while (!parser_at_end(parser)) {
+    while (!parser_at_end(parser) && parser->pos < end) {
         if (parser_check(parser, TOK_TYPE)) {
             ASTNode *type_def = parse_type_def(parser);
-            if (!type_def) {
-                ast_list_free(&top_level_stmts);
-                ast_free(program);
-                return NULL;
-            }
-            ast_list_push(&program->data.program.types, type_def);
+            if (!type_def) return false;
+            ast_list_push(parser->arena, types, type_def);
         } else if (parser_check(parser, TOK_FN)) {
             ASTNode *func_def = parse_func_def(parser);
-            if (!func_def) {
-                ast_list_free(&top_level_stmts);
-                ast_free(program);
-                return NULL;
-            }
-            if (strcmp(func_def->data.func_def.name, "main") == 0) {
-                has_explicit_main = true;
+            if (!func_def) return false;
+            if (func_def->data.func_def.name == main_sym) {
+                *has_main = true;
             }
-            ast_list_push(&program->data.program.functions, func_def);
+            ast_list_push(parser->arena, functions, func_def);
         } else if (parser_match(parser, TOK_NEWLINE)) {
             continue;
         } else {
             // Top-level statement -> implicit main
             ASTNode *stmt = parse_stmt(parser);
-            if (!stmt) {
-                ast_list_free(&top_level_stmts);
-            ast_free(program);
-            return NULL;
-            }
-            ast_list_push(&top_level_stmts, stmt);
+            if (!stmt) return false;
+            ast_list_push(parser->arena, stmts, stmt);
         }
 
         parser_skip_newlines(parser);
     }
+    return true;
+}
+
+/*
+ * Parallel parsing (batch mode)
+ *
+ * A function body runs until the next 'fn' or 'type' token, so the token
+ * array splits cleanly just before an 'fn'. Each share is parsed by its own
+ * quiet Parser into a private arena; the item lists are then appended in
+ * source order and the arenas merged into the main one. If any share fails,
+ * or an item runs past its share, the whole program is parsed again
+ * serially so errors come out exactly as before.
+ */
+#define PARSER_CHUNK_MIN (1u << 18)     // Smallest token share worth a thread
+#define PARSER_MAX_THREADS 64
+
+typedef struct {
+    Parser parser;
+    size_t end;
+    Symbol main_sym;
+    ASTList types;
+    ASTList functions;
+    ASTList stmts;
+    bool has_main;
+    pthread_t thread;
+    bool spawned;
+    bool ok;
+} ParseChunk;
+
+static void *parser_chunk_worker(void *arg) {
+    ParseChunk *chunk = arg;
+    chunk->ok = parse_items(&chunk->parser, chunk->end, chunk->main_sym, &chunk->types,
+                            &chunk->functions, &chunk->stmts, &chunk->has_main) &&
+                chunk->parser.pos == chunk->end;
+    return NULL;
+}
+
+/*
+ * Number of threads to parse with (1 means serial)
+ */
+static int parser_thread_count(Parser *parser) {
+    if (parser->lexer) return 1;
+
+    int threads = parser->threads;
+    if (threads <= 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        size_t by_size = (parser->tokens->count - parser->pos) / PARSER_CHUNK_MIN;
+        threads = cores < 1 ? 1 : (int)cores;
+        if ((size_t)threads > by_size) threads = (int)by_size;
+    }
+    if (threads > PARSER_MAX_THREADS) threads = PARSER_MAX_THREADS;
+    return threads < 1 ? 1 : threads;
+}
+
+static bool parse_items_parallel(Parser *parser, int threads, Symbol main_sym, ASTList *types,
+                                 ASTList *functions, ASTList *stmts, bool *has_main) {
+    ParseChunk *chunks = calloc((size_t)threads, sizeof(ParseChunk));
+    if (!chunks) return parse_items(parser, NO_TOKEN, main_sym, types, functions, stmts, has_main);
+
+    // Workers look lines up concurrently, so build the line index first
+    int line;
+    token_stream_locate(parser->tokens, 0, &line, NULL);
+
+    // Split into roughly equal shares, each ending just before an 'fn'
+    size_t total = parser->tokens->count - 1;   // Up to the EOF token
+    int count = 0;
+    size_t start = parser->pos;
+    while (start < total && count < threads) {
+        size_t end = total;
+        if (count < threads - 1) {
+            size_t target = start + (total - start) / (size_t)(threads - count);
+            const uint8_t *fn = memchr(parser->types + target + 1, TOK_FN, total - target - 1);
+            if (fn) end = (size_t)(fn - parser->types);
+        }
+
+        ParseChunk *chunk = &chunks[count++];
+        chunk->parser.source = parser->source;
+        chunk->parser.tokens = parser->tokens;
+        chunk->parser.types = parser->types;
+        chunk->parser.pos = start;
+        chunk->parser.quiet = true;
+        chunk->parser.arena = arena_create();
+        chunk->end = end;
+        chunk->main_sym = main_sym;
+        if (!chunk->parser.arena) goto fail;
+        start = end;
+    }
+
+    // The calling thread takes the first share
+    for (int i = 1; i < count; i++) {
+        chunks[i].spawned = pthread_create(&chunks[i].thread, NULL,
+                                           parser_chunk_worker, &chunks[i]) == 0;
+    }
+    parser_chunk_worker(&chunks[0]);
+    for (int i = 1; i < count; i++) {
+        if (chunks[i].spawned) pthread_join(chunks[i].thread, NULL);
+        else parser_chunk_worker(&chunks[i]);
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (!chunks[i].ok) goto fail;
+    }
+    if (count == 0) goto fail;
+
+    // Append each share's items in source order and take over its arena
+    for (int i = 0; i < count; i++) {
+        ParseChunk *chunk = &chunks[i];
+        for (size_t k = 0; k < chunk->types.count; k++) {
+            ast_list_push(parser->arena, types, ast_list_nodes(&chunk->types)[k]);
+        }
+        for (size_t k = 0; k < chunk->functions.count; k++) {
+            ast_list_push(parser->arena, functions, ast_list_nodes(&chunk->functions)[k]);
+        }
+        for (size_t k = 0; k < chunk->stmts.count; k++) {
+            ast_list_push(parser->arena, stmts, ast_list_nodes(&chunk->stmts)[k]);
+        }
+        *has_main = *has_main || chunk->has_main;
+        parser->modules |= chunk->parser.modules;
+        arena_adopt(parser->arena, chunk->parser.arena);
+    }
+    parser->pos = chunks[count - 1].parser.pos;
+    free(chunks);
+    return true;
+
+fail:
+    for (int i = 0; i < count; i++) {
+        arena_free(chunks[i].parser.arena);
+    }
+    free(chunks);
+    // Parse again on this thread so the first error is reported as usual
+    return parse_items(parser, NO_TOKEN, main_sym, types, functions, stmts, has_main);
+}
+
+/*
+ * Parse the top-level items from the current token up to token `end`
+ *
+ * For callers that parse a program a piece at a time. Items are sorted
+ * into the lists as parser_parse would sort them, in the parser's arena.
+ * Returns false on a parse error, which has been reported.
+ */
+bool parser_parse_segment(Parser *parser, size_t end, ASTList *types,
+                          ASTList *functions, ASTList *stmts, bool *has_main) {
+    return parse_items(parser, end, intern_cstr("main"), types, functions, stmts, has_main);
+}
+
+/*
+ * Parse program (supports implicit main)
+ */
+ASTNode *parser_parse(Parser *parser) {
+    ASTNode *program = ast_create(parser->arena, NODE_PROGRAM, 1);
+    ast_list_init(&program->data.program.types);
+    ast_list_init(&program->data.program.functions);
+
+    // Collect top-level statements for implicit main
+    ASTList top_level_stmts;
+    ast_list_init(&top_level_stmts);
+    bool has_explicit_main = false;
+    Symbol main_sym = intern_cstr("main");
+
+    int threads = parser_thread_count(parser);
+    bool ok = threads > 1
+        ? parse_items_parallel(parser, threads, main_sym, &program->data.program.types,
+                               &program->data.program.functions, &top_level_stmts,
+                               &has_explicit_main)
+        : parse_items(parser, NO_TOKEN, main_sym, &program->data.program.types,
+                      &program->data.program.functions, &top_level_stmts,
+                      &has_explicit_main);
+    if (!ok) {
+        ast_list_free(&top_level_stmts);
+        ast_free(program);
+        return NULL;
+    }
 
     // Create implicit main if needed
     if (top_level_stmts.count > 0 && !has_explicit_main) {
-        ASTNode *implicit_main = ast_create(NODE_FUNC_DEF, 1);
-        implicit_main->data.func_def.name = nerd_strdup("main");
+        ASTNode *implicit_main = ast_create(parser->arena, NODE_FUNC_DEF, 1);
+        implicit_main->data.func_def.name = main_sym;
         ast_list_init(&implicit_main->data.func_def.params);
         implicit_main->data.func_def.return_type = NULL;
         implicit_main->data.func_def.body = top_level_stmts;
-        ast_list_push(&program->data.program.functions, implicit_main);
+        ast_list_push(parser->arena, &program->data.program.functions, implicit_main);
     } else if (top_level_stmts.count > 0 && has_explicit_main) {
-        fprintf(stderr, "Error: Cannot mix top-level statements with explicit main\n");
+        parser_error(parser, "Error: Cannot mix top-level statements with explicit main\n");
         ast_list_free(&top_level_stmts);
         ast_free(program);
         return NULL;
     }
 
+    // A streaming lexer error ends the token stream early
+    if (parser->lex_failed) {
+        ast_free(program);
+        return NULL;
+    }
+
+    // The program now owns the arena; ast_free(program) releases it
+    program->data.program.arena = parser->arena;
+    parser->arena = NULL;
     return program;
 }
@@ -0,0 +1,381 @@
+/*
+ * NERD Name Resolution - Binds variable names to slots before codegen
+ *
+ * Scoping is flat within a function and follows emission order: a let
+ * binds its name from that point on, the first binding of a name wins,
+ * and a later let of a bound local stores to it instead. Locals shadow
+ * parameters. JSON objects (let x {}, let x http get "url", ...) live in
+ * separate pointer locals, which only the JSON forms look at.
+ *
+ * Slots are numbered per function: local slots count every new local
+ * and repeat counter (codegen keeps their values in SSA registers), and
+ * %plocal<slot> counts every JSON let. The counts go on the function so
+ * codegen can size its tables and allocate the pointer locals up front;
+ * it reads the slots off the nodes and never looks names up.
+ *
+ * Names are interned, so the scope is a table indexed by symbol rather
+ * than a hash map. Entries carry the generation of the function that
+ * wrote them; starting the next function bumps the generation, which
+ * clears the whole table in O(1).
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include "nerd.h"
+
+// A name's bindings in one function; stale unless generation is current
+typedef struct {
+    uint32_t generation;
+    int slot[BIND_PARAM + 1];   // By BindKind: local, pointer local, param; -1 if unbound
+    bool reported;              // Already reported as unknown
+} Binding;
+
+struct Resolver {
+    size_t symbol_count;
+    Binding *bindings;      // Indexed by symbol
+    uint32_t generation;    // Bumped per function, which unbinds every name
+
+    int local_count;
+    int ptr_count;
+    bool ok;
+};
+
+/*
+ * Create a resolver (names interned after this are never bound)
+ */
+Resolver *resolver_create(void) {
+    Resolver *r = calloc(1, sizeof(Resolver));
+    if (!r) return NULL;
+
+    // Parsing is done, so every name the AST can mention is already interned
+    r->symbol_count = symbol_count();
+    r->bindings = calloc(r->symbol_count, sizeof(Binding));
+    if (!r->bindings) {
+        resolver_free(r);
+        return NULL;
+    }
+    return r;
+}
+
+void resolver_free(Resolver *r) {
+    if (!r) return;
+    free(r->bindings);
+    free(r);
+}
+
+/*
+ * Start a new function with every name unbound
+ */
+static void begin_function(Resolver *r) {
+    if (++r->generation == 0) {
+        // Wrapped: entries from 2^32 functions ago would look current
+        memset(r->bindings, 0, sizeof(Binding) * r->symbol_count);
+        r->generation = 1;
+    }
+}
+
+/*
+ * A name's bindings in the current function, or NULL for a name
+ * interned after the resolver was created
+ */
+static Binding *binding(Resolver *r, Symbol name) {
+    if (name == SYM_NONE || name >= r->symbol_count) return NULL;
+    Binding *b = &r->bindings[name];
+    if (b->generation != r->generation) {
+        b->generation = r->generation;
+        for (int kind = 0; kind <= BIND_PARAM; kind++) b->slot[kind] = -1;
+        b->reported = false;
+    }
+    return b;
+}
+
+/*
+ * Bind a name to a slot (the first binding wins)
+ */
+static void bind(Resolver *r, BindKind kind, Symbol name, int slot) {
+    Binding *b = binding(r, name);
+    if (b && b->slot[kind] < 0) b->slot[kind] = slot;
+}
+
+/*
+ * Slot bound to a name, or -1
+ */
+static int lookup(Resolver *r, BindKind kind, Symbol name) {
+    Binding *b = binding(r, name);
+    return b ? b->slot[kind] : -1;
+}
+
+/*
+ * Report an unknown name, once per function
+ */
+static void unknown(Resolver *r, Symbol name, const char *context) {
+    r->ok = false;
+    Binding *b = binding(r, name);
+    if (b) {
+        if (b->reported) return;
+        b->reported = true;
+    }
+    fprintf(stderr, "Error: Unknown variable '%s'%s\n", symbol_name(name), context);
+}
+
+static void resolve_expr(Resolver *r, ASTNode *node);
+
+/*
+ * Resolve a variable used as a value: locals first, then parameters
+ */
+static void resolve_var(Resolver *r, ASTNode *node) {
+    Symbol name = node->data.var.name;
+    int slot = lookup(r, BIND_LOCAL, name);
+    if (slot >= 0) {
+        node->data.var.bind = BIND_LOCAL;
+        node->data.var.slot = slot;
+        return;
+    }
+    slot = lookup(r, BIND_PARAM, name);
+    if (slot >= 0) {
+        node->data.var.bind = BIND_PARAM;
+        node->data.var.slot = slot;
+        return;
+    }
+    node->data.var.bind = BIND_NONE;
+    node->data.var.slot = -1;
+    unknown(r, name, "");
+}
+
+/*
+ * Resolve the object of a JSON form: a variable naming a JSON object
+ * binds to its pointer local. Otherwise the object is an ordinary value
+ * if as_value is set, and left unbound (for codegen to reject) if not.
+ */
+static void resolve_object(Resolver *r, ASTNode *node, bool as_value) {
+    if (node->type == NODE_VAR) {
+        int slot = lookup(r, BIND_PTR_LOCAL, node->data.var.name);
+        if (slot >= 0) {
+            node->data.var.bind = BIND_PTR_LOCAL;
+            node->data.var.slot = slot;
+            return;
+        }
+        if (!as_value) {
+            node->data.var.bind = BIND_NONE;
+            node->data.var.slot = -1;
+            return;
+        }
+    }
+    if (as_value) resolve_expr(r, node);
+}
+
+/*
+ * Resolve every variable in an expression
+ */
+static void resolve_expr(Resolver *r, ASTNode *node) {
+    if (!node) return;
+
+    switch (node->type) {
+        case NODE_VAR:
+            resolve_var(r, node);
+            break;
+
+        case NODE_BINOP:
+            resolve_expr(r, node->data.binop.left);
+            resolve_expr(r, node->data.binop.right);
+            break;
+
+        case NODE_UNARYOP:
+            resolve_expr(r, node->data.unaryop.operand);
+            break;
+
+        case NODE_CALL:
+            for (size_t i = 0; i < node->data.call.args.count; i++) {
+                resolve_expr(r, ast_list_nodes(&node->data.call.args)[i]);
+            }
+            break;
+
+        case NODE_JSON_ACCESS:
+            resolve_object(r, node->data.json_access.object, true);
+            break;
+
+        case NODE_JSON_HAS:
+            resolve_object(r, node->data.json_has.object, true);
+            break;
+
+        case NODE_JSON_COUNT:
+            resolve_object(r, node->data.json_count.object, true);
+            break;
+
+        default:
+            break;
+    }
+}
+
+/*
+ * Whether a let stores a JSON object, mirroring codegen's special forms:
+ * let x {}, let x http get "url" and let x http post "url" body, where
+ * body is a string or a JSON object. Resolves the post body on the way.
+ * *bound is false for a post whose body codegen will reject.
+ */
+static bool resolve_json_let(Resolver *r, ASTNode *val, bool *bound) {
+    *bound = true;
+    if (val->type == NODE_JSON_NEW) return true;
+    if (val->type != NODE_CALL || !val->data.call.module ||
+        strcmp(val->data.call.module, "http") != 0 || val->data.call.args.count < 1) {
+        return false;
+    }
+
+    ASTNode **args = ast_list_nodes(&val->data.call.args);
+    if (args[0]->type != NODE_STR) return false;
+    if (strcmp(val->data.call.func, "get") == 0) return true;
+    if (strcmp(val->data.call.func, "post") != 0 || val->data.call.args.count < 2) return false;
+
+    ASTNode *body = args[1];
+    if (body->type == NODE_VAR) {
+        resolve_object(r, body, false);
+        *bound = body->data.var.bind == BIND_PTR_LOCAL;
+    } else {
+        *bound = body->type == NODE_STR;
+    }
+    return true;
+}
+
+/*
+ * Resolve a local being updated in place (inc/dec)
+ */
+static int resolve_update(Resolver *r, Symbol name, const char *context) {
+    int slot = lookup(r, BIND_LOCAL, name);
+    if (slot < 0) unknown(r, name, context);
+    return slot;
+}
+
+/*
+ * Resolve a statement, binding what it declares
+ */
+static void resolve_stmt(Resolver *r, ASTNode *node) {
+    if (!node) return;
+
+    switch (node->type) {
+        case NODE_LET: {
+            ASTNode *val = node->data.let.value;
+            node->data.let.bind = BIND_NONE;
+            node->data.let.slot = -1;
+            node->data.let.declares = false;
+
+            bool bound;
+            if (resolve_json_let(r, val, &bound)) {
+                // Every JSON let allocates a new pointer local
+                if (bound) {
+                    node->data.let.bind = BIND_PTR_LOCAL;
+                    node->data.let.slot = r->ptr_count++;
+                    node->data.let.declares = true;
+                    bind(r, BIND_PTR_LOCAL, node->data.let.name, node->data.let.slot);
+                }
+                break;
+            }
+
+            // The value is evaluated before the name is bound
+            resolve_expr(r, val);
+            node->data.let.bind = BIND_LOCAL;
+            node->data.let.slot = lookup(r, BIND_LOCAL, node->data.let.name);
+            if (node->data.let.slot < 0) {
+                node->data.let.slot = r->local_count++;
+                node->data.let.declares = true;
+                bind(r, BIND_LOCAL, node->data.let.name, node->data.let.slot);
+            }
+            break;
+        }
+
+        case NODE_RETURN:
+            resolve_expr(r, node->data.ret.value);
+            break;
+
+        case NODE_IF:
+            resolve_expr(r, node->data.if_stmt.condition);
+            resolve_stmt(r, node->data.if_stmt.then_stmt);
+            resolve_stmt(r, node->data.if_stmt.else_stmt);
+            break;
+
+        case NODE_EXPR_STMT:
+            resolve_expr(r, node->data.expr_stmt.expr);
+            break;
+
+        case NODE_OUT:
+            resolve_expr(r, node->data.out.value);
+            break;
+
+        case NODE_REPEAT:
+            // The counter takes a slot even without an 'as' name
+            resolve_expr(r, node->data.repeat.count);
+            node->data.repeat.slot = r->local_count++;
+            bind(r, BIND_LOCAL, node->data.repeat.var_name, node->data.repeat.slot);
+            for (size_t i = 0; i < node->data.repeat.body.count; i++) {
+                resolve_stmt(r, ast_list_nodes(&node->data.repeat.body)[i]);
+            }
+            break;
+
+        case NODE_WHILE:
+            resolve_expr(r, node->data.while_loop.condition);
+            for (size_t i = 0; i < node->data.while_loop.body.count; i++) {
+                resolve_stmt(r, ast_list_nodes(&node->data.while_loop.body)[i]);
+            }
+            break;
+
+        case NODE_INC:
+            node->data.inc.slot = resolve_update(r, node->data.inc.var_name, " in inc");
+            resolve_expr(r, node->data.inc.amount);
+            break;
+
+        case NODE_DEC:
+            node->data.dec.slot = resolve_update(r, node->data.dec.var_name, " in dec");
+            resolve_expr(r, node->data.dec.amount);
+            break;
+
+        case NODE_JSON_SET:
+            resolve_object(r, node->data.json_set.object, false);
+            resolve_expr(r, node->data.json_set.value);
+            break;
+
+        default:
+            resolve_expr(r, node);
+            break;
+    }
+}
+
+/*
+ * Resolve one function (false if it uses unknown names)
+ */
+bool resolve_function(Resolver *r, ASTNode *func) {
+    begin_function(r);
+    r->local_count = 0;
+    r->ptr_count = 0;
+    r->ok = true;
+
+    for (size_t i = 0; i < func->data.func_def.params.count; i++) {
+        bind(r, BIND_PARAM, ast_list_nodes(&func->data.func_def.params)[i]->data.param.name,
+             (int)i);
+    }
+    for (size_t i = 0; i < func->data.func_def.body.count; i++) {
+        resolve_stmt(r, ast_list_nodes(&func->data.func_def.body)[i]);
+    }
+    func->data.func_def.local_count = r->local_count;
+    func->data.func_def.ptr_count = r->ptr_count;
+    return r->ok;
+}
+
+/*
+ * Resolve every function of a program
+ */
+bool resolve_program(ASTNode *program) {
+    Resolver *r = resolver_create();
+    if (!r) {
+        fprintf(stderr, "Error: Out of memory\n");
+        return false;
+    }
+
+    bool ok = true;
+    for (size_t i = 0; i < program->data.program.functions.count; i++) {
+        if (!resolve_function(r, ast_list_nodes(&program->data.program.functions)[i])) {
+            ok = false;
+        }
+    }
+    resolver_free(r);
+    return ok;
+}
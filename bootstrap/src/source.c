@@ -0,0 +1,123 @@
+/*
+ * NERD Source Loader - Maps source files into memory
+ *
+ * Regular files are mmap'd read-only so the lexer tokenizes straight out of
+ * the page cache with no copy. Pipes, FIFOs and stdin ("-") can't be mapped
+ * and are read into a heap buffer instead.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "nerd.h"
+
+/*
+ * Read everything from a file descriptor into a heap buffer
+ */
+static bool source_read_fd(SourceFile *src, int fd, size_t size_hint) {
+    size_t capacity = size_hint > 0 ? size_hint + 1 : 4096;
+    size_t len = 0;
+    char *buf = malloc(capacity);
+    if (!buf) return false;
+
+    for (;;) {
+        if (len == capacity) {
+            capacity *= 2;
+            char *grown = realloc(buf, capacity);
+            if (!grown) {
+                free(buf);
+                return false;
+            }
+            buf = grown;
+        }
+
+        ssize_t n = read(fd, buf + len, capacity - len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            free(buf);
+            return false;
+        }
+        if (n == 0) break;
+        len += (size_t)n;
+    }
+
+    src->data = buf;
+    src->len = len;
+    src->mapped = false;
+    return true;
+}
+
+/*
+ * Open a source file ("-" reads stdin)
+ */
+bool source_open(SourceFile *src, const char *path) {
+    src->data = NULL;
+    src->len = 0;
+    src->mapped = false;
+
+    if (strcmp(path, "-") == 0) {
+        if (!source_read_fd(src, STDIN_FILENO, 0)) {
+            fprintf(stderr, "Error: Failed to read stdin\n");
+            return false;
+        }
+        return true;
+    }
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error: Cannot open file '%s'\n", path);
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        fprintf(stderr, "Error: Cannot open file '%s'\n", path);
+        close(fd);
+        return false;
+    }
+
+    // Map regular, non-empty files; the mapping stays valid after close
+    if (S_ISREG(st.st_mode) && st.st_size > 0) {
+        void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            posix_madvise(map, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL);
+            close(fd);
+            src->data = map;
+            src->len = (size_t)st.st_size;
+            src->mapped = true;
+            return true;
+        }
+    }
+
+    // Pipes, FIFOs, empty files, or mmap failure: read into memory
+    size_t hint = S_ISREG(st.st_mode) ? (size_t)st.st_size : 0;
+    bool ok = source_read_fd(src, fd, hint);
+    close(fd);
+    if (!ok) {
+        fprintf(stderr, "Error: Failed to read file '%s'\n", path);
+    }
+    return ok;
+}
+
+/*
+ * Release a source file
+ */
+void source_close(SourceFile *src) {
+    if (!src->data) return;
+
+    if (src->mapped) {
+        munmap((void *)src->data, src->len);
+    } else {
+        free((void *)src->data);
+    }
+    src->data = NULL;
+    src->len = 0;
+    src->mapped = false;
+}
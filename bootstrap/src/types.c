@@ -0,0 +1,322 @@
+/*
+ * NERD Type Inference - Gives every expression a static type
+ *
+ * Types flow up from literals, operators and calls, and down from the
+ * context an expression is used in: a JSON access is an object where a
+ * JSON object is expected (x."a"."b", x."a".count), a bool in a
+ * condition and a number everywhere else, which picks the runtime getter
+ * codegen calls.
+ *
+ * A local has one type for the whole function, the join of every value
+ * stored to it; the statements that store to it (let, inc, dec, repeat)
+ * carry that type too, so codegen can tell int repeat counters apart.
+ *
+ * Loops can store to a local after it is read, so the body is walked
+ * until the local types stop changing, then once more to annotate the
+ * nodes and report errors. A local only ever widens from unknown to one
+ * type to num, so this terminates after a few walks.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include "nerd.h"
+
+typedef struct {
+    ValueType *locals;          // Indexed by local slot
+    int local_capacity;
+    bool changed;               // A local's type widened during this walk
+    bool report;                // Final walk: report errors
+    bool ok;
+} TypeContext;
+
+/*
+ * Join of two types: the one known, the same one, or num
+ */
+static ValueType join(ValueType a, ValueType b) {
+    if (a == TYPE_UNKNOWN) return b;
+    if (b == TYPE_UNKNOWN || a == b) return a;
+    return TYPE_NUM;
+}
+
+static const char *type_name(ValueType type) {
+    switch (type) {
+        case TYPE_NUM: return "num";
+        case TYPE_INT: return "int";
+        case TYPE_BOOL: return "bool";
+        case TYPE_STR: return "str";
+        case TYPE_JSON: return "json";
+        default: return "unknown";
+    }
+}
+
+/*
+ * Make room for a local slot
+ */
+static bool reserve_local(TypeContext *t, int slot) {
+    if (slot < t->local_capacity) return true;
+
+    int capacity = t->local_capacity ? t->local_capacity : 16;
+    while (capacity <= slot) capacity *= 2;
+    ValueType *grown = realloc(t->locals, sizeof(ValueType) * capacity);
+    if (!grown) {
+        fprintf(stderr, "Error: Out of memory\n");
+        t->ok = false;
+        return false;
+    }
+    for (int i = t->local_capacity; i < capacity; i++) grown[i] = TYPE_UNKNOWN;
+    t->locals = grown;
+    t->local_capacity = capacity;
+    return true;
+}
+
+/*
+ * Record a value of the given type being stored to a local
+ */
+static void store_local(TypeContext *t, int slot, ValueType type) {
+    if (slot < 0 || !reserve_local(t, slot)) return;
+    ValueType joined = join(t->locals[slot], type);
+    if (joined != t->locals[slot]) {
+        t->locals[slot] = joined;
+        t->changed = true;
+    }
+}
+
+static ValueType local_type(TypeContext *t, int slot) {
+    if (slot < 0 || slot >= t->local_capacity || t->locals[slot] == TYPE_UNKNOWN) {
+        return TYPE_NUM;
+    }
+    return t->locals[slot];
+}
+
+static ValueType infer_expr(TypeContext *t, ASTNode *node, ValueType want);
+
+static bool nonzero_literal(const ASTNode *node) {
+    return node->type == NODE_NUM && node->data.num.value != 0;
+}
+
+/*
+ * Infer the object of a JSON form, which must be a JSON object
+ */
+static void infer_object(TypeContext *t, ASTNode *node) {
+    ValueType type = infer_expr(t, node, TYPE_JSON);
+    if (type != TYPE_JSON) {
+        t->ok = false;
+        if (t->report) {
+            fprintf(stderr, "Error at line %d: Expected a JSON object, found %s\n",
+                    node->line, type_name(type));
+        }
+    }
+}
+
+/*
+ * Infer an expression's type, given the type its context wants
+ */
+static ValueType infer_expr(TypeContext *t, ASTNode *node, ValueType want) {
+    if (!node) return TYPE_UNKNOWN;
+
+    ValueType type = TYPE_NUM;
+    switch (node->type) {
+        case NODE_NUM: {
+            double val = node->data.num.value;
+            // -0.0 is not an int: as an i64 it would lose its sign
+            bool integral = val >= -1e15 && val <= 1e15 && val == (long long)val &&
+                            !(val == 0 && signbit(val));
+            type = integral ? TYPE_INT : TYPE_NUM;
+            break;
+        }
+
+        case NODE_STR:
+            type = TYPE_STR;
+            break;
+
+        case NODE_BOOL:
+            type = TYPE_BOOL;
+            break;
+
+        case NODE_VAR:
+            if (node->data.var.bind == BIND_PTR_LOCAL) {
+                type = TYPE_JSON;
+            } else if (node->data.var.bind == BIND_LOCAL) {
+                type = local_type(t, node->data.var.slot);
+            }
+            break;
+
+        case NODE_BINOP: {
+            OpCode op = node->data.binop.op;
+            if (op == OP_AND || op == OP_OR) {
+                infer_expr(t, node->data.binop.left, TYPE_BOOL);
+                infer_expr(t, node->data.binop.right, TYPE_BOOL);
+                type = TYPE_BOOL;
+                break;
+            }
+
+            ValueType left = infer_expr(t, node->data.binop.left, TYPE_NUM);
+            ValueType right = infer_expr(t, node->data.binop.right, TYPE_NUM);
+            if (op >= OP_EQ && op <= OP_GTE) {
+                type = TYPE_BOOL;
+            } else if (left == TYPE_INT && right == TYPE_INT && op != OP_OVER &&
+                       (op != OP_MOD || nonzero_literal(node->data.binop.right))) {
+                // Only a constant divisor keeps mod integral (x mod 0 is NaN)
+                type = TYPE_INT;
+            }
+            break;
+        }
+
+        case NODE_UNARYOP:
+            if (node->data.unaryop.op == OP_NOT) {
+                infer_expr(t, node->data.unaryop.operand, TYPE_BOOL);
+                type = TYPE_BOOL;
+            } else if (infer_expr(t, node->data.unaryop.operand, TYPE_NUM) == TYPE_INT) {
+                type = TYPE_INT;
+            }
+            break;
+
+        case NODE_CALL:
+            for (size_t i = 0; i < node->data.call.args.count; i++) {
+                infer_expr(t, ast_list_nodes(&node->data.call.args)[i], TYPE_NUM);
+            }
+            break;
+
+        case NODE_JSON_NEW:
+            type = TYPE_JSON;
+            break;
+
+        case NODE_JSON_ACCESS:
+            infer_object(t, node->data.json_access.object);
+            type = want == TYPE_JSON || want == TYPE_BOOL ? want : TYPE_NUM;
+            break;
+
+        case NODE_JSON_HAS:
+            infer_object(t, node->data.json_has.object);
+            type = TYPE_BOOL;
+            break;
+
+        case NODE_JSON_COUNT:
+            infer_object(t, node->data.json_count.object);
+            type = TYPE_INT;
+            break;
+
+        default:
+            break;
+    }
+
+    node->vtype = type;
+    return type;
+}
+
+static void infer_stmt(TypeContext *t, ASTNode *node);
+
+static void infer_body(TypeContext *t, const ASTList *body) {
+    for (size_t i = 0; i < body->count; i++) {
+        infer_stmt(t, ast_list_nodes(body)[i]);
+    }
+}
+
+/*
+ * Infer an inc/dec: the local stays an int only if the amount is one
+ */
+static void infer_update(TypeContext *t, ASTNode *node, int slot, ASTNode *amount) {
+    ValueType type = amount ? infer_expr(t, amount, TYPE_NUM) : TYPE_INT;
+    store_local(t, slot, type == TYPE_INT ? TYPE_INT : TYPE_NUM);
+    node->vtype = local_type(t, slot);
+}
+
+/*
+ * Infer the expressions of a statement and the locals it stores to
+ */
+static void infer_stmt(TypeContext *t, ASTNode *node) {
+    if (!node) return;
+
+    switch (node->type) {
+        case NODE_LET:
+            if (node->data.let.bind == BIND_PTR_LOCAL) {
+                // JSON lets take a literal url and body, nothing to infer
+                node->vtype = TYPE_JSON;
+            } else if (node->data.let.bind == BIND_LOCAL) {
+                store_local(t, node->data.let.slot, infer_expr(t, node->data.let.value, TYPE_NUM));
+                node->vtype = local_type(t, node->data.let.slot);
+            }
+            break;
+
+        case NODE_RETURN:
+            infer_expr(t, node->data.ret.value, TYPE_NUM);
+            break;
+
+        case NODE_IF:
+            infer_expr(t, node->data.if_stmt.condition, TYPE_BOOL);
+            infer_stmt(t, node->data.if_stmt.then_stmt);
+            infer_stmt(t, node->data.if_stmt.else_stmt);
+            break;
+
+        case NODE_EXPR_STMT:
+            infer_expr(t, node->data.expr_stmt.expr, TYPE_NUM);
+            break;
+
+        case NODE_OUT:
+            infer_expr(t, node->data.out.value, TYPE_NUM);
+            break;
+
+        case NODE_REPEAT:
+            infer_expr(t, node->data.repeat.count, TYPE_NUM);
+            store_local(t, node->data.repeat.slot, TYPE_INT);
+            node->vtype = local_type(t, node->data.repeat.slot);
+            infer_body(t, &node->data.repeat.body);
+            break;
+
+        case NODE_WHILE:
+            infer_expr(t, node->data.while_loop.condition, TYPE_BOOL);
+            infer_body(t, &node->data.while_loop.body);
+            break;
+
+        case NODE_INC:
+            infer_update(t, node, node->data.inc.slot, node->data.inc.amount);
+            break;
+
+        case NODE_DEC:
+            infer_update(t, node, node->data.dec.slot, node->data.dec.amount);
+            break;
+
+        case NODE_JSON_SET:
+            infer_expr(t, node->data.json_set.value, TYPE_NUM);
+            break;
+
+        default:
+            infer_expr(t, node, TYPE_NUM);
+            break;
+    }
+}
+
+/*
+ * Infer the types in one function (false on a type error)
+ */
+bool infer_function(ASTNode *func) {
+    TypeContext t = {0};
+    t.ok = true;
+
+    do {
+        t.changed = false;
+        infer_body(&t, &func->data.func_def.body);
+    } while (t.changed);
+
+    // Annotate with the final local types and report what is wrong
+    t.report = true;
+    t.ok = true;
+    infer_body(&t, &func->data.func_def.body);
+
+    free(t.locals);
+    return t.ok;
+}
+
+/*
+ * Infer the types of every function of a program
+ */
+bool infer_program(ASTNode *program) {
+    bool ok = true;
+    for (size_t i = 0; i < program->data.program.functions.count; i++) {
+        if (!infer_function(ast_list_nodes(&program->data.program.functions)[i])) {
+            ok = false;
+        }
+    }
+    return ok;
+}